@@ -0,0 +1,9 @@
+#pragma once
+
+/**
+ * @brief Run microbenchmarks of periodic hot paths and log results.
+ * Covers BMP180 compensation, DHT11 frame decoding, payload formatting
+ * and topic construction. Reports nanoseconds and CPU cycles per call.
+ * Should be called before other tasks are started so they do not skew the results.
+ */
+void Benchmark_run();
@@ -1,37 +1,37 @@
 #pragma once
 #include <cstdint>
+#include "bmp180_compensation.hpp"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
 
 class BMP180
 {
 private:
-    // Constant factory calibration settings.
-    const int16_t AC1;
-    const int16_t AC2;
-    const int16_t AC3;
-    const uint16_t AC4;
-    const uint16_t AC5;
-    const uint16_t AC6;
-    const int16_t B1;
-    const int16_t B2;
-    const int16_t MB;
-    const int16_t MC;
-    const int16_t MD;
+    BMP180Calibration cal; //!< Factory calibration settings, read once from sensor's EEPROM.
     int32_t B5; //!< This one will change with every temperature measurement.
+    bool calibrated = false; //!< Calibration was read successfully.
 
     /**
-     * @brief Process reading into true temperature value in °C.
+     * @brief Read whole calibration block in single I2C transaction.
+     * @return True on success.
+     */
+    bool loadCalibration();
+
+    /**
+     * @brief Process reading into true temperature value in 0.1 °C, resolution of compensation formula.
      * @param reading I2C reading.
      * @return Temperature.
      */
-    float trueTemperature(int32_t reading);
+    int32_t trueTemperature(int32_t reading);
 
     /**
-     * @brief Process reading into true pressure in hPa.
-     * @param reading I2C reading,
+     * @brief Process reading into true pressure in Pa.
+     * @param reading 24 bit I2C reading (MSB, LSB, XLSB),
      * @param oss Measurement quality bits.
-     * @return PRessure.
+     * @return Pressure.
      */
-    float truePressure(int32_t reading, uint8_t oss);
+    int32_t truePressure(int32_t reading, uint8_t oss);
 
 public:
     /**
@@ -46,15 +46,104 @@ public:
         TEMPERATURE
     };
 
+    /**
+     * @brief State of asynchronous measurement cycle returned by poll().
+     */
+    enum class Status
+    {
+        BUSY,
+        READY,
+        ERROR
+    };
+
     /**
      * @brief Class constructor.
      * I2C must be initialized before constructing this object.
      */
     BMP180();
 
+    /**
+     * @brief Start asynchronous measurement cycle.
+     * Cycle always converts temperature first to update B5 and then,
+     * unless type is TEMPERATURE, pressure using the same B5.
+     * Calling task is notified whenever next conversion should be finished.
+     * @param type Type of measurement.
+     * @return False if previous cycle is still in progress or sensor is not responding.
+     */
+    bool start(MeasurementType type);
+
+    /**
+     * @brief Advance measurement cycle without blocking.
+     * @return READY if cycle is finished and results are valid, ERROR on I2C failure.
+     */
+    Status poll();
+
+    /**
+     * @brief Sleep until current measurement cycle is finished.
+     * Other tasks are free to run during conversion time.
+     * @return Final status of the cycle.
+     */
+    Status wait();
+
+    /**
+     * @brief Get temperature from last finished cycle in 0.1 °C.
+     */
+    int32_t getTemperatureDeci() const;
+
+    /**
+     * @brief Get pressure from last finished cycle in Pa.
+     */
+    int32_t getPressurePa() const;
+
+    /**
+     * @brief Get temperature from last finished cycle in °C.
+     */
+    float getTemperature() const;
+
+    /**
+     * @brief Get pressure from last finished cycle in hPa.
+     */
+    float getPressure() const;
+
     /**
      * @brief Read some value from the sensor.
+     * Blocking wrapper around start() and wait().
      * @param type Type of measurement.
+     * @return Temperature in °C or pressure in hPa, NaN if cycle failed.
      */
     float read(MeasurementType type);
+
+private:
+    /**
+     * @brief Conversion currently running in asynchronous cycle.
+     */
+    enum class Step
+    {
+        IDLE,
+        TEMPERATURE,
+        PRESSURE
+    };
+
+    Step step = Step::IDLE;                                   //!< Current conversion.
+    MeasurementType cycleType = MeasurementType::TEMPERATURE; //!< Type requested in start().
+    uint8_t oss = 0;                                          //!< Oversampling of pressure conversion.
+    int64_t readyAt = 0;                                      //!< esp_timer time at which current conversion is done.
+    int64_t cycleStart = 0;                                   //!< esp_timer time at which current cycle was started.
+    int32_t temperature = 0;                                  //!< Last temperature result in 0.1 °C.
+    int32_t pressure = 0;                                     //!< Last pressure result in Pa.
+    esp_timer_handle_t conversionTimer = nullptr;             //!< Wakes waiting task after conversion time.
+    TaskHandle_t waitingTask = nullptr;                       //!< Task that started current cycle.
+
+    /**
+     * @brief Write CTRL_MEAS for given type and arm conversion timer.
+     * @param type Type of measurement.
+     * @return False on I2C failure.
+     */
+    bool startConversion(MeasurementType type);
+
+    /**
+     * @brief Conversion timer callback. Notifies waiting task.
+     * @param arg This object.
+     */
+    static void conversionDone(void *arg);
 };
\ No newline at end of file
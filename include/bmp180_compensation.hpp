@@ -0,0 +1,137 @@
+#pragma once
+#include <cstdint>
+
+/**
+ * Hardware independent part of BMP180 driver.
+ * Depends only on <cstdint> so it can be compiled and checked anywhere.
+ */
+
+/**
+ * @brief BMP180 factory calibration coefficients.
+ */
+struct BMP180Calibration
+{
+    int16_t AC1;
+    int16_t AC2;
+    int16_t AC3;
+    uint16_t AC4;
+    uint16_t AC5;
+    uint16_t AC6;
+    int16_t B1;
+    int16_t B2;
+    int16_t MB;
+    int16_t MC;
+    int16_t MD;
+};
+
+/**
+ * @brief Fill calibration from raw 22 byte EEPROM block (0xAA - 0xBF).
+ * @param raw Big endian calibration block.
+ * @return Calibration.
+ */
+inline BMP180Calibration BMP180_parseCalibration(const uint8_t *raw)
+{
+    BMP180Calibration cal;
+    cal.AC1 = (raw[0] << 8) | raw[1];
+    cal.AC2 = (raw[2] << 8) | raw[3];
+    cal.AC3 = (raw[4] << 8) | raw[5];
+    cal.AC4 = (raw[6] << 8) | raw[7];
+    cal.AC5 = (raw[8] << 8) | raw[9];
+    cal.AC6 = (raw[10] << 8) | raw[11];
+    cal.B1 = (raw[12] << 8) | raw[13];
+    cal.B2 = (raw[14] << 8) | raw[15];
+    cal.MB = (raw[16] << 8) | raw[17];
+    cal.MC = (raw[18] << 8) | raw[19];
+    cal.MD = (raw[20] << 8) | raw[21];
+    return cal;
+}
+
+/**
+ * @brief Compensate raw temperature reading.
+ * @param cal Calibration.
+ * @param UT Raw 16 bit temperature reading.
+ * @param B5 Set to B5 parameter required by BMP180_compensatePressure().
+ * @return Temperature in 0.1 °C.
+ */
+inline int32_t BMP180_compensateTemperature(const BMP180Calibration &cal, int32_t UT, int32_t &B5)
+{
+    int32_t X1 = (UT - cal.AC6) * cal.AC5 / 32768;
+    int32_t X2 = cal.MC * 2048 / (X1 + cal.MD);
+    B5 = X1 + X2;
+    return (B5 + 8) / 16;
+}
+
+/**
+ * @brief Compensate raw pressure reading.
+ * @param cal Calibration.
+ * @param UP Raw 24 bit pressure reading (MSB, LSB, XLSB).
+ * @param oss Measurement quality bits.
+ * @param B5 B5 parameter from temperature compensation.
+ * @return Pressure in Pa.
+ */
+inline int32_t BMP180_compensatePressure(const BMP180Calibration &cal, int32_t UP, uint8_t oss, int32_t B5)
+{
+    UP = UP >> (8 - oss);
+
+    int32_t B6 = B5 - 4000;
+    int32_t X1 = (cal.B2 * (B6 * B6 / 4096)) / 2048;
+    int32_t X2 = cal.AC2 * B6 / 2048;
+    int32_t X3 = X1 + X2;
+    int32_t B3 = (((cal.AC1 * 4 + X3) << oss) + 2) / 4;
+    X1 = cal.AC3 * B6 / 8192;
+    X2 = (cal.B1 * (B6 * B6 / 4096)) / 65536;
+    X3 = ((X1 + X2) + 2) / 4;
+    uint32_t B4 = cal.AC4 * (uint32_t)(X3 + 32768) / 32768;
+    uint32_t B7 = ((uint32_t)UP - B3) * (50000 >> oss);
+
+    int32_t p;
+    if (B7 < 0x80000000)
+    {
+        p = (B7 * 2) / B4;
+    }
+    else
+    {
+        p = (B7 / B4) * 2;
+    }
+
+    X1 = (p / 256) * (p / 256);
+    X1 = (X1 * 3038) / 65536;
+    X2 = (-7357 * p) / 65536;
+    return p + (X1 + X2 + 3791) / 16;
+}
+
+/**
+ * @brief BMP180 compensation specialized for calibration known at compile time.
+ * Coefficients are template parameters so they are folded into constants of the evaluator
+ * instead of being loaded from memory on every sample.
+ * Calibration of particular sensor is logged by BMP180 when it's read from the EEPROM.
+ */
+template <int16_t AC1, int16_t AC2, int16_t AC3, uint16_t AC4, uint16_t AC5, uint16_t AC6,
+          int16_t B1, int16_t B2, int16_t MB, int16_t MC, int16_t MD>
+struct BMP180StaticCompensation
+{
+    /**
+     * @brief Get calibration given in template parameters.
+     * @return Calibration.
+     */
+    static inline BMP180Calibration calibration()
+    {
+        return {AC1, AC2, AC3, AC4, AC5, AC6, B1, B2, MB, MC, MD};
+    }
+
+    /**
+     * @brief See BMP180_compensateTemperature().
+     */
+    static inline int32_t temperature(int32_t UT, int32_t &B5)
+    {
+        return BMP180_compensateTemperature(calibration(), UT, B5);
+    }
+
+    /**
+     * @brief See BMP180_compensatePressure().
+     */
+    static inline int32_t pressure(int32_t UP, uint8_t oss, int32_t B5)
+    {
+        return BMP180_compensatePressure(calibration(), UP, oss, B5);
+    }
+};
@@ -0,0 +1,159 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+/**
+ * @brief Minimal CBOR (RFC 8949) encoder writing into caller's buffer.
+ * Supports only what is needed for sample payloads. Never allocates.
+ * Depends only on standard headers so it can be compiled and checked anywhere.
+ */
+class CborWriter
+{
+private:
+    uint8_t *buf;          //!< Output buffer.
+    size_t size;           //!< Size of output buffer.
+    size_t len = 0;        //!< Bytes written so far.
+    bool overflow = false; //!< Output didn't fit in the buffer.
+
+    /**
+     * @brief Write single byte.
+     * @param b Byte.
+     */
+    void put(uint8_t b)
+    {
+        if (len < size)
+            buf[len++] = b;
+        else
+            overflow = true;
+    }
+
+    /**
+     * @brief Write initial byte with major type and argument.
+     * @param major Major type (0 - 7).
+     * @param arg Argument.
+     */
+    void head(uint8_t major, uint64_t arg)
+    {
+        major <<= 5;
+        if (arg < 24)
+        {
+            put(major | arg);
+        }
+        else if (arg <= 0xFF)
+        {
+            put(major | 24);
+            put(arg);
+        }
+        else if (arg <= 0xFFFF)
+        {
+            put(major | 25);
+            for (int shift = 8; shift >= 0; shift -= 8)
+                put(arg >> shift);
+        }
+        else if (arg <= 0xFFFFFFFF)
+        {
+            put(major | 26);
+            for (int shift = 24; shift >= 0; shift -= 8)
+                put(arg >> shift);
+        }
+        else
+        {
+            put(major | 27);
+            for (int shift = 56; shift >= 0; shift -= 8)
+                put(arg >> shift);
+        }
+    }
+
+public:
+    /**
+     * @brief Class constructor.
+     * @param buf Output buffer.
+     * @param size Size of output buffer.
+     */
+    CborWriter(uint8_t *buf, size_t size) : buf(buf), size(size) {}
+
+    /**
+     * @brief Start map of given number of key value pairs.
+     * @param pairs Number of pairs.
+     */
+    void map(size_t pairs)
+    {
+        head(5, pairs);
+    }
+
+    /**
+     * @brief Start array of given number of items.
+     * @param items Number of items.
+     */
+    void array(size_t items)
+    {
+        head(4, items);
+    }
+
+    /**
+     * @brief Write signed integer.
+     * @param v Value.
+     */
+    void integer(int64_t v)
+    {
+        if (v >= 0)
+            head(0, v);
+        else
+            head(1, -1 - v);
+    }
+
+    /**
+     * @brief Write UTF-8 text string.
+     * @param str Null terminated string.
+     */
+    void text(const char *str)
+    {
+        size_t n = strlen(str);
+        head(3, n);
+        for (size_t i = 0; i < n; i++)
+            put(str[i]);
+    }
+
+    /**
+     * @brief Write single precision float.
+     * @param f Value.
+     */
+    void float32(float f)
+    {
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        put(0xFA);
+        for (int shift = 24; shift >= 0; shift -= 8)
+            put(bits >> shift);
+    }
+
+    /**
+     * @brief Write exact decimal fraction (tag 4), mantissa * 10^exponent.
+     * @param mantissa Mantissa.
+     * @param exponent Exponent.
+     */
+    void decimal(int32_t mantissa, int8_t exponent)
+    {
+        head(6, 4);
+        array(2);
+        integer(exponent);
+        integer(mantissa);
+    }
+
+    /**
+     * @brief Get number of written bytes.
+     */
+    size_t length() const
+    {
+        return len;
+    }
+
+    /**
+     * @brief Check whether everything fit in the buffer.
+     */
+    bool ok() const
+    {
+        return !overflow;
+    }
+};
@@ -11,8 +11,58 @@
 #define MQTT_LED_PIN (gpio_num_t)14
 
 #define DHT11_DATA_PIN (gpio_num_t)18
+#define DHT11_RMT_CHANNEL RMT_CHANNEL_0
 
 #define I2C_PORT I2C_NUM_0
 #define I2C_SDA (gpio_num_t)21
 #define I2C_SCL (gpio_num_t)22
-#define I2C_FREQ 100000
\ No newline at end of file
+#define I2C_FREQ 400000 // Max clock of bus, every device runs at lower of this and its own max. Lower to 100000 without external pull ups.
+
+// Uncomment and fill with calibration logged by BMP180 to skip reading it
+// and fold it into compensation code at compile time.
+// #define BMP180_STATIC_CALIBRATION 408, -72, -14383, 32741, 32757, 23153, 6190, 4, -32768, -8711, 2868
+
+#define SNTP_SERVER "pool.ntp.org" // Sample timestamps are 0 until first sync.
+
+// Defaults of settings changeable over <namespace>/cmd, see README.
+#define MEASUREMENT_PERIOD_MS 5000
+#define SAMPLE_QOS 1
+
+// Pressure is sampled every PRESSURE_SAMPLE_PERIOD_MS in cheaper mode and filtered,
+// filtered value is published every MEASUREMENT_PERIOD_MS.
+#define PRESSURE_SAMPLE_PERIOD_MS 1000
+#define PRESSURE_SAMPLE_MODE BMP180::MeasurementType::STANDARD // Default.
+#define PUBLISH_PRESSURE_STATS 0 // Set to 1 to also publish min / max / stddev of raw samples of every period.
+
+#define PRESSURE_FILTER_MEDIAN 0
+#define PRESSURE_FILTER_EMA 1
+#define PRESSURE_FILTER_KALMAN 2
+#define PRESSURE_FILTER PRESSURE_FILTER_MEDIAN
+#define PRESSURE_MEDIAN_SIZE 5     // Odd.
+#define PRESSURE_EMA_SHIFT 2       // Alpha is 1 / 2^shift.
+#define PRESSURE_KALMAN_Q 0.05f    // Variance of real pressure change between samples in Pa^2.
+#define PRESSURE_KALMAN_R 25.0f    // Variance of sample noise in Pa^2 (datasheet gives 5 Pa RMS in STANDARD mode).
+
+// Report by exception, sample of listed topic is published only if it moved by more than deadband
+// from last published value or heartbeat passed since then. Unlisted topics publish every sample.
+// {topic, deadband in published value * 10^decimals, heartbeat in ms}
+#if PUBLISH_PRESSURE_STATS
+#define PRESSURE_STATS_DEADBANDS        \
+    {"pressure_min", 10, 60000},        \
+    {"pressure_max", 10, 60000},        \
+    {"pressure_stddev", 100, 60000},
+#else
+#define PRESSURE_STATS_DEADBANDS
+#endif
+#define MQTT_DEADBANDS                  \
+    {"pressure", 10, 60000},            \
+    PRESSURE_STATS_DEADBANDS            \
+    {"temperature", 1, 60000},          \
+    {"humidity", 0, 60000}
+
+// Set to 1 to take single round of measurements per wake up and spend the rest of the period in deep sleep.
+// Web config server is not started in this mode.
+#define DEEP_SLEEP_MODE 0
+#define DEEP_SLEEP_PUBLISH_TIMEOUT_MS 10000 // Max time awake waiting for broker.
+
+#define RUN_BENCHMARKS 0 // Set to 1 to log microbenchmarks of hot paths on boot.
\ No newline at end of file
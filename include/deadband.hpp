@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+
+/**
+ * @brief Report by exception of single metric.
+ * Value passes only if it moved by more than band from last passed value,
+ * so noise around a stable value doesn't pass, or if heartbeat period elapsed since it,
+ * so consumers can tell silent metric from dead sensor. First value always passes.
+ * Depends only on standard headers so it can be compiled and checked anywhere.
+ *
+ * @tparam T Value type.
+ */
+template <typename T>
+class Deadband
+{
+private:
+    T band;
+    int64_t heartbeat;
+    T last = T();       //!< Last passed value.
+    int64_t lastTime = 0;
+    bool primed = false;
+
+public:
+    /**
+     * @brief Create deadband.
+     * @param band Change that is not reported, 0 reports every change.
+     * @param heartbeat Max time between passed values, in units of time given to pass().
+     */
+    Deadband(T band, int64_t heartbeat) : band(band), heartbeat(heartbeat) {}
+
+    /**
+     * @brief Check whether value should be reported, remember it if so.
+     * @param value Value.
+     * @param now Current time.
+     * @return True if value should be reported.
+     */
+    bool pass(T value, int64_t now)
+    {
+        T change = value > last ? value - last : last - value;
+        if (primed && change <= band && now - lastTime < heartbeat)
+            return false;
+
+        last = value;
+        lastTime = now;
+        primed = true;
+        return true;
+    }
+
+    void reset()
+    {
+        primed = false;
+    }
+};
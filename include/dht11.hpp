@@ -1,47 +1,61 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include "driver/gpio.h"
+#include "driver/rmt.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
 
 class DHT11
 {
-private:
-    gpio_num_t gpio; //!< DATA gpio.
-
+public:
     /**
-     * @brief Wait microseconds.
-     * @param us Microseconds to wait.
+     * @brief Read statistics.
      */
+    struct Stats
+    {
+        uint32_t reads;          //!< All calls to read().
+        uint32_t timeouts;       //!< Sensor didn't respond or sent too few bits.
+        uint32_t checksumErrors; //!< Frame was received but checksum didn't match.
+    };
 
-    inline void IRAM_ATTR waitMicros(uint64_t us);
+private:
+    gpio_num_t gpio;                         //!< DATA gpio.
+    rmt_channel_t channel;                   //!< RMT channel capturing DATA pulses.
+    RingbufHandle_t rxBuffer = nullptr;      //!< RMT receive buffer.
+    esp_timer_handle_t startTimer = nullptr; //!< Ends start signal.
 
-    /**
-     * @brief Set DATA gpio as input.
-     */
-    inline void IRAM_ATTR setInput();
+    std::atomic<uint32_t> reads{0};
+    std::atomic<uint32_t> timeouts{0};
+    std::atomic<uint32_t> checksumErrors{0};
 
     /**
-     * @brief Wait for given state.
-     * @param state State to wait.
-     * @param tout Timeout in microseconds.
-     * @return True if state appeared.
+     * @brief Start timer callback. Releases DATA line and starts capturing the response.
+     * @param arg This object.
      */
-    inline bool IRAM_ATTR waitForState(bool state, uint64_t tout);
-
-    /**
-     * @brief Set DATA pin to output and pull it to VCC.
-     */
-    inline void IRAM_ATTR setOutputAndPullHigh();
+    static void endStartSignal(void *arg);
 
 public:
-
     /**
      * @brief Initialize DHT11 sensor.
      * @param dataPin DATA pin.
+     * @param rmtChannel RMT channel used to capture pulses from the sensor.
      */
-    void init(gpio_num_t dataPin);
+    void init(gpio_num_t dataPin, rmt_channel_t rmtChannel = RMT_CHANNEL_0);
 
     /**
      * @brief Get humidity in %.
+     * Start signal is ended by a timer and response is captured by RMT peripheral,
+     * calling task sleeps for the whole ~25ms transaction.
+     * @return Humidity or -1 on failure.
      */
     float read();
-};
\ No newline at end of file
+
+    /**
+     * @brief Get read statistics, i.e. to compute failure rate.
+     * @return Statistics.
+     */
+    Stats getStats() const;
+};
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Hardware independent part of DHT11 driver.
+ * Depends only on <cstdint> so it can be compiled and checked anywhere.
+ */
+
+static const size_t DHT11_FRAME_BITS = 40;
+static const uint16_t DHT11_ONE_THRESHOLD_US = 40; //!< HIGH of "0" lasts 26 - 28us, HIGH of "1" lasts 70us.
+
+/**
+ * @brief Assemble DHT11 data frame from captured HIGH pulse widths.
+ * Each bit is LOW for 50us followed by HIGH whose length encodes the bit.
+ * Only last 40 pulses are used so pulses preceding the data (i.e. 80us response) are skipped.
+ * @param highWidths Widths of consecutive HIGH pulses in microseconds.
+ * @param count Number of pulses.
+ * @param frame Set to received bits, first transmitted bit at position 39.
+ * @return False if there are not enough pulses.
+ */
+inline bool DHT11_decodePulses(const uint16_t *highWidths, size_t count, uint64_t &frame)
+{
+    if (count < DHT11_FRAME_BITS)
+        return false;
+
+    frame = 0;
+    const uint16_t *bits = highWidths + count - DHT11_FRAME_BITS;
+    for (size_t i = 0; i < DHT11_FRAME_BITS; i++)
+    {
+        frame <<= 1;
+        if (bits[i] > DHT11_ONE_THRESHOLD_US)
+            frame |= 1;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Decode 40 bit DHT11 data frame.
+ * @param frame Received bits, first transmitted bit at position 39.
+ * @param humidity Set to integral part of humidity in % if frame is valid.
+ * @param temperature Set to integral part of temperature in °C if frame is valid.
+ * @return False on checksum mismatch.
+ */
+inline bool DHT11_decodeFrame(uint64_t frame, uint8_t &humidity, uint8_t &temperature)
+{
+    uint8_t checksum = frame;
+    uint8_t tempDecimal = (frame >> 8); // 0 for DHT11.
+    uint8_t tempIntegral = (frame >> 16);
+    uint8_t humDecimal = (frame >> 24); // 0 for DHT11.
+    uint8_t humIntegral = (frame >> 32);
+
+    // Check if data is valid.
+    uint8_t requiredChecksum = (uint64_t)(tempDecimal + tempIntegral + humDecimal + humIntegral); // Last 8 bits of sum.
+    if (checksum != requiredChecksum)
+        return false;
+
+    humidity = humIntegral;
+    temperature = tempIntegral;
+    return true;
+}
@@ -0,0 +1,226 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <type_traits>
+
+// Allocation-free filters of sensor samples.
+// Every filter has T update(T sample) returning current estimate and reset().
+// Depend only on standard headers so they can be compiled and checked anywhere.
+
+/**
+ * @brief Median of last N samples, removes single spikes without lag of averaging.
+ * Until N samples were seen median of those seen so far is returned.
+ *
+ * @tparam T Sample type.
+ * @tparam N Window size, odd.
+ */
+template <typename T, size_t N>
+class MedianFilter
+{
+    static_assert(N % 2 == 1, "Median window must be odd");
+
+private:
+    T window[N];
+    size_t next = 0;  //!< Index overwritten by next sample.
+    size_t count = 0; //!< Samples in window.
+
+public:
+    T update(T sample)
+    {
+        window[next] = sample;
+        next = (next + 1) % N;
+        if (count < N)
+            count++;
+
+        T sorted[N];
+        std::copy(window, window + count, sorted);
+        std::nth_element(sorted, sorted + count / 2, sorted + count);
+        return sorted[count / 2];
+    }
+
+    void reset()
+    {
+        next = 0;
+        count = 0;
+    }
+};
+
+/**
+ * @brief Exponential moving average with alpha = 1 / 2^Shift.
+ * State is kept scaled by 2^Shift so integer samples lose no precision.
+ * First sample initializes the average.
+ *
+ * @tparam T Sample type.
+ * @tparam Shift Smoothing, higher is smoother and slower.
+ */
+template <typename T, unsigned Shift>
+class EmaFilter
+{
+    static_assert(Shift < 16, "Shift too large");
+
+private:
+    static constexpr T scale = (T)(1 << Shift);
+
+    T acc = 0; //!< Average * 2^Shift.
+    bool primed = false;
+
+    static T rounded(T value)
+    {
+        // Integer division truncates towards zero, round to nearest instead.
+        if (std::is_integral<T>::value)
+            return (value + (value < 0 ? -scale / 2 : scale / 2)) / scale;
+        return value / scale;
+    }
+
+public:
+    T update(T sample)
+    {
+        if (!primed)
+        {
+            acc = sample * scale;
+            primed = true;
+        }
+        else
+        {
+            acc += sample - rounded(acc);
+        }
+
+        return rounded(acc);
+    }
+
+    void reset()
+    {
+        primed = false;
+    }
+};
+
+template <typename T, unsigned Shift>
+constexpr T EmaFilter<T, Shift>::scale;
+
+/**
+ * @brief Scalar Kalman filter of constant value with random walk.
+ * Gain adapts from trusting samples right after reset to the steady state given by noises.
+ *
+ * @tparam T Sample type.
+ */
+template <typename T>
+class KalmanFilter
+{
+private:
+    float q;            //!< Process noise variance per sample.
+    float r;            //!< Measurement noise variance.
+    float estimate = 0;
+    float p = 0;        //!< Variance of estimate.
+    bool primed = false;
+
+public:
+    /**
+     * @brief Create filter.
+     * @param processNoise Variance of true value change between samples.
+     * @param measurementNoise Variance of sample noise.
+     */
+    KalmanFilter(float processNoise, float measurementNoise) : q(processNoise), r(measurementNoise) {}
+
+    T update(T sample)
+    {
+        if (!primed)
+        {
+            estimate = sample;
+            p = r;
+            primed = true;
+        }
+        else
+        {
+            p += q;
+            float gain = p / (p + r);
+            estimate += gain * ((float)sample - estimate);
+            p *= 1 - gain;
+        }
+
+        return std::is_integral<T>::value ? (T)std::lround(estimate) : (T)estimate;
+    }
+
+    void reset()
+    {
+        primed = false;
+    }
+};
+
+/**
+ * @brief Count, min, max, mean and standard deviation of samples.
+ * Sums are taken relative to first sample so large values with small spread keep their precision.
+ *
+ * @tparam T Sample type.
+ */
+template <typename T>
+class RunningStats
+{
+private:
+    uint32_t n = 0;
+    T minimum = T();
+    T maximum = T();
+    T offset = T();   //!< First sample.
+    double sum = 0;   //!< Sum of sample - offset.
+    double sumSq = 0; //!< Sum of (sample - offset)^2.
+
+public:
+    void add(T sample)
+    {
+        if (n == 0)
+        {
+            minimum = maximum = offset = sample;
+        }
+        else
+        {
+            minimum = std::min(minimum, sample);
+            maximum = std::max(maximum, sample);
+        }
+
+        double d = (double)sample - (double)offset;
+        sum += d;
+        sumSq += d * d;
+        n++;
+    }
+
+    void reset()
+    {
+        n = 0;
+        sum = 0;
+        sumSq = 0;
+    }
+
+    uint32_t count() const
+    {
+        return n;
+    }
+
+    T min() const
+    {
+        return minimum;
+    }
+
+    T max() const
+    {
+        return maximum;
+    }
+
+    double mean() const
+    {
+        return n ? offset + sum / n : 0;
+    }
+
+    /**
+     * @brief Population standard deviation, 0 for less than 2 samples.
+     */
+    double stddev() const
+    {
+        if (n < 2)
+            return 0;
+
+        double m = sum / n;
+        double variance = sumSq / n - m * m;
+        return variance > 0 ? std::sqrt(variance) : 0;
+    }
+};
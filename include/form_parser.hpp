@@ -0,0 +1,187 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief Incremental application/x-www-form-urlencoded parser.
+ * Body may be fed in chunks of any size, memory use is fixed by field limits.
+ * Keys and values are percent-decoded and '+' becomes space.
+ * Depends only on standard headers so it can be compiled and checked anywhere.
+ *
+ * @tparam MaxKey Max length of decoded key.
+ * @tparam MaxValue Max length of decoded value.
+ */
+template <size_t MaxKey, size_t MaxValue>
+class FormParser
+{
+public:
+    /**
+     * @brief Called for every complete field.
+     * @param key Decoded key, null terminated.
+     * @param value Decoded value, null terminated, empty if field had no '='.
+     * @param ctx Context given to constructor.
+     */
+    typedef void (*FieldCallback)(const char *key, const char *value, void *ctx);
+
+    enum class Status : uint8_t
+    {
+        OK,
+        TOO_LONG,  //!< Key or value over its limit.
+        BAD_ESCAPE //!< '%' not followed by two hex digits or escaped null.
+    };
+
+private:
+    FieldCallback onField;
+    void *ctx;
+
+    char key[MaxKey + 1];
+    char value[MaxValue + 1];
+    size_t keyLen = 0;
+    size_t valueLen = 0;
+    bool inValue = false;   //!< '=' of current field was seen.
+    uint8_t escapeLen = 0;  //!< Hex digits of current escape seen so far, 0 if not in escape.
+    uint8_t escapeHigh = 0; //!< First hex digit of current escape.
+    Status status = Status::OK;
+
+    static int hexValue(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    /**
+     * @brief Append decoded character to key or value.
+     */
+    void append(char c)
+    {
+        if (c == 0)
+        {
+            status = Status::BAD_ESCAPE; // Fields are passed on as C strings.
+            return;
+        }
+
+        if (inValue)
+        {
+            if (valueLen == MaxValue)
+                status = Status::TOO_LONG;
+            else
+                value[valueLen++] = c;
+        }
+        else
+        {
+            if (keyLen == MaxKey)
+                status = Status::TOO_LONG;
+            else
+                key[keyLen++] = c;
+        }
+    }
+
+    /**
+     * @brief Pass current field to callback and start next one.
+     */
+    void endField()
+    {
+        if (escapeLen)
+        {
+            status = Status::BAD_ESCAPE;
+            return;
+        }
+
+        // "a&&b" and trailing '&' carry no field.
+        if (keyLen || inValue)
+        {
+            key[keyLen] = 0;
+            value[valueLen] = 0;
+            onField(key, value, ctx);
+        }
+
+        keyLen = 0;
+        valueLen = 0;
+        inValue = false;
+    }
+
+public:
+    /**
+     * @brief Create parser.
+     * @param onField Called for every complete field.
+     * @param ctx Passed to onField.
+     */
+    FormParser(FieldCallback onField, void *ctx) : onField(onField), ctx(ctx) {}
+
+    /**
+     * @brief Parse next chunk of body.
+     * After first error rest of the input is ignored.
+     * @param data Chunk.
+     * @param len Length of chunk.
+     * @return Status so far.
+     */
+    Status feed(const char *data, size_t len)
+    {
+        for (size_t i = 0; i < len && status == Status::OK; i++)
+        {
+            char c = data[i];
+
+            if (escapeLen)
+            {
+                int digit = hexValue(c);
+                if (digit < 0)
+                {
+                    status = Status::BAD_ESCAPE;
+                }
+                else if (escapeLen == 1)
+                {
+                    escapeHigh = digit;
+                    escapeLen = 2;
+                }
+                else
+                {
+                    escapeLen = 0;
+                    append((char)(escapeHigh << 4 | digit));
+                }
+                continue;
+            }
+
+            switch (c)
+            {
+            case '%':
+                escapeLen = 1;
+                break;
+            case '+':
+                append(' ');
+                break;
+            case '&':
+                endField();
+                break;
+            case '=':
+                // Only first '=' separates, later ones belong to the value.
+                if (inValue)
+                    append(c);
+                else
+                    inValue = true;
+                break;
+            default:
+                append(c);
+                break;
+            }
+        }
+
+        return status;
+    }
+
+    /**
+     * @brief End of body, passes last field to callback.
+     * @return Final status.
+     */
+    Status finish()
+    {
+        if (status == Status::OK)
+            endField();
+
+        return status;
+    }
+};
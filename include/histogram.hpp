@@ -0,0 +1,167 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief Lock-free latency histogram with power of two buckets.
+ * Bucket 0 counts 0us, bucket i counts [2^(i-1), 2^i - 1] us.
+ * Any number of tasks may record concurrently, counters are never reset
+ * so readers compute windows as difference of two snapshots.
+ * All counters are 32 bits, wider atomics take a lock on 32-bit targets.
+ * Depends only on standard headers so it can be compiled and checked anywhere.
+ */
+class LatencyHistogram
+{
+public:
+    static const size_t BUCKETS = 32;
+
+    /**
+     * @brief Plain copy of histogram counters.
+     */
+    struct Snapshot
+    {
+        uint32_t buckets[BUCKETS] = {};
+        uint32_t max = 0; //!< Max since boot, or since previous takeMax() when filled from it.
+        uint32_t sum = 0; //!< Sum of samples in microseconds, wraps so only windows below 2^32 us (71 min) are exact.
+
+        /**
+         * @brief Get number of samples.
+         */
+        uint32_t count() const
+        {
+            uint32_t n = 0;
+            for (size_t i = 0; i < BUCKETS; i++)
+                n += buckets[i];
+            return n;
+        }
+
+        /**
+         * @brief Estimate percentile as upper bound of bucket that holds it.
+         * @param permille Percentile in 0.1%, i.e. 990 for p99.
+         * @return Latency in microseconds, never more than max if max is known.
+         */
+        uint32_t percentile(uint32_t permille) const
+        {
+            uint32_t n = count();
+            if (n == 0)
+                return 0;
+
+            // Rank of the sample, rounded up.
+            uint64_t rank = ((uint64_t)n * permille + 999) / 1000;
+            if (rank == 0)
+                rank = 1;
+
+            uint64_t seen = 0;
+            for (size_t i = 0; i < BUCKETS; i++)
+            {
+                seen += buckets[i];
+                if (seen >= rank)
+                {
+                    uint32_t upper = upperBound(i);
+                    return (max && max < upper) ? max : upper;
+                }
+            }
+            return max;
+        }
+
+        /**
+         * @brief Accumulate other snapshot, i.e. to merge per core histograms.
+         * @param other Snapshot to add.
+         */
+        void add(const Snapshot &other)
+        {
+            for (size_t i = 0; i < BUCKETS; i++)
+                buckets[i] += other.buckets[i];
+            sum += other.sum;
+            if (other.max > max)
+                max = other.max;
+        }
+
+        /**
+         * @brief Subtract older snapshot to get counts of the window between them.
+         * @param older Older snapshot.
+         */
+        void subtract(const Snapshot &older)
+        {
+            for (size_t i = 0; i < BUCKETS; i++)
+                buckets[i] -= older.buckets[i];
+            sum -= older.sum;
+        }
+    };
+
+    /**
+     * @brief Get upper bound of bucket.
+     * @param bucket Bucket index.
+     * @return Largest latency counted in the bucket.
+     */
+    static uint32_t upperBound(size_t bucket)
+    {
+        return bucket >= 32 ? UINT32_MAX : (uint32_t)((1ull << bucket) - 1);
+    }
+
+    /**
+     * @brief Get bucket of given latency.
+     * @param us Latency in microseconds.
+     * @return Bucket index.
+     */
+    static size_t bucketOf(uint32_t us)
+    {
+        size_t bucket = us ? 32 - __builtin_clz(us) : 0;
+        return bucket < BUCKETS ? bucket : BUCKETS - 1;
+    }
+
+    /**
+     * @brief Record single sample.
+     * @param us Latency in microseconds.
+     */
+    void record(uint32_t us)
+    {
+        buckets[bucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(us, std::memory_order_relaxed);
+        raiseMax(maxEver, us);
+        raiseMax(maxSinceTake, us);
+    }
+
+    /**
+     * @brief Copy counters, sum and max since boot.
+     * @param out Snapshot to fill.
+     */
+    void snapshot(Snapshot &out) const
+    {
+        for (size_t i = 0; i < BUCKETS; i++)
+            out.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+        out.sum = total.load(std::memory_order_relaxed);
+        out.max = maxEver.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Get max latency since previous call and reset it.
+     * Max since boot reported by snapshot() is kept.
+     * @return Max latency in microseconds.
+     */
+    uint32_t takeMax()
+    {
+        return maxSinceTake.exchange(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint32_t> buckets[BUCKETS] = {};
+    std::atomic<uint32_t> total{0};        //!< Sum of samples, wraps, see Snapshot::sum.
+    std::atomic<uint32_t> maxEver{0};      //!< Never reset.
+    std::atomic<uint32_t> maxSinceTake{0}; //!< Reset by takeMax().
+
+#if __cplusplus >= 201703L
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "record() must not take a lock");
+#else
+    static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LONG_LOCK_FREE == 2, "record() must not take a lock");
+#endif
+
+    static void raiseMax(std::atomic<uint32_t> &max, uint32_t us)
+    {
+        uint32_t prevMax = max.load(std::memory_order_relaxed);
+        while (us > prevMax && !max.compare_exchange_weak(prevMax, us, std::memory_order_relaxed))
+        {
+        }
+    }
+};
@@ -1,5 +1,6 @@
 #pragma once
 #include "driver/gpio.h"
+#include "dht11.hpp"
 
 /**
  * @brief Initialize HTTP server.
@@ -7,5 +8,6 @@
  * 
  * @param btn Button to toggle server on / off.
  * @param led Indicator LED.
+ * @param humiditySensor Sensor whose read statistics are exported on /metrics, may be NULL.
  */
-void HTTP_init(gpio_num_t btn, gpio_num_t led);
\ No newline at end of file
+void HTTP_init(gpio_num_t btn, gpio_num_t led, const DHT11 *humiditySensor);
\ No newline at end of file
@@ -2,27 +2,69 @@
 
 #include "driver/i2c.h"
 
+/**
+ * @brief Slave on shared I2C bus.
+ */
+struct I2C_Device
+{
+    uint8_t addr;      //!< 8 bit address, R/W bit is set by transaction.
+    uint32_t maxFreq;  //!< Max clock of slave, bus runs at lower of this and bus max while talking to it.
+};
+
+/**
+ * @brief Statistics of I2C bus.
+ */
+struct I2C_Stats
+{
+    uint32_t transactions; //!< Transactions started.
+    uint32_t errors;       //!< Failed transactions, including NACKs.
+    uint32_t recoveries;   //!< Bus recoveries after timeout.
+};
+
 /**
  * @brief Initialize I2C peripheral.
+ * Bus is recovered first in case slave holds SDA low after reset in middle of transaction.
  * @param port I2C port.
  * @param sda SDA GPIO.
  * @param scl SCL GPIO.
- * @param freq Frequency.
+ * @param maxFreq Max clock the bus wiring allows, fast mode (400 kHz) needs external pull ups.
+ */
+void I2C_init(i2c_port_t  port, gpio_num_t sda, gpio_num_t scl, uint32_t maxFreq);
+
+/**
+ * @brief Read contiguous block of registers from I2C slave in single transaction.
+ * Transactions of all tasks are serialized by bus lock.
+ * Bus is recovered if transaction times out, error is returned anyway.
+ * @param dev Slave.
+ * @param reg First register to read data from.
+ * @param data Buffer for read bytes.
+ * @param len Number of bytes to read.
+ * @return ESP error.
+ */
+esp_err_t I2C_read(const I2C_Device &dev, uint8_t reg, uint8_t *data, size_t len);
+
+/**
+ * @brief Write contiguous block of registers to I2C slave in single transaction.
+ * Serialized and recovered the same way as I2C_read().
+ * @param dev Slave.
+ * @param reg First register to write data to.
+ * @param data Bytes to write.
+ * @param len Number of bytes to write.
+ * @return ESP error.
  */
-void I2C_init(i2c_port_t  port, gpio_num_t sda, gpio_num_t scl, uint32_t freq);
+esp_err_t I2C_write(const I2C_Device &dev, uint8_t reg, const uint8_t *data, size_t len);
 
 /**
  * @brief Write single byte to I2C slave.
- * @param addr Slave address.
+ * @param dev Slave.
  * @param reg Register to write byte to.
  * @param b Byte to write.
+ * @return ESP error.
  */
-void I2C_writeByte(uint8_t addr,  uint8_t reg, uint8_t b);
+esp_err_t I2C_writeByte(const I2C_Device &dev, uint8_t reg, uint8_t b);
 
 /**
- * @brief Read two bytes from I2C slave.
- * @param addr Slave address.
- * @param reg Register to read data from.
- * @return Register value from slave.
+ * @brief Get statistics of I2C bus.
+ * @return Statistics.
  */
-uint16_t I2C_readRegister(uint8_t addr, uint8_t reg);
\ No newline at end of file
+I2C_Stats I2C_getStats();
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include "esp_http_server.h"
+
+/**
+ * @brief Statistics of live feed.
+ */
+struct Live_Stats
+{
+    uint32_t clients;        //!< Clients connected right now.
+    uint32_t rejected;       //!< Clients refused because max number of clients was connected.
+    uint32_t events;         //!< Samples sent to clients.
+    uint32_t droppedEvents;  //!< Samples not sent because every event buffer was still being sent.
+    uint32_t droppedClients; //!< Clients disconnected because they didn't keep up.
+};
+
+/**
+ * @brief Register /live endpoint on running HTTP server.
+ * Every sample is pushed to connected clients as Server-Sent Event
+ * data: {"topic":"temperature","value":21.50,"ts":<ms since epoch>}
+ *
+ * Each sample is encoded once and the same buffer is sent to every client.
+ * Sends never block, client whose socket buffer is full is disconnected,
+ * so slow client can't hold back publisher or sensor tasks.
+ * @param server HTTP server. Its close_fn must be Live_closeSocket().
+ */
+void Live_start(httpd_handle_t server);
+
+/**
+ * @brief Stop feeding clients, call before stopping HTTP server.
+ */
+void Live_stop();
+
+/**
+ * @brief Close function of HTTP server's sockets, removes closed socket from clients.
+ * @param server HTTP server.
+ * @param sockfd Socket.
+ */
+void Live_closeSocket(httpd_handle_t server, int sockfd);
+
+/**
+ * @brief Push sample to connected clients. Never blocks, fits MQTT_setSampleSink().
+ * @param topic Topic.
+ * @param value Formatted value.
+ * @param timestamp Capture time in µs since epoch.
+ */
+void Live_push(const char *topic, const char *value, int64_t timestamp);
+
+/**
+ * @brief Get statistics of live feed.
+ * @return Statistics.
+ */
+Live_Stats Live_getStats();
@@ -1,96 +1,213 @@
 #pragma once
+#include <cstdint>
+#include "snapshot.hpp"
+#include "sample.hpp"
 #include "driver/gpio.h"
 
+/**
+ * @brief MQTT settings.
+ */
+struct MQTT_Settings
+{
+    char ip[16];       //!< Broker's IP.
+    char port[6];      //!< Broker's port.
+    char username[33]; //!< Username.
+    char password[33]; //!< Password.
+    char ns[33];       //!< Namespace prepended to every topic.
+    char batchMode[5]; //!< "off", "json" or "cbor".
+};
+
+/**
+ * @brief Read-only handle of settings version, see MQTT_getSettings().
+ */
+typedef Snapshots<MQTT_Settings>::Ref MQTT_SettingsRef;
+
+/**
+ * @brief Statistics of publish queue.
+ */
+struct MQTT_QueueStats
+{
+    uint32_t depth;          //!< Samples waiting for publisher task right now.
+    uint32_t maxDepth;       //!< Highest depth of single task's queue seen so far.
+    uint32_t published;      //!< Samples handed to MQTT client.
+    uint32_t suppressed;     //!< Samples not published because they stayed within deadband of their topic.
+    uint32_t droppedFull;    //!< Samples lost because task's queue was full.
+    uint32_t droppedNoQueue; //!< Samples lost because all producer queues were taken by other tasks.
+    uint32_t droppedOffline; //!< Samples lost because broker was not connected and sample log was not available.
+    uint32_t unacknowledged; //!< QoS > 0 messages whose acknowledge didn't arrive before their session was replaced.
+    uint32_t stored;         //!< Samples stored in sample log because broker was not connected.
+    uint32_t replayed;       //!< Stored samples published after reconnect.
+    uint32_t storedPending;  //!< Stored samples waiting for replay.
+};
+
+/**
+ * @brief Statistics of broker connection.
+ */
+struct MQTT_ConnectionStats
+{
+    bool connected;           //!< Active session is connected right now.
+    uint32_t connects;        //!< Connections to broker, including reconnects and new sessions after MQTT_reInit().
+    uint32_t disconnects;     //!< Connections of active session lost.
+    uint32_t publishFailures; //!< Messages MQTT client refused to publish.
+};
+
+/**
+ * @brief Receiver of every sample, see MQTT_setSampleSink().
+ * @param topic Topic without namespace.
+ * @param value Value formatted the same way as published.
+ * @param timestamp Capture time in µs since epoch.
+ */
+typedef void (*MQTT_SampleSink)(const char *topic, const char *value, int64_t timestamp);
+
+/**
+ * @brief Handler of messages received on <namespace>/cmd, see MQTT_setCommandHandler().
+ * @param payload Payload, not null terminated.
+ * @param len Length of payload.
+ * @param reply Output, null terminated text published to <namespace>/cmd/result.
+ * @param replySize Size of reply buffer.
+ */
+typedef void (*MQTT_CommandHandler)(const char *payload, size_t len, char *reply, size_t replySize);
+
 /**
  * @brief Init MQTT client. 
- * Must be able to take resources using MQTT_resourceTake().
  * 
  * @param LEDGPIO Led GPIO.
  */
 void MQTT_init(gpio_num_t LEDGPIO);
 
 /**
- * @brief Reinit MQTT client. Should be called after MQTT_updateX functions.
- * Must be able to take resources using MQTT_resourceTake().
+ * @brief Save changes made by MQTT_updateX functions to flash with single commit and apply them.
+ * Should be called after MQTT_updateX functions.
+ * Namespace and batch mode apply to next sample without reconnecting.
+ * Broker or credentials change starts new client and switches to it once it's connected (or after 5 s),
+ * previous client publishes meanwhile and is destroyed afterwards.
  */
 void MQTT_reInit();
 
 /**
- * @brief Take ownership of MQTT's resources.
- * Use this before any MQTT_getX().
+ * @brief Publish float to MQTT broker.
+ * Every calling task gets its own queue, up to 4 tasks, samples of further tasks are dropped (droppedNoQueue).
+ * Every calling task gets its own queue, up to 4 tasks.
+ * If broker is not connected sample is stored in flash and replayed after reconnect.
+ * @param topic Topic to publish to, up to 15 characters.
+ * @param data Data to publish.
+ * @param qos QoS.
  */
-void MQTT_resourceTake();
+void MQTT_publish(const char* topic, float data, int qos);
 
 /**
- * @brief Release ownership of MQTT's resources.
- * Use this after finished using all of the MQTT_getX().
+ * @brief Publish fixed point value to MQTT broker without using floating point.
+ * I.e. value 101325 with 2 decimals is published as "1013.25".
+ * Queued the same way as MQTT_publish().
+ * @param topic Topic to publish to, up to 15 characters.
+ * @param value Value scaled by 10^decimals.
+ * @param decimals Number of decimal digits in value.
+ * @param qos QoS.
  */
-void MQTT_resourceRelease();
+void MQTT_publishFixed(const char *topic, int32_t value, uint8_t decimals, int qos);
 
 /**
- * @brief Publish float to MQTT broker.
- * @param topic Topic to publish to.
- * @param data Data to publish.
+ * @brief Publish sensor sample to MQTT broker.
+ * Payload carries capture time, sensor and sequence number besides the value,
+ * see README for format. Queued the same way as MQTT_publish().
+ * @param topic Topic to publish to, up to 15 characters.
+ * @param record Sample.
  * @param qos QoS.
  */
-void MQTT_publish(const char* topic, float data, int qos);
+void MQTT_publishSample(const char *topic, const SampleRecord &record, int qos);
+
+/**
+ * @brief Wait until broker is connected.
+ * @param timeoutMs Max time to wait.
+ * @return True if connected.
+ */
+bool MQTT_waitConnected(uint32_t timeoutMs);
+
+/**
+ * @brief Wait until no sample is left in RAM, i.e. before deep sleep.
+ * Open batch window is closed right away.
+ * While connected samples must be published and QoS > 0 messages acknowledged,
+ * while not connected they must be stored in flash.
+ * @param timeoutMs Max time to wait.
+ * @return True if all samples were published or stored, false on timeout.
+ */
+bool MQTT_flush(uint32_t timeoutMs);
+
+/**
+ * @brief Set function that gets every sample as it leaves producer queue, whether broker is connected or not.
+ * Sink is called from publisher task and must not block.
+ * @param sink Sink, NULL to remove.
+ */
+void MQTT_setSampleSink(MQTT_SampleSink sink);
+
+/**
+ * @brief Set function handling commands received on <namespace>/cmd.
+ * Handler is called from MQTT client's task.
+ * @param handler Handler, NULL to ignore commands.
+ */
+void MQTT_setCommandHandler(MQTT_CommandHandler handler);
 
 /**
- * @brief Update IP in flash.
+ * @brief Get statistics of publish queue.
+ * @return Statistics.
+ */
+MQTT_QueueStats MQTT_getQueueStats();
+
+/**
+ * @brief Get statistics of broker connection.
+ * @return Statistics.
+ */
+MQTT_ConnectionStats MQTT_getConnectionStats();
+
+/**
+ * @brief Stage IP change, saved by MQTT_reInit().
  * @param ip IP to set.
  */
 void MQTT_updateIP(const char *ip);
 
 /**
- * @brief Update port in flas.
+ * @brief Stage port change, saved by MQTT_reInit().
  * @param port Port to set.
  */
 void MQTT_updatePort(const char *port);
 
 /**
- * @brief Update username in flash.
+ * @brief Stage username change, saved by MQTT_reInit().
  * @param usr Username to set.
  */
 void MQTT_updateUser(const char *usr);
 
 /**
- * @brief Update password in flash.
+ * @brief Stage password change, saved by MQTT_reInit().
  * @param passwd Password to set.
  */
 void MQTT_updatePassword(const char *passwd);
 
 /**
- * @brief Update namespace in flash.
+ * @brief Stage namespace change, saved by MQTT_reInit().
  * @param ns Namespace to set.
  */
 void MQTT_updateNamespace(const char *ns);
 
 /**
- * @brief Get currently set IP.
- * @return IP.
- */
-const char* MQTT_getIP();
-
-/**
- * @brief Get currently set port.
- * @return Port.
- */
-const char* MQTT_getPort();
-
-/**
- * @brief Get currently set username.
- * @return Username.
+ * @brief Stage batch mode change, saved by MQTT_reInit().
+ * In batched mode samples arriving within one second are published as single message on <namespace>/batch.
+ * @param mode "off", "json" or "cbor".
  */
-const char* MQTT_getUser();
+void MQTT_updateBatchMode(const char *mode);
 
 /**
- * @brief Get currently set password.
- * @return Password.
+ * @brief Apply and save batch mode right away, staged changes stay staged.
+ * Batch mode staged by MQTT_updateBatchMode() and not applied yet is kept and still replaces this one on MQTT_reInit().
+ * Never reconnects, so unlike MQTT_reInit() it's safe to call from command handler running in MQTT client task.
+ * @param mode "off", "json" or "cbor".
  */
-const char* MQTT_getPassword();
+void MQTT_setBatchMode(const char *mode);
 
 /**
- * @brief Get currently set namespace.
- * @return Namespace.
+ * @brief Get settings in use.
+ * Never blocks, settings held by returned handle stay consistent even if they are updated meanwhile.
+ * Don't keep the handle for long, updates wait for free version slot.
+ * @return Handle of current settings.
  */
-const char* MQTT_getNamespace();
\ No newline at end of file
+MQTT_SettingsRef MQTT_getSettings();
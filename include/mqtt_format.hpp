@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+
+/**
+ * Topic and payload formatting shared by MQTT publish path and benchmarks.
+ * Depends only on <cstdio> so it can be compiled and checked anywhere.
+ */
+
+/**
+ * @brief Build full topic as <namespace>/<topic> or <namespace>/<topic>/<suffix>.
+ * @param buf Output buffer.
+ * @param size Size of output buffer.
+ * @param ns Namespace.
+ * @param topic Topic without namespace.
+ * @param suffix Appended subtopic, NULL for none.
+ * @return Length of topic or 0 if it didn't fit.
+ */
+inline size_t MQTT_formatTopic(char *buf, size_t size, const char *ns, const char *topic, const char *suffix = NULL)
+{
+    int len = suffix ? snprintf(buf, size, "%s/%s/%s", ns, topic, suffix) : snprintf(buf, size, "%s/%s", ns, topic);
+    if (len <= 0 || (size_t)len >= size)
+        return 0;
+    return len;
+}
+
+/**
+ * @brief Format fixed point value without using floating point.
+ * I.e. 101325 with 2 decimals gives "1013.25", -5 with 2 decimals gives "-0.05".
+ * @param buf Output buffer.
+ * @param size Size of output buffer.
+ * @param value Value scaled by 10^decimals.
+ * @param decimals Number of decimal digits in value.
+ */
+inline void MQTT_formatFixed(char *buf, size_t size, int32_t value, uint8_t decimals)
+{
+    uint32_t divider = 1;
+    for (uint8_t i = 0; i < decimals; i++)
+        divider *= 10;
+
+    // Work on magnitude so sign of values between -1 and 0 isn't lost.
+    const char *sign = value < 0 ? "-" : "";
+    uint32_t magnitude = value < 0 ? -(uint32_t)value : value;
+    if (decimals)
+        snprintf(buf, size, "%s%u.%0*u", sign, (unsigned)(magnitude / divider), decimals, (unsigned)(magnitude % divider));
+    else
+        snprintf(buf, size, "%s%u", sign, (unsigned)magnitude);
+}
+
+/**
+ * @brief Format payload of single sample as <value>,<capture time in ms since epoch>,<sensor>,<seq>,<n>.
+ * @param buf Output buffer.
+ * @param size Size of output buffer.
+ * @param value Formatted value.
+ * @param timestampUs Capture time in µs since epoch.
+ * @param sensor Name of sensor.
+ * @param seq Sequence number of sensor read.
+ * @param topicSeq Number of message on its topic.
+ */
+inline void MQTT_formatPayload(char *buf, size_t size, const char *value, int64_t timestampUs, const char *sensor, uint32_t seq, uint32_t topicSeq)
+{
+    snprintf(buf, size, "%s,%lld,%s,%u,%u", value, (long long)(timestampUs / 1000), sensor, (unsigned)seq, (unsigned)topicSeq);
+}
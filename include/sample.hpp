@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+
+/**
+ * @brief Source of sample.
+ */
+enum class SensorId : uint8_t
+{
+    NONE,   //!< Not a sensor reading, i.e. device statistics.
+    BMP180, //!< Temperature and pressure sensor.
+    DHT11,  //!< Humidity sensor.
+    COUNT
+};
+
+/**
+ * @brief Single captured value.
+ * All values derived from one sensor read (or one aggregate of reads) share its timestamp and sequence number.
+ */
+struct SampleRecord
+{
+    int64_t timestamp; //!< Capture time in µs since epoch, 0 if clock was not set yet.
+    uint32_t seq;      //!< Starts at 1 and is incremented by every read of the sensor, gaps are samples suppressed by deadband or dropped before publishing.
+    SensorId sensor;   //!< Source.
+    int32_t value;     //!< Value scaled by 10^decimals.
+    uint8_t decimals;  //!< Decimals of value.
+};
+
+/**
+ * @brief Get name of sensor as used in payloads.
+ * @param sensor Sensor.
+ * @return Name.
+ */
+inline const char *Sample_sensorName(SensorId sensor)
+{
+    switch (sensor)
+    {
+    case SensorId::BMP180:
+        return "bmp180";
+    case SensorId::DHT11:
+        return "dht11";
+    default:
+        return "none";
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+static const size_t SAMPLE_LOG_PAYLOAD_SIZE = 40; //!< Size of single record's payload.
+
+/**
+ * @brief Statistics of sample log.
+ */
+struct SampleLog_Stats
+{
+    uint32_t pending;     //!< Records waiting to be consumed.
+    uint32_t capacity;    //!< Max number of records in the log.
+    uint32_t overwritten; //!< Unconsumed records lost because log was full.
+};
+
+/**
+ * @brief Init bounded on-flash ring log of fixed size records.
+ * Uses data partition labeled "samples" and recovers pending records left from before reboot.
+ *
+ * Log is written strictly sequentially and each flash sector is erased only once per full pass
+ * around the partition, so wear is spread evenly over all of its sectors.
+ * Consumed records are marked by clearing bits in place, which needs no erase.
+ * When log is full the oldest sector is erased and its pending records are lost.
+ *
+ * Not thread safe, all functions must be called from the same task.
+ * @return False if partition was not found. Log stays disabled then.
+ */
+bool SampleLog_init();
+
+/**
+ * @brief Append record at the end of the log.
+ * @param data Record payload.
+ * @param size Size of the payload, max SAMPLE_LOG_PAYLOAD_SIZE.
+ * @return False if log is disabled or flash write failed.
+ */
+bool SampleLog_append(const void *data, size_t size);
+
+/**
+ * @brief Get oldest pending record without consuming it.
+ * @param data Buffer of SAMPLE_LOG_PAYLOAD_SIZE bytes for the payload.
+ * @return False if there are no pending records.
+ */
+bool SampleLog_peek(void *data);
+
+/**
+ * @brief Mark oldest pending record as consumed.
+ */
+void SampleLog_consume();
+
+/**
+ * @brief Get statistics of the log.
+ * @return Statistics.
+ */
+SampleLog_Stats SampleLog_getStats();
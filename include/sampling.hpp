@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include "snapshot.hpp"
+#include "bmp180.hpp"
+
+/**
+ * @brief Sampling settings changeable at run time.
+ */
+struct Sampling_Settings
+{
+    uint32_t intervalMs;                  //!< Publish interval of every sensor.
+    BMP180::MeasurementType pressureMode; //!< BMP180 mode of pressure samples.
+    uint8_t qos;                          //!< QoS of sensor samples.
+};
+
+/**
+ * @brief Read-only handle of settings version, see Sampling_getSettings().
+ */
+typedef Snapshots<Sampling_Settings>::Ref Sampling_SettingsRef;
+
+/**
+ * @brief Load settings from flash, defaults come from config.hpp.
+ * NVS must be initialized before call to this function.
+ */
+void Sampling_init();
+
+/**
+ * @brief Get settings in use. Never blocks, see MQTT_getSettings().
+ * Sensor job should take single handle per run so every change applies to it as a whole.
+ * @return Handle of current settings.
+ */
+Sampling_SettingsRef Sampling_getSettings();
+
+/**
+ * @brief Apply command received on <namespace>/cmd, fits MQTT_setCommandHandler().
+ * Command is form encoded, i.e. "interval=10000&mode=high_res&qos=0&batch=cbor",
+ * every field is optional:
+ * - interval: publish interval in ms,
+ * - mode: BMP180 mode of pressure samples, "low_power", "standard", "high_res" or "ultra_high_res",
+ * - qos: QoS of sensor samples, 0 - 2,
+ * - batch: "off", "json" or "cbor", see MQTT_setBatchMode().
+ * Either all fields are valid and applied together and saved to flash, or nothing changes.
+ * Must be called from single task.
+ * @param payload Command.
+ * @param len Length of command.
+ * @param reply Output, "ok" or error description.
+ * @param replySize Size of reply buffer.
+ */
+void Sampling_handleCommand(const char *payload, size_t len, char *reply, size_t replySize);
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief Periodic job run by scheduler.
+ */
+struct Scheduler_Job
+{
+    const char *name;         //!< Name used in logs and statistics.
+    void (*run)(void *ctx);   //!< Job, runs in scheduler's worker task.
+    void *ctx;                //!< Passed to run.
+    uint32_t periodMs;        //!< Time between releases, see Scheduler_setPeriod().
+    uint32_t phaseMs;         //!< Offset of first release from scheduler start.
+    uint32_t deadlineMs;      //!< Max time from release to end of run.
+};
+
+/**
+ * @brief Statistics of single job.
+ */
+struct Scheduler_JobStats
+{
+    const char *name;        //!< Job name.
+    uint32_t runs;           //!< Completed runs.
+    uint32_t deadlineMisses; //!< Runs that ended after their deadline.
+    uint32_t skipped;        //!< Releases dropped because previous jobs overran them.
+    uint32_t maxJitterUs;    //!< Longest delay of start after release.
+    uint32_t maxRunUs;       //!< Longest run.
+};
+
+/**
+ * @brief Start single worker task running table of periodic jobs.
+ * Releases are computed from scheduler start, not from end of previous run, so periods don't drift.
+ * Worker sleeps on esp_timer until next release and runs jobs one at a time,
+ * job released at the same time as other one waits for it (table order decides).
+ * Job that overruns whole periods of itself skips them instead of running late in a burst.
+ * Start jitter is also recorded as TracePoint::JOB_JITTER.
+ * @param jobs Job table, must stay valid for the life of scheduler.
+ * @param count Number of jobs, up to 8.
+ * @return False if table is too long or scheduler is already running.
+ */
+bool Scheduler_start(const Scheduler_Job *jobs, size_t count);
+
+/**
+ * @brief Change period of job, applies from its next release.
+ * @param index Index of job in table.
+ * @param periodMs New period.
+ * @return False if there is no such job.
+ */
+bool Scheduler_setPeriod(size_t index, uint32_t periodMs);
+
+/**
+ * @brief Get statistics of job.
+ * @param index Index of job in table.
+ * @param stats Output.
+ * @return False if there is no such job.
+ */
+bool Scheduler_getStats(size_t index, Scheduler_JobStats &stats);
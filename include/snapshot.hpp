@@ -0,0 +1,134 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief Immutable versioned snapshots of value, RCU style.
+ * Readers get consistent value without locking and never wait for writer.
+ * Writer copies new value to slot no reader holds and swaps it in atomically.
+ * Depends only on standard headers so it can be compiled and checked anywhere.
+ *
+ * @tparam T Value type, should be trivially copyable.
+ * @tparam N Number of slots, limits how many versions may be held by readers at once.
+ */
+template <typename T, size_t N = 3>
+class Snapshots
+{
+    static_assert(N >= 2, "Writer needs at least one slot besides current one");
+
+private:
+    struct Slot
+    {
+        T value;
+        uint32_t version = 0;
+        std::atomic<uint32_t> refs{0}; //!< Readers holding this slot.
+    };
+
+    Slot slots[N];
+    std::atomic<Slot *> current{&slots[0]};
+
+public:
+    /**
+     * @brief Reader's handle of single version. Value stays valid and unchanged until handle is destroyed.
+     */
+    class Ref
+    {
+    private:
+        Slot *slot;
+
+        explicit Ref(Slot *slot) : slot(slot) {}
+        friend class Snapshots;
+
+    public:
+        Ref(const Ref &) = delete;
+        Ref &operator=(const Ref &) = delete;
+
+        Ref(Ref &&other) : slot(other.slot)
+        {
+            other.slot = nullptr;
+        }
+
+        ~Ref()
+        {
+            if (slot)
+                slot->refs.fetch_sub(1, std::memory_order_release);
+        }
+
+        const T &operator*() const
+        {
+            return slot->value;
+        }
+
+        const T *operator->() const
+        {
+            return &slot->value;
+        }
+
+        /**
+         * @brief Get version of held value, incremented by every publish().
+         */
+        uint32_t version() const
+        {
+            return slot->version;
+        }
+    };
+
+    /**
+     * @brief Get current value. Lock-free, safe to call from any task.
+     * @return Handle of current value.
+     */
+    Ref acquire()
+    {
+        while (true)
+        {
+            Slot *slot = current.load();
+            slot->refs.fetch_add(1);
+
+            // Writer may have reused the slot before it was pinned, retry then.
+            if (current.load() == slot)
+                return Ref(slot);
+
+            slot->refs.fetch_sub(1);
+        }
+    }
+
+    /**
+     * @brief Make value current. Writers must be serialized by caller.
+     * @param value New value.
+     * @return False if every other slot is held by readers, try again later then.
+     */
+    bool publish(const T &value)
+    {
+        Slot *old = current.load();
+        for (Slot &slot : slots)
+        {
+            if (&slot == old || slot.refs.load() != 0)
+                continue;
+
+            // Pin the slot so reader that loaded it as stale current backs off.
+            slot.refs.fetch_add(1);
+            if (slot.refs.load() != 1)
+            {
+                slot.refs.fetch_sub(1);
+                continue;
+            }
+
+            slot.value = value;
+            slot.version = old->version + 1;
+            current.store(&slot);
+            slot.refs.fetch_sub(1);
+            return true;
+        }
+
+        return false;
+    }
+
+    /**
+     * @brief Get version of current value.
+     */
+    uint32_t version() const
+    {
+        return current.load()->version;
+    }
+};
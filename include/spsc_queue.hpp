@@ -0,0 +1,71 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief Lock-free single producer, single consumer ring buffer of fixed size records.
+ * Both sides never block and never allocate.
+ * Depends only on standard headers so it can be compiled and checked anywhere.
+ *
+ * @tparam T Record type, should be trivially copyable.
+ * @tparam N Capacity, must be power of two.
+ */
+template <typename T, uint32_t N>
+class SPSCQueue
+{
+    static_assert(N && (N & (N - 1)) == 0, "Capacity must be power of two");
+
+private:
+    T items[N];
+    std::atomic<uint32_t> head{0}; //!< Next write index, advanced by producer only.
+    std::atomic<uint32_t> tail{0}; //!< Next read index, advanced by consumer only.
+
+public:
+    /**
+     * @brief Add record to the queue. Call from producer only.
+     * @param item Record to add.
+     * @return False if queue is full.
+     */
+    bool push(const T &item)
+    {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == N)
+            return false;
+
+        items[h & (N - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Take oldest record from the queue. Call from consumer only.
+     * @param item Set to taken record.
+     * @return False if queue is empty.
+     */
+    bool pop(T &item)
+    {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire))
+            return false;
+
+        item = items[t & (N - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Get number of records in the queue. Safe to call from any task.
+     */
+    uint32_t size() const
+    {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Get capacity of the queue.
+     */
+    static constexpr uint32_t capacity()
+    {
+        return N;
+    }
+};
@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+
+/**
+ * @brief Start periodic SNTP sync of system clock.
+ * Called on every WiFi connect, only first call starts the client.
+ */
+void TimeSync_start();
+
+/**
+ * @brief Check whether system clock holds real time.
+ * Clock keeps running through deep sleep, so it stays valid after wake up until next sync.
+ * @return True if clock was set by SNTP.
+ */
+bool TimeSync_isValid();
+
+/**
+ * @brief Get current time for sample timestamps.
+ * @return Time in µs since epoch, 0 if clock is not valid.
+ */
+int64_t TimeSync_nowUs();
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include "esp_timer.h"
+
+/**
+ * @brief Traced operations.
+ */
+enum class TracePoint : uint8_t
+{
+    BMP180_READ,  //!< Whole BMP180 measurement cycle.
+    DHT11_READ,   //!< Single DHT11 transaction.
+    MQTT_PUBLISH, //!< Formatting and handing single message to MQTT client.
+    HTTP_GET,     //!< GET handler.
+    HTTP_POST,    //!< POST handler.
+    WIFI_CONNECT, //!< From connect request to got IP.
+    JOB_JITTER,   //!< Delay of scheduled job's start after its release time.
+    COUNT
+};
+
+/**
+ * @brief Latency summary of single trace point.
+ */
+struct Trace_Summary
+{
+    uint32_t count; //!< Number of samples.
+    uint32_t p50;   //!< Median in us (upper bound of histogram bucket).
+    uint32_t p99;   //!< 99th percentile in us (upper bound of histogram bucket).
+    uint32_t max;   //!< Max in us.
+    uint32_t sum;   //!< Sum of all samples in us, wraps after 2^32 us (71 min) like counter reset.
+};
+
+/**
+ * @brief Record latency of trace point.
+ * Lock-free, safe to call from any task on any core.
+ * @param point Trace point.
+ * @param us Latency in microseconds.
+ */
+void Trace_record(TracePoint point, uint32_t us);
+
+/**
+ * @brief Get name of trace point.
+ * @param point Trace point.
+ * @return Name.
+ */
+const char *Trace_name(TracePoint point);
+
+/**
+ * @brief Get summary of trace point since boot.
+ * @param point Trace point.
+ * @return Summary, max is max since boot as well.
+ */
+Trace_Summary Trace_getSummary(TracePoint point);
+
+/**
+ * @brief Format summaries of all trace points since previous call as JSON.
+ * I.e. {"bmp180_read":{"n":12,"p50":63,"p99":127,"max":80},...}, latencies in us.
+ * Keeps state between calls so it must be called from single task only.
+ * @param buf Output buffer.
+ * @param size Size of output buffer.
+ * @return Length of output or 0 if it didn't fit.
+ */
+size_t Trace_formatWindowJSON(char *buf, size_t size);
+
+/**
+ * @brief Measures time between construction and destruction and records it as given trace point.
+ */
+class TraceScope
+{
+private:
+    TracePoint point;
+    int64_t start;
+
+public:
+    /**
+     * @brief Start measurement.
+     * @param point Trace point.
+     */
+    explicit TraceScope(TracePoint point) : point(point), start(esp_timer_get_time()) {}
+
+    /**
+     * @brief Record measurement.
+     */
+    ~TraceScope()
+    {
+        Trace_record(point, esp_timer_get_time() - start);
+    }
+};
@@ -1,6 +1,23 @@
 #pragma once
+#include <cstdint>
 #include "driver/gpio.h"
 
+/**
+ * @brief Connection statistics.
+ */
+struct WiFi_Stats
+{
+    uint32_t connects;            //!< Successful connections (got IP).
+    uint32_t fastConnects;        //!< Connections using cached channel, BSSID and IP.
+    uint32_t fastConnectFailures; //!< Fast connects that fell back to full connect.
+    uint32_t disconnects;         //!< Connections lost.
+    uint32_t fullAttempts;        //!< Full connect attempts (scan and DHCP).
+    uint32_t bootToConnectUs;     //!< From application start to first connection, 0 if not connected yet.
+    uint32_t lastConnectUs;       //!< From connect request or disconnect to got IP of last connection.
+    uint32_t maxConnectUs;        //!< Longest connect time.
+    int8_t rssi;                  //!< Signal strength of current AP in dBm, 0 if not connected.
+};
+
 /**
  * @brief Init WiFi.
  * 
@@ -12,4 +29,10 @@
  * @param smartConfigLED GPIO for smart config led.
  * @param WiFiLed GPIO for WiFi led.
  */
-void WiFi_init(gpio_num_t smartConfigBtnPin, gpio_num_t smartConfigLED, gpio_num_t WiFiLed);
\ No newline at end of file
+void WiFi_init(gpio_num_t smartConfigBtnPin, gpio_num_t smartConfigLED, gpio_num_t WiFiLed);
+
+/**
+ * @brief Get connection statistics.
+ * @return Statistics.
+ */
+WiFi_Stats WiFi_getStats();
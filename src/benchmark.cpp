@@ -0,0 +1,121 @@
+#include "../include/benchmark.hpp"
+#include "../include/bmp180_compensation.hpp"
+#include "../include/dht11_frame.hpp"
+#include "../include/mqtt_format.hpp"
+#include <stdio.h>
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "xtensa/hal.h"
+
+static const char *TAG_BENCH = "BENCH";
+
+static const uint32_t iterations = 10000;
+
+// Example calibration and readings from BMP180 datasheet (T = 15.0 °C, p = 69964 Pa).
+static const BMP180Calibration datasheetCalibration = {408, -72, -14383, 32741, 32757, 23153, 6190, 4, -32768, -8711, 2868};
+static const int32_t datasheetUT = 27898;
+static const int32_t datasheetUP = 23843 << 8;
+
+static volatile int32_t sink; //!< Keeps results alive so benchmarked code is not optimized out.
+
+/**
+ * @brief Single benchmark case.
+ */
+struct Benchmark
+{
+    const char *name;                //!< Name printed in report.
+    void (*fn)(uint32_t iterations); //!< Runs benchmarked code given number of times.
+};
+
+// Benchmarked code.
+static void benchTemperatureCompensation(uint32_t n);
+static void benchPressureCompensation(uint32_t n);
+static void benchDHT11Decode(uint32_t n);
+static void benchFloatFormatting(uint32_t n);
+static void benchFixedPayload(uint32_t n);
+static void benchTopicConstruction(uint32_t n);
+
+static const Benchmark benchmarks[] = {
+    {"BMP180 temperature compensation", benchTemperatureCompensation},
+    {"BMP180 pressure compensation", benchPressureCompensation},
+    {"DHT11 frame decode", benchDHT11Decode},
+    {"snprintf %f payload", benchFloatFormatting},
+    {"Fixed point payload", benchFixedPayload},
+    {"Topic construction", benchTopicConstruction}};
+
+// Function definitions.
+void Benchmark_run()
+{
+    ESP_LOGI(TAG_BENCH, "Running %u benchmarks, %u iterations each",
+             (unsigned)(sizeof(benchmarks) / sizeof(benchmarks[0])), (unsigned)iterations);
+
+    for (const Benchmark &b : benchmarks)
+    {
+        b.fn(iterations / 10); // Warm up cache.
+
+        uint32_t startCycles = xthal_get_ccount();
+        int64_t startTime = esp_timer_get_time();
+        b.fn(iterations);
+        int64_t time = esp_timer_get_time() - startTime;
+        uint32_t cycles = xthal_get_ccount() - startCycles;
+
+        ESP_LOGI(TAG_BENCH, "%-32s %8lu ns/call %8u cycles/call", b.name,
+                 (unsigned long)(time * 1000 / iterations), (unsigned)(cycles / iterations));
+    }
+}
+
+static void benchTemperatureCompensation(uint32_t n)
+{
+    int32_t B5;
+    for (uint32_t i = 0; i < n; i++)
+        sink = BMP180_compensateTemperature(datasheetCalibration, datasheetUT + (i & 1), B5);
+}
+
+static void benchPressureCompensation(uint32_t n)
+{
+    int32_t B5;
+    BMP180_compensateTemperature(datasheetCalibration, datasheetUT, B5);
+    for (uint32_t i = 0; i < n; i++)
+        sink = BMP180_compensatePressure(datasheetCalibration, datasheetUP + (i & 1), 0, B5);
+}
+
+static void benchDHT11Decode(uint32_t n)
+{
+    // 45 %, 22 °C, valid checksum.
+    const uint64_t frame = ((uint64_t)45 << 32) | ((uint64_t)22 << 16) | (45 + 22);
+
+    uint8_t humidity = 0, temperature = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        DHT11_decodeFrame(frame ^ (i & 1), humidity, temperature);
+        sink = humidity;
+    }
+}
+
+static void benchFloatFormatting(uint32_t n)
+{
+    char buf[128];
+    for (uint32_t i = 0; i < n; i++)
+        sink = snprintf(buf, sizeof(buf), "%f", 1013.25f + i);
+}
+
+static void benchFixedPayload(uint32_t n)
+{
+    // Same steps as formatPayload() of MQTT for fixed point sample.
+    char value[16];
+    char buf[68];
+    for (uint32_t i = 0; i < n; i++)
+    {
+        MQTT_formatFixed(value, sizeof(value), 101325 + (i & 1), 2);
+        MQTT_formatPayload(buf, sizeof(buf), value, 1700000000123000, "bmp180", i, i);
+        sink = buf[i & 15];
+    }
+}
+
+static void benchTopicConstruction(uint32_t n)
+{
+    // Same helper as MQTT_publish_impl.
+    char buf[64];
+    for (uint32_t i = 0; i < n; i++)
+        sink = MQTT_formatTopic(buf, sizeof(buf), "weather/station1", (i & 1) ? "pressure" : "humidity");
+}
@@ -1,29 +1,24 @@
 #include "../include/bmp180.hpp"
 #include "../include/i2c.hpp"
+#include "../include/config.hpp"
+#include "../include/trace.hpp"
+#include <cmath>
+#include "esp_log.h"
+#include "esp_attr.h"
 
 namespace
 {
-    const uint8_t BMP180_ADDR = 0b11101110;
+    const I2C_Device BMP180_DEVICE = {0b11101110, 400000}; //!< Fast mode, ESP32 doesn't support high speed mode.
 
     // Register addresses.
-    const uint8_t OUT_MSB = 0xF6;
-    const uint8_t AC1_MSB = 0xAA;
-    const uint8_t AC2_MSB = 0xAC;
-    const uint8_t AC3_MSB = 0xAE;
-    const uint8_t AC4_MSB = 0xB0;
-    const uint8_t AC5_MSB = 0xB2;
-    const uint8_t AC6_MSB = 0xB4;
-    const uint8_t B1_MSB = 0xB6;
-    const uint8_t B2_MSB = 0xB8;
-    const uint8_t MB_MSB = 0xBA;
-    const uint8_t MC_MSB = 0xBC;
-    const uint8_t MD_MSB = 0xBE;
+    const uint8_t OUT_MSB = 0xF6; //!< Followed by OUT_LSB and OUT_XLSB.
+    const uint8_t AC1_MSB = 0xAA; //!< First of 11 big endian calibration words (AC1 - MD).
     const uint8_t CTRL_MEAS = 0xF4;
     const uint8_t SOFT_RESET = 0xE0;
     const uint8_t ID = 0xD0;
 
     // Some register values.
-    const uint8_t CTRL_MEAS_TEMPERATURE_VAL = 0x2E;                //!< Set in CTRL_MEAS to measure temperature.
+    const uint8_t CTRL_MEAS_TEMPERATURE_VAL = 0x2E;                //!< Set in CTRL_MEAS to measure temperature (4.5ms conversion duration).
     const uint8_t CTRL_MEAS_ULTRA_LOW_POWER_MODE_VAL = 0x34;       //!< Set in CTRL_MEAS to measure in ultra low power mode (1 sample, 4.5ms conversion duration)
     const uint8_t CTRL_MEAS_STANDARD_MODE_VAL = 0x74;              //!< Set in CTRL_MEAS to measure in standard mode (2 samples, 7.5ms conversion duration)
     const uint8_t CTRL_MEAS_HIGH_RESOLUTION_MODE_VAL = 0xB4;       //!< Set in CTRL_MEAS to measure in high resolution mode (4 samples, 13.5ms conversion duration)
@@ -32,115 +27,272 @@ namespace
     const uint8_t ID_VAL = 0x55;                                   //!< Constant chip ID value in ID register.
 
     // Other values.
-    const double PRESSURE_STEP = 0.01;   //!< Value to multiply with result of measurement to get pressure in hPa.
-    const double TEMPERATURE_STEP = 0.1; //!< Value to multiply with result of measurement to get temperature in °C.
-}
+    const int32_t PA_PER_HPA = 100;
+    const float DECI = 10.0f;
 
-BMP180::BMP180()
-    : AC1(I2C_readRegister(BMP180_ADDR, AC1_MSB)),
-      AC2(I2C_readRegister(BMP180_ADDR, AC2_MSB)),
-      AC3(I2C_readRegister(BMP180_ADDR, AC3_MSB)),
-      AC4(I2C_readRegister(BMP180_ADDR, AC4_MSB)),
-      AC5(I2C_readRegister(BMP180_ADDR, AC5_MSB)),
-      AC6(I2C_readRegister(BMP180_ADDR, AC6_MSB)),
-      B1(I2C_readRegister(BMP180_ADDR, B1_MSB)),
-      B2(I2C_readRegister(BMP180_ADDR, B2_MSB)),
-      MB(I2C_readRegister(BMP180_ADDR, MB_MSB)),
-      MC(I2C_readRegister(BMP180_ADDR, MC_MSB)),
-      MD(I2C_readRegister(BMP180_ADDR, MD_MSB))
-{
-}
+#ifdef BMP180_STATIC_CALIBRATION
+    typedef BMP180StaticCompensation<BMP180_STATIC_CALIBRATION> StaticCompensation;
+#else
+    // Survive deep sleep so sensor doesn't have to be read again after wake up.
+    RTC_DATA_ATTR BMP180Calibration rtcCalibration;
+    RTC_DATA_ATTR bool rtcCalibrationValid = false;
+#endif
 
-float BMP180::trueTemperature(int32_t reading)
-{
-    int32_t X1 = (reading - AC6) * AC5 / 32768;
-    int32_t X2 = MC * 2048 / (X1 + MD);
-    B5 = X1 + X2;
-    int32_t T = (B5 + 8) / 16;
+    const char *TAG_BMP180 = "BMP180";
 
-    return T * TEMPERATURE_STEP;
+    // Max conversion durations from datasheet in microseconds.
+    const uint32_t TEMPERATURE_CONVERSION_US = 4500;
+    const uint32_t ULTRA_LOW_POWER_CONVERSION_US = 4500;
+    const uint32_t STANDARD_CONVERSION_US = 7500;
+    const uint32_t HIGH_RESOLUTION_CONVERSION_US = 13500;
+    const uint32_t ULTRA_HIGH_RESOLUTION_CONVERSION_US = 25500;
+
+    const size_t CALIBRATION_SIZE = 22;  //!< Bytes of calibration block 0xAA - 0xBF.
+    const size_t TEMPERATURE_SIZE = 2;   //!< Bytes of raw temperature (MSB, LSB).
+    const size_t PRESSURE_SIZE = 3;      //!< Bytes of raw pressure (MSB, LSB, XLSB).
+
+    const TickType_t WAIT_TIMEOUT = pdMS_TO_TICKS(100); //!< Upper bound for single sleep in wait() in case notification is lost.
+
+    /**
+     * @brief Get big endian word from buffer.
+     * @param buf Buffer.
+     * @param i Index of MSB.
+     * @return Word.
+     */
+    inline uint16_t word(const uint8_t *buf, size_t i)
+    {
+        return ((uint16_t)buf[i] << 8) | buf[i + 1];
+    }
 }
 
-float BMP180::truePressure(int32_t reading, uint8_t oss)
+BMP180::BMP180()
 {
-    reading = ((reading << 8) >> (8 - oss));
-
-    int32_t B6 = B5 - 4000;
-    int32_t X1 = (B2 * (B6 * B6 / 4096)) / 2048;
-    int32_t X2 = AC2 * B6 / 2048;
-    int32_t X3 = X1 + X2;
-    int32_t B3 = (((AC1 * 4 + X3) << oss) + 2) / 4;
-    X1 = AC3 * B6 / 8192;
-    X2 = (B1 * (B6 * B6 / 4096)) / 65536;
-    X3 = ((X1 + X2) + 2) / 4;
-    uint32_t B4 = AC4 * (uint32_t)(X3 + 32768) / 32768;
-    uint32_t B7 = ((uint32_t)reading - B3) * (50000 >> oss);
-
-    int32_t p;
-    if (B7 < 0x80000000)
+    const esp_timer_create_args_t timerArgs = {
+        .callback = conversionDone,
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "bmp180"};
+    ESP_ERROR_CHECK(esp_timer_create(&timerArgs, &conversionTimer));
+
+#ifdef BMP180_STATIC_CALIBRATION
+    cal = StaticCompensation::calibration();
+    calibrated = true;
+#else
+    if (rtcCalibrationValid)
     {
-        p = (B7 * 2) / B4;
+        cal = rtcCalibration;
+        calibrated = true;
     }
     else
     {
-        p = (B7 / B4) * 2;
+        loadCalibration();
+    }
+#endif
+}
+
+bool BMP180::loadCalibration()
+{
+    uint8_t buf[CALIBRATION_SIZE];
+
+    // Whole calibration block in one transfer.
+    esp_err_t err = I2C_read(BMP180_DEVICE, AC1_MSB, buf, sizeof(buf));
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_BMP180, "Failed to read calibration: %s", esp_err_to_name(err));
+        return false;
     }
 
-    X1 = (p / 256) * (p / 256);
-    X1 = (X1 * 3038) / 65536;
-    X2 = (-7357 * p) / 65536;
-    p = p + (X1 + X2 + 3791) / 16;
+    cal = BMP180_parseCalibration(buf);
+    calibrated = true;
 
-    return p * PRESSURE_STEP;
+#ifndef BMP180_STATIC_CALIBRATION
+    rtcCalibration = cal;
+    rtcCalibrationValid = true;
+#endif
+
+    // In format of BMP180_STATIC_CALIBRATION.
+    ESP_LOGI(TAG_BMP180, "Calibration: %d, %d, %d, %u, %u, %u, %d, %d, %d, %d, %d",
+             cal.AC1, cal.AC2, cal.AC3, cal.AC4, cal.AC5, cal.AC6, cal.B1, cal.B2, cal.MB, cal.MC, cal.MD);
+
+    return true;
 }
 
-float BMP180::read(MeasurementType type)
+int32_t BMP180::trueTemperature(int32_t reading)
+{
+#ifdef BMP180_STATIC_CALIBRATION
+    return StaticCompensation::temperature(reading, B5);
+#else
+    return BMP180_compensateTemperature(cal, reading, B5);
+#endif
+}
+
+int32_t BMP180::truePressure(int32_t reading, uint8_t oss)
+{
+#ifdef BMP180_STATIC_CALIBRATION
+    return StaticCompensation::pressure(reading, oss, B5);
+#else
+    return BMP180_compensatePressure(cal, reading, oss, B5);
+#endif
+}
+
+bool BMP180::startConversion(MeasurementType type)
 {
     uint8_t measurementTypeValue = 0;
-    uint8_t oss = 0;
-    uint8_t delayTime = 0;
+    uint32_t conversionTime = 0;
 
     switch (type)
     {
     case MeasurementType::LOW_POWER:
         measurementTypeValue = CTRL_MEAS_ULTRA_LOW_POWER_MODE_VAL;
         oss = 0;
-        delayTime = 10;
+        conversionTime = ULTRA_LOW_POWER_CONVERSION_US;
         break;
     case MeasurementType::STANDARD:
         measurementTypeValue = CTRL_MEAS_STANDARD_MODE_VAL;
         oss = 0b01;
-        delayTime = 20;
+        conversionTime = STANDARD_CONVERSION_US;
         break;
     case MeasurementType::HIGH_RES:
         measurementTypeValue = CTRL_MEAS_HIGH_RESOLUTION_MODE_VAL;
         oss = 0b10;
-        delayTime = 20;
+        conversionTime = HIGH_RESOLUTION_CONVERSION_US;
         break;
     case MeasurementType::ULTRA_HIGH_RES:
         measurementTypeValue = CTRL_MEAS_ULTRA_HIGH_RESOLUTION_MODE_VAL;
         oss = 0b11;
-        delayTime = 30;
+        conversionTime = ULTRA_HIGH_RESOLUTION_CONVERSION_US;
         break;
     case MeasurementType::TEMPERATURE:
         measurementTypeValue = CTRL_MEAS_TEMPERATURE_VAL;
-        delayTime = 10;
+        conversionTime = TEMPERATURE_CONVERSION_US;
         break;
     }
 
-    // For pressure readings get temperature first to
-    // update B5 parameter
-    if (type != MeasurementType::TEMPERATURE)
-        read(MeasurementType::TEMPERATURE);
+    esp_err_t err = I2C_writeByte(BMP180_DEVICE, CTRL_MEAS, measurementTypeValue);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_BMP180, "Failed to start conversion: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    readyAt = esp_timer_get_time() + conversionTime;
+    esp_timer_stop(conversionTimer); // Might not be running, that's fine.
+    esp_timer_start_once(conversionTimer, conversionTime);
+
+    return true;
+}
+
+void BMP180::conversionDone(void *arg)
+{
+    BMP180 *sensor = (BMP180 *)arg;
+    if (sensor->waitingTask)
+        xTaskNotifyGive(sensor->waitingTask);
+}
+
+bool BMP180::start(MeasurementType type)
+{
+    if (step != Step::IDLE)
+        return false;
+
+    // Retry if sensor was not responding at construction.
+    if (!calibrated && !loadCalibration())
+        return false;
+
+    cycleType = type;
+    cycleStart = esp_timer_get_time();
+    waitingTask = xTaskGetCurrentTaskHandle();
+
+    // Pressure compensation needs B5 from temperature
+    // so every cycle begins with temperature conversion.
+    if (!startConversion(MeasurementType::TEMPERATURE))
+        return false;
+    step = Step::TEMPERATURE;
+
+    return true;
+}
+
+BMP180::Status BMP180::poll()
+{
+    if (step == Step::IDLE)
+        return Status::READY;
+
+    if (esp_timer_get_time() < readyAt)
+        return Status::BUSY;
+
+    uint8_t buf[PRESSURE_SIZE];
+    size_t size = step == Step::TEMPERATURE ? TEMPERATURE_SIZE : PRESSURE_SIZE;
+    esp_err_t err = I2C_read(BMP180_DEVICE, OUT_MSB, buf, size);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_BMP180, "Failed to read result: %s", esp_err_to_name(err));
+        step = Step::IDLE;
+        return Status::ERROR;
+    }
+
+    if (step == Step::TEMPERATURE)
+    {
+        temperature = trueTemperature(word(buf, 0));
+
+        if (cycleType == MeasurementType::TEMPERATURE)
+        {
+            step = Step::IDLE;
+            Trace_record(TracePoint::BMP180_READ, esp_timer_get_time() - cycleStart);
+            return Status::READY;
+        }
+
+        // Reuse B5 from this cycle for pressure.
+        if (!startConversion(cycleType))
+        {
+            step = Step::IDLE;
+            return Status::ERROR;
+        }
+        step = Step::PRESSURE;
+        return Status::BUSY;
+    }
+
+    pressure = truePressure(((int32_t)word(buf, 0) << 8) | buf[2], oss);
+    step = Step::IDLE;
+    Trace_record(TracePoint::BMP180_READ, esp_timer_get_time() - cycleStart);
+    return Status::READY;
+}
+
+BMP180::Status BMP180::wait()
+{
+    Status status;
+    while ((status = poll()) == Status::BUSY)
+        ulTaskNotifyTake(pdTRUE, WAIT_TIMEOUT);
+
+    return status;
+}
+
+int32_t BMP180::getTemperatureDeci() const
+{
+    return temperature;
+}
+
+int32_t BMP180::getPressurePa() const
+{
+    return pressure;
+}
 
-    I2C_writeByte(BMP180_ADDR, CTRL_MEAS, measurementTypeValue);
+float BMP180::getTemperature() const
+{
+    return temperature / DECI;
+}
 
-    vTaskDelay(delayTime / portTICK_PERIOD_MS);
+float BMP180::getPressure() const
+{
+    return (float)pressure / PA_PER_HPA;
+}
 
-    uint16_t res = I2C_readRegister(BMP180_ADDR, OUT_MSB);
+float BMP180::read(MeasurementType type)
+{
+    wait(); // Finish any cycle started elsewhere.
+    if (!start(type) || wait() != Status::READY)
+        return NAN; // Values of last finished cycle are stale.
 
     if (type == MeasurementType::TEMPERATURE)
-        return trueTemperature(res);
+        return getTemperature();
 
-    return truePressure(res, oss);
-}
\ No newline at end of file
+    return getPressure();
+}
@@ -1,110 +1,128 @@
 #include "../include/dht11.hpp"
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
-#include "esp_timer.h"
+#include "../include/dht11_frame.hpp"
+#include "../include/trace.hpp"
+#include "freertos/ringbuf.h"
 
 #include "esp_log.h"
 
-inline void IRAM_ATTR DHT11::waitMicros(uint64_t us)
-{
-    uint64_t start = esp_timer_get_time();
-    while (esp_timer_get_time() - start < us)
-    {
-        asm volatile("nop");
-    }
-}
+static const char *TAG_DHT11 = "DHT11";
 
-inline void IRAM_ATTR DHT11::setInput()
-{
-    gpio_set_direction(gpio, GPIO_MODE_INPUT);
-}
-
-inline bool IRAM_ATTR DHT11::waitForState(bool state, uint64_t tout)
-{
-    uint64_t start = esp_timer_get_time();
-    while (gpio_get_level(gpio) != state)
-    {
-        if (esp_timer_get_time() - start > tout)
-        {
-            setOutputAndPullHigh();
-            return false;
-        }
-    }
-    return true;
-}
+static const uint32_t startSignalUs = 20000;                  //!< Host pulls DATA LOW for at least 18ms.
+static const TickType_t responseTimeout = pdMS_TO_TICKS(100); //!< Start signal + whole frame take ~25ms.
+static const uint8_t rmtClockDiv = 80;                        //!< 1us resolution from 80MHz APB clock.
+static const uint8_t rmtFilterTicks = 100;                    //!< Ignore glitches shorter than 1.25us (in APB ticks).
+static const uint16_t rmtIdleThresholdUs = 200;               //!< DATA HIGH for longer than this ends the frame.
+static const size_t rxBufferSize = 1000;
+static const size_t maxPulses = 48;                           //!< Response, 40 bits and some slack.
 
-inline void IRAM_ATTR DHT11::setOutputAndPullHigh()
+void DHT11::init(gpio_num_t dataPin, rmt_channel_t rmtChannel)
 {
-    gpio_set_direction(gpio, GPIO_MODE_OUTPUT);
-    gpio_set_level(gpio, 1);
-}
+    gpio = dataPin;
+    channel = rmtChannel;
 
-void DHT11::init(gpio_num_t dataPin)
-{
+    // Open drain so the host can pull DATA LOW while RMT listens to the same pin.
     gpio_config_t conf;
     conf.intr_type = GPIO_INTR_DISABLE;
-    conf.mode = GPIO_MODE_OUTPUT;
+    conf.mode = GPIO_MODE_INPUT_OUTPUT_OD;
     conf.pin_bit_mask = ((uint64_t)1 << dataPin);
-    conf.pull_up_en = GPIO_PULLUP_DISABLE;
-    gpio = dataPin;
+    conf.pull_up_en = GPIO_PULLUP_ENABLE;
+    conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
     gpio_config(&conf);
-    setOutputAndPullHigh();
+    gpio_set_level(gpio, 1);
+
+    rmt_config_t rmtConf = RMT_DEFAULT_CONFIG_RX(dataPin, rmtChannel);
+    rmtConf.clk_div = rmtClockDiv;
+    rmtConf.rx_config.filter_en = true;
+    rmtConf.rx_config.filter_ticks_thresh = rmtFilterTicks;
+    rmtConf.rx_config.idle_threshold = rmtIdleThresholdUs;
+    ESP_ERROR_CHECK(rmt_config(&rmtConf));
+    ESP_ERROR_CHECK(rmt_driver_install(channel, rxBufferSize, 0));
+    ESP_ERROR_CHECK(rmt_get_ringbuf_handle(channel, &rxBuffer));
+
+    // rmt_config() switched the pin to input only.
+    gpio_set_direction(gpio, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_set_level(gpio, 1);
+
+    const esp_timer_create_args_t timerArgs = {
+        .callback = endStartSignal,
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "dht11"};
+    ESP_ERROR_CHECK(esp_timer_create(&timerArgs, &startTimer));
+}
+
+void DHT11::endStartSignal(void *arg)
+{
+    DHT11 *sensor = (DHT11 *)arg;
+
+    // Capture from the moment DATA is released.
+    rmt_rx_start(sensor->channel, true);
+    gpio_set_level(sensor->gpio, 1);
 }
 
 float DHT11::read()
 {
-    // Start signal.
-    gpio_set_level(gpio, 0);
-    waitMicros(200000);
+    TraceScope trace(TracePoint::DHT11_READ);
+    reads++;
 
-    // DHT11 starts sending stuff.
-    setInput();
+    // Drop frame that arrived after previous read timed out.
+    size_t itemsSize = 0;
+    void *stale;
+    while ((stale = xRingbufferReceive(rxBuffer, &itemsSize, 0)) != nullptr)
+        vRingbufferReturnItem(rxBuffer, stale);
 
-    // Wait for DHT11 response LOW - HIGH should last max 40us.
-    if (!waitForState(0, 50))
-        return -1;
+    // Start signal, timer releases the line.
+    gpio_set_level(gpio, 0);
+    esp_timer_start_once(startTimer, startSignalUs);
 
-    // Wait for DHT11 response HIGH - LOW should last max 80us.
-    if(!waitForState(1, 90))
-        return -1;
+    // Sleep until RMT delivers the frame.
+    rmt_item32_t *items = (rmt_item32_t *)xRingbufferReceive(rxBuffer, &itemsSize, responseTimeout);
+    rmt_rx_stop(channel);
 
-    // Wait for DHT11 response LOW - HIGH should last max 80us.
-    if(!waitForState(0, 90))
+    if (items == nullptr)
+    {
+        gpio_set_level(gpio, 1);
+        timeouts++;
         return -1;
+    }
 
-    // Standard data transmission - 40 bits.
-    uint64_t data = 0;
-    for (int i = 39; i >= 0; i--)
+    // Collect widths of HIGH pulses, each item holds two consecutive pulses.
+    // Trailing idle HIGH is either zero length end marker or at least idle threshold long.
+    uint16_t highWidths[maxPulses];
+    size_t count = 0;
+    size_t itemCount = itemsSize / sizeof(rmt_item32_t);
+    for (size_t i = 0; i < itemCount && count < maxPulses; i++)
     {
-        // Wait for next HIGH state - LOW should last max 50us.
-        if(!waitForState(1, 60))
-            return -1;
-
-        uint64_t start = esp_timer_get_time(); // Measure time of high state.
-
-        // Wait for next LOW state - HIGH should last max 70us.
-        if(!waitForState(0, 90))
-            return -1;
-
-        // Measure time of HIGH state.
-        if (esp_timer_get_time() - start > 38)    // Less than 30 means "0", bigger than that means "1".
-            data |= ((uint64_t)1 << i); // Add bit to storage.
+        if (items[i].level0 == 1 && items[i].duration0 && items[i].duration0 < rmtIdleThresholdUs)
+            highWidths[count++] = items[i].duration0;
+        if (items[i].level1 == 1 && items[i].duration1 && items[i].duration1 < rmtIdleThresholdUs && count < maxPulses)
+            highWidths[count++] = items[i].duration1;
     }
+    vRingbufferReturnItem(rxBuffer, items);
 
-    // Finish transmission.
-    setOutputAndPullHigh();
-
-    // Get the results.
-    uint8_t checksum = data;
-    uint8_t tempDecimal = (data >> 8); // 0 for DHT11.
-    uint8_t tempIntegral = (data >> 16);
-    uint8_t humDecimal = (data >> 24); // 0 for DHT11.
-    uint8_t humIntegral = (data >> 32);
+    uint64_t data;
+    if (!DHT11_decodePulses(highWidths, count, data))
+    {
+        timeouts++;
+        return -1;
+    }
 
-    // Check if data is valid.
-    uint8_t requiredChecksum = (uint64_t)(tempDecimal + tempIntegral + humDecimal + humIntegral); // Last 8 bits of sum.
-    if (checksum != requiredChecksum)
+    uint8_t humidity, temperature;
+    if (!DHT11_decodeFrame(data, humidity, temperature))
+    {
+        checksumErrors++;
+        ESP_LOGD(TAG_DHT11, "Checksum mismatch");
         return -1;
+    }
+
+    return humidity;
+}
 
-    return humIntegral;
-}
\ No newline at end of file
+DHT11::Stats DHT11::getStats() const
+{
+    Stats stats;
+    stats.reads = reads;
+    stats.timeouts = timeouts;
+    stats.checksumErrors = checksumErrors;
+    return stats;
+}
@@ -1,9 +1,17 @@
 #include "../include/http.hpp"
 #include "../include/websites.hpp"
 #include "../include/mqtt.hpp"
+#include "../include/trace.hpp"
+#include "../include/form_parser.hpp"
+#include "../include/live.hpp"
+#include "../include/wifi.hpp"
+#include "../include/scheduler.hpp"
+#include "../include/i2c.hpp"
+#include <stdarg.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_http_server.h"
+#include "esp_system.h"
 #include "esp_log.h"
 
 static const char *TAG_HTTP = "HTTP";
@@ -11,9 +19,38 @@ static httpd_handle_t webServer;
 static TaskHandle_t connectionHandlingTask;
 static gpio_num_t _btn;
 static gpio_num_t _led;
+static const DHT11 *_humiditySensor;
+
+static const size_t maxFormSize = 512;   //!< Longer POST bodies are rejected.
+static const size_t maxFormKeySize = 15; //!< Longest key is "brokerport".
+typedef FormParser<maxFormKeySize, sizeof(MQTT_Settings::password) - 1> ConfigFormParser;
+
+/**
+ * @brief MQTT config received in POST.
+ */
+struct ConfigForm
+{
+    MQTT_Settings settings; //!< Received values.
+    uint8_t received;       //!< Bit per field of settings, set if field was received.
+    bool tooLong;           //!< Some value doesn't fit its field.
+};
+
+/**
+ * @brief Response body collected in small buffer and sent in chunks.
+ */
+struct ChunkWriter
+{
+    httpd_req_t *req;
+    char buf[256];
+    size_t len;
+    esp_err_t err; //!< First send error, nothing is sent after it.
+};
+
+// Tasks whose stack high water marks are exported, missing ones are skipped.
+static const char *const metricsTasks[] = {"MQTTPublisherTask", "scheduler", "HTTPConnectionTask", "httpd"};
 
 // External functions.
-void HTTP_init(gpio_num_t btn, gpio_num_t led);
+void HTTP_init(gpio_num_t btn, gpio_num_t led, const DHT11 *humiditySensor);
 
 /**
  * @brief Start HTTP server.
@@ -52,6 +89,69 @@ static void IRAM_ATTR GPIOISRHandler(void *arg);
  */
 static esp_err_t getHandler(httpd_req_t *req);
 
+/**
+ * @brief GET handler of current MQTT config as JSON.
+ * @param req User's request.
+ * @return ESP error.
+ */
+static esp_err_t configHandler(httpd_req_t *req);
+
+/**
+ * @brief Send JSON string as chunk of response, escaped.
+ * @param req User's request.
+ * @param str String.
+ * @return ESP error.
+ */
+static esp_err_t sendJSONString(httpd_req_t *req, const char *str);
+
+/**
+ * @brief GET handler of metrics in Prometheus text exposition format.
+ * @param req User's request.
+ * @return ESP error.
+ */
+static esp_err_t metricsHandler(httpd_req_t *req);
+
+/**
+ * @brief Append formatted text to response, sending buffer as chunk when it's full.
+ * @param w Writer.
+ * @param format Printf format, single output must fit the buffer.
+ */
+static void writef(ChunkWriter &w, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Send rest of buffer and end chunked response.
+ * @param w Writer.
+ * @return ESP error.
+ */
+static esp_err_t finishChunks(ChunkWriter &w);
+
+/**
+ * @brief Append HELP and TYPE lines of metric.
+ * @param w Writer.
+ * @param name Metric name.
+ * @param type "counter", "gauge" or "summary".
+ * @param help Description.
+ */
+static void writeMetricHeader(ChunkWriter &w, const char *name, const char *type, const char *help);
+
+/**
+ * @brief Append metric without labels.
+ * @param w Writer.
+ * @param name Metric name.
+ * @param type "counter" or "gauge".
+ * @param help Description.
+ * @param value Value.
+ */
+static void writeMetric(ChunkWriter &w, const char *name, const char *type, const char *help, int64_t value);
+
+/**
+ * @brief Store field of config form.
+ * @param key Key.
+ * @param value Value.
+ * @param ctx ConfigForm.
+ */
+static void onConfigField(const char *key, const char *value, void *ctx);
+
 /**
  * @brief POST handler.
  * @param req User's request.
@@ -60,9 +160,11 @@ static esp_err_t getHandler(httpd_req_t *req);
 static esp_err_t postHandler(httpd_req_t *req);
 
 // Function definitions.
-void HTTP_init(gpio_num_t btn, gpio_num_t led)
+void HTTP_init(gpio_num_t btn, gpio_num_t led, const DHT11 *humiditySensor)
 {
+    _humiditySensor = humiditySensor;
     initGPIO(btn, led);
+    MQTT_setSampleSink(Live_push);
 
     xTaskCreate(HTTPConnectionTask, "HTTPConnectionTask", 2048, NULL, 10, NULL);
 }
@@ -80,6 +182,18 @@ static void start()
         .handler = getHandler,
         .user_ctx = NULL};
 
+    httpd_uri_t configGet = {
+        .uri = mqttConfigURI,
+        .method = HTTP_GET,
+        .handler = configHandler,
+        .user_ctx = NULL};
+
+    httpd_uri_t metricsGet = {
+        .uri = metricsURI,
+        .method = HTTP_GET,
+        .handler = metricsHandler,
+        .user_ctx = NULL};
+
     httpd_uri_t configWebsitePost = {
         .uri = mqttURI,
         .method = HTTP_POST,
@@ -87,10 +201,14 @@ static void start()
         .user_ctx = NULL};
 
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.close_fn = Live_closeSocket;
     webServer = NULL;
     ESP_ERROR_CHECK(httpd_start(&webServer, &config));
     ESP_ERROR_CHECK(httpd_register_uri_handler(webServer, &configWebsiteGet));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(webServer, &configGet));
+    ESP_ERROR_CHECK(httpd_register_uri_handler(webServer, &metricsGet));
     ESP_ERROR_CHECK(httpd_register_uri_handler(webServer, &configWebsitePost));
+    Live_start(webServer);
     gpio_set_level(_led, 1);
 }
 
@@ -99,6 +217,7 @@ static void stop()
     if (webServer)
     {
         ESP_LOGI(TAG_HTTP, "Stopping webserver");
+        Live_stop();
         httpd_stop(webServer);
         webServer = NULL;
         gpio_set_level(_led, 0);
@@ -161,113 +280,312 @@ static void IRAM_ATTR GPIOISRHandler(void *arg)
 
 static esp_err_t getHandler(httpd_req_t *req)
 {
-    static char buf[2048];
+    TraceScope trace(TracePoint::HTTP_GET);
 
     if (strcmp(req->uri, mqttURI) == 0)
     {
         ESP_LOGI(TAG_HTTP, "Received GET on mqtt's uri");
 
-        MQTT_resourceTake();
-        const char *brokerIp = MQTT_getIP();
-        const char *brokerPort = MQTT_getPort();
-        const char *user = MQTT_getUser();
-        const char *passwd = MQTT_getPassword();
-        const char *ns = MQTT_getNamespace();
-        snprintf(buf, 4096, mqttWebsite, brokerIp, brokerPort, user, passwd, ns);
-        MQTT_resourceRelease();
-
-        ESP_ERROR_CHECK(httpd_resp_send(req, buf, HTTPD_RESP_USE_STRLEN));
+        // Static page, sent as is from flash.
+        httpd_resp_set_type(req, "text/html");
+        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+        httpd_resp_set_hdr(req, "Cache-Control", "max-age=3600");
+        return httpd_resp_send(req, (const char *)mqttPageGzStart, mqttPageGzEnd - mqttPageGzStart);
     }
 
     return ESP_OK;
 }
 
-static esp_err_t postHandler(httpd_req_t *req)
+static esp_err_t configHandler(httpd_req_t *req)
 {
-    static char content[256];
+    TraceScope trace(TracePoint::HTTP_GET);
 
-    memset(content, 0, sizeof(content));
+    MQTT_SettingsRef settings = MQTT_getSettings();
+    const char *keys[] = {"brokerip", "brokerport", "user", "password", "namespace", "batch"};
+    const char *values[] = {settings->ip, settings->port, settings->username,
+                            settings->password, settings->ns, settings->batchMode};
 
-    if (strcmp(req->uri, mqttURI) == 0)
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    // {"brokerip":"...",...} streamed in small chunks, no buffer for whole response.
+    esp_err_t err = ESP_OK;
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]) && err == ESP_OK; i++)
     {
-        ESP_LOGI(TAG_HTTP, "Received POST on mqtt's uri");
+        char prefix[16];
+        snprintf(prefix, sizeof(prefix), "%s\"%s\":", i ? "," : "{", keys[i]);
+        err = httpd_resp_sendstr_chunk(req, prefix);
+        if (err == ESP_OK)
+            err = sendJSONString(req, values[i]);
+    }
+    if (err == ESP_OK)
+        err = httpd_resp_sendstr_chunk(req, "}");
+    if (err == ESP_OK)
+        err = httpd_resp_send_chunk(req, NULL, 0);
 
-        // Truncate recv size.
-        size_t recv_size = req->content_len;
-        if (recv_size < sizeof(content))
-            recv_size = sizeof(content);
+    return err;
+}
 
-        int ret = httpd_req_recv(req, content, recv_size);
+static esp_err_t sendJSONString(httpd_req_t *req, const char *str)
+{
+    // Worst case every character becomes \u00XX.
+    char buf[2 + 6 * sizeof(MQTT_Settings::username)];
+    size_t len = 0;
 
-        // Handle closed connection.
-        if (ret <= 0)
+    buf[len++] = '"';
+    for (; *str && len < sizeof(buf) - 7; str++)
+    {
+        unsigned char c = *str;
+        if (c == '"' || c == '\\')
         {
-            if (ret == HTTPD_SOCK_ERR_TIMEOUT)
-                ESP_ERROR_CHECK(httpd_resp_send_408(req));
-
-            return ESP_FAIL;
+            buf[len++] = '\\';
+            buf[len++] = c;
+        }
+        else if (c < 0x20)
+        {
+            len += snprintf(buf + len, sizeof(buf) - len, "\\u%04x", c);
         }
+        else
+        {
+            buf[len++] = c;
+        }
+    }
+    buf[len++] = '"';
+
+    return httpd_resp_send_chunk(req, buf, len);
+}
+
+static esp_err_t metricsHandler(httpd_req_t *req)
+{
+    TraceScope trace(TracePoint::HTTP_GET);
+
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    ChunkWriter w;
+    w.req = req;
+    w.len = 0;
+    w.err = ESP_OK;
+
+    // Every value is read from atomic counter, no lock is taken.
+    MQTT_QueueStats queue = MQTT_getQueueStats();
+    MQTT_ConnectionStats mqtt = MQTT_getConnectionStats();
+    writeMetric(w, "mqtt_published_total", "counter", "Samples handed to MQTT client.", queue.published);
+    writeMetric(w, "mqtt_suppressed_total", "counter", "Samples within deadband of their topic, not published.", queue.suppressed);
+    writeMetric(w, "mqtt_publish_failures_total", "counter", "Messages MQTT client refused to publish.", mqtt.publishFailures);
+    writeMetricHeader(w, "mqtt_dropped_total", "counter", "Samples lost.");
+    writef(w, "mqtt_dropped_total{reason=\"queue_full\"} %u\n", queue.droppedFull);
+    writef(w, "mqtt_dropped_total{reason=\"no_queue\"} %u\n", queue.droppedNoQueue);
+    writef(w, "mqtt_dropped_total{reason=\"offline\"} %u\n", queue.droppedOffline);
+    writef(w, "mqtt_dropped_total{reason=\"unacknowledged\"} %u\n", queue.unacknowledged);
+    writeMetric(w, "mqtt_stored_total", "counter", "Samples stored in flash while broker was not connected.", queue.stored);
+    writeMetric(w, "mqtt_replayed_total", "counter", "Stored samples published after reconnect.", queue.replayed);
+    writeMetric(w, "mqtt_stored_pending", "gauge", "Stored samples waiting for replay.", queue.storedPending);
+    writeMetric(w, "mqtt_queue_depth", "gauge", "Samples waiting for publisher task.", queue.depth);
+    writeMetric(w, "mqtt_connected", "gauge", "Whether broker is connected.", mqtt.connected);
+    writeMetric(w, "mqtt_connects_total", "counter", "Connections to broker.", mqtt.connects);
+    writeMetric(w, "mqtt_disconnects_total", "counter", "Connections to broker lost.", mqtt.disconnects);
+
+    WiFi_Stats wifi = WiFi_getStats();
+    writeMetric(w, "wifi_rssi_dbm", "gauge", "Signal strength of current AP, 0 if not connected.", wifi.rssi);
+    writeMetric(w, "wifi_connects_total", "counter", "Connections to AP.", wifi.connects);
+    writeMetric(w, "wifi_disconnects_total", "counter", "Connections to AP lost.", wifi.disconnects);
+    writeMetric(w, "wifi_fast_connect_failures_total", "counter", "Connects to cached AP that fell back to scan.", wifi.fastConnectFailures);
+
+    I2C_Stats i2c = I2C_getStats();
+    writeMetric(w, "i2c_transactions_total", "counter", "I2C transactions of all devices.", i2c.transactions);
+    writeMetric(w, "i2c_errors_total", "counter", "Failed I2C transactions.", i2c.errors);
+    writeMetric(w, "i2c_recoveries_total", "counter", "I2C bus recoveries after timeout.", i2c.recoveries);
+
+    if (_humiditySensor)
+    {
+        DHT11::Stats dht = _humiditySensor->getStats();
+        writeMetric(w, "dht11_reads_total", "counter", "DHT11 reads.", dht.reads);
+        writeMetric(w, "dht11_timeouts_total", "counter", "DHT11 reads without complete response.", dht.timeouts);
+        writeMetric(w, "dht11_checksum_errors_total", "counter", "DHT11 reads with bad checksum.", dht.checksumErrors);
+    }
+
+    // Percentiles are upper bounds of power of two buckets.
+    writeMetricHeader(w, "latency_us", "summary", "Latency of traced operations since boot.");
+    for (uint8_t i = 0; i < (uint8_t)TracePoint::COUNT; i++)
+    {
+        TracePoint point = (TracePoint)i;
+        Trace_Summary summary = Trace_getSummary(point);
+        writef(w, "latency_us{op=\"%s\",quantile=\"0.5\"} %u\n", Trace_name(point), summary.p50);
+        writef(w, "latency_us{op=\"%s\",quantile=\"0.99\"} %u\n", Trace_name(point), summary.p99);
+        writef(w, "latency_us_sum{op=\"%s\"} %u\n", Trace_name(point), summary.sum);
+        writef(w, "latency_us_count{op=\"%s\"} %u\n", Trace_name(point), summary.count);
+    }
 
-        // Get key value pairs of MQTT's config.
-        const int numKeyValuePairs = 5;
-        const char *keyValuePair[numKeyValuePairs];
+    Scheduler_JobStats job;
+    writeMetricHeader(w, "job_runs_total", "counter", "Runs of scheduled job.");
+    for (size_t i = 0; Scheduler_getStats(i, job); i++)
+        writef(w, "job_runs_total{job=\"%s\"} %u\n", job.name, job.runs);
+    writeMetricHeader(w, "job_deadline_misses_total", "counter", "Runs of scheduled job that ended after deadline.");
+    for (size_t i = 0; Scheduler_getStats(i, job); i++)
+        writef(w, "job_deadline_misses_total{job=\"%s\"} %u\n", job.name, job.deadlineMisses);
+    writeMetricHeader(w, "job_skipped_total", "counter", "Releases of scheduled job dropped after overrun.");
+    for (size_t i = 0; Scheduler_getStats(i, job); i++)
+        writef(w, "job_skipped_total{job=\"%s\"} %u\n", job.name, job.skipped);
+    writeMetricHeader(w, "job_max_jitter_us", "gauge", "Longest delay of job start after release.");
+    for (size_t i = 0; Scheduler_getStats(i, job); i++)
+        writef(w, "job_max_jitter_us{job=\"%s\"} %u\n", job.name, job.maxJitterUs);
+
+    Live_Stats live = Live_getStats();
+    writeMetric(w, "live_clients", "gauge", "Clients of /live.", live.clients);
+    writeMetric(w, "live_dropped_clients_total", "counter", "Clients of /live disconnected for being too slow.", live.droppedClients);
+
+    writeMetric(w, "heap_free_bytes", "gauge", "Free heap.", esp_get_free_heap_size());
+    writeMetric(w, "heap_min_free_bytes", "gauge", "Lowest free heap since boot.", esp_get_minimum_free_heap_size());
+
+    writeMetricHeader(w, "task_stack_free_min_bytes", "gauge", "Lowest free stack of task since it started.");
+    for (const char *name : metricsTasks)
+    {
+        TaskHandle_t task = xTaskGetHandle(name);
+        if (task)
+            writef(w, "task_stack_free_min_bytes{task=\"%s\"} %u\n", name, (unsigned)uxTaskGetStackHighWaterMark(task));
+    }
 
-        keyValuePair[0] = strtok(content, "&"); // First key value pair of MQTT's config.
+    return finishChunks(w);
+}
 
-        // Next key value pairs for every received param of MQTT's config.
-        bool finished = false;
-        int cntr = numKeyValuePairs - 1;
-        while (cntr && !finished)
+static void writef(ChunkWriter &w, const char *format, ...)
+{
+    if (w.err != ESP_OK)
+        return;
+
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        va_list args;
+        va_start(args, format);
+        int len = vsnprintf(w.buf + w.len, sizeof(w.buf) - w.len, format, args);
+        va_end(args);
+
+        if (len >= 0 && (size_t)len < sizeof(w.buf) - w.len)
         {
-            keyValuePair[numKeyValuePairs - cntr] = strtok(nullptr, "&");
-            if (keyValuePair[numKeyValuePairs - cntr] == NULL)
-                finished = true;
-            cntr--;
+            w.len += len;
+            return;
         }
 
-        // Get key and value of each pair.
-        // And save each valid key value pair to MQTT.
-        int keyValuePairsReceived = numKeyValuePairs - cntr;
-        for (int i = 0; i < keyValuePairsReceived; i++)
+        // Didn't fit, send what is buffered and retry in empty buffer.
+        if (w.len == 0)
+            return;
+        w.err = httpd_resp_send_chunk(w.req, w.buf, w.len);
+        w.len = 0;
+        if (w.err != ESP_OK)
+            return;
+    }
+}
+
+static esp_err_t finishChunks(ChunkWriter &w)
+{
+    if (w.err == ESP_OK && w.len)
+        w.err = httpd_resp_send_chunk(w.req, w.buf, w.len);
+    if (w.err == ESP_OK)
+        w.err = httpd_resp_send_chunk(w.req, NULL, 0);
+
+    return w.err;
+}
+
+static void writeMetricHeader(ChunkWriter &w, const char *name, const char *type, const char *help)
+{
+    writef(w, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void writeMetric(ChunkWriter &w, const char *name, const char *type, const char *help, int64_t value)
+{
+    writeMetricHeader(w, name, type, help);
+    writef(w, "%s %lld\n", name, (long long)value);
+}
+
+static esp_err_t postHandler(httpd_req_t *req)
+{
+    TraceScope trace(TracePoint::HTTP_POST);
+
+    if (strcmp(req->uri, mqttURI) != 0)
+        return ESP_OK;
+
+    ESP_LOGI(TAG_HTTP, "Received POST on mqtt's uri");
+
+    if (req->content_len > maxFormSize)
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Form too long");
+
+    ConfigForm form;
+    memset(&form, 0, sizeof(form));
+    ConfigFormParser parser(onConfigField, &form);
+
+    // Body may arrive in any number of pieces.
+    char buf[64];
+    size_t remaining = req->content_len;
+    while (remaining)
+    {
+        int ret = httpd_req_recv(req, buf, remaining < sizeof(buf) ? remaining : sizeof(buf));
+        if (ret <= 0)
         {
-            const char *key = strtok((char *)keyValuePair[i], "=");
-            const char *val = strtok(nullptr, "=");
-
-            if (strcmp(key, "brokerip") == 0 && val != NULL)
-            {
-                MQTT_updateIP(val);
-            }
-            else if (strcmp(key, "brokerport") == 0 && val != NULL)
-            {
-                MQTT_updatePort(val);
-            }
-            else if (strcmp(key, "user") == 0)
-            {
-                if (val == NULL)
-                    val = "";
-
-                MQTT_updateUser(val);
-            }
-            else if (strcmp(key, "password") == 0)
-            {
-                if (val == NULL)
-                    val = "";
-
-                MQTT_updatePassword(val);
-            }
-            else if (strcmp(key, "namespace") == 0)
-            {
-                if (val == NULL)
-                    val = "";
-
-                MQTT_updateNamespace(val);
-            }
+            if (ret == HTTPD_SOCK_ERR_TIMEOUT)
+                httpd_resp_send_408(req);
+
+            return ESP_FAIL;
         }
-        MQTT_reInit();
 
-        // Reply with same website but updated data.
-        getHandler(req);
+        if (parser.feed(buf, ret) != ConfigFormParser::Status::OK)
+            break;
+        remaining -= ret;
     }
 
-    return ESP_OK;
-}
\ No newline at end of file
+    ConfigFormParser::Status status = parser.finish();
+    if (status == ConfigFormParser::Status::BAD_ESCAPE)
+    {
+        ESP_LOGW(TAG_HTTP, "Rejected form: bad escape");
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Malformed form");
+    }
+    if (status == ConfigFormParser::Status::TOO_LONG || form.tooLong)
+    {
+        ESP_LOGW(TAG_HTTP, "Rejected form: field too long");
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Field too long");
+    }
+
+    // Apply only complete and valid form.
+    const MQTT_Settings &s = form.settings;
+    if ((form.received & (1 << 0)) && s.ip[0])
+        MQTT_updateIP(s.ip);
+    if ((form.received & (1 << 1)) && s.port[0])
+        MQTT_updatePort(s.port);
+    if (form.received & (1 << 2))
+        MQTT_updateUser(s.username);
+    if (form.received & (1 << 3))
+        MQTT_updatePassword(s.password);
+    if (form.received & (1 << 4))
+        MQTT_updateNamespace(s.ns);
+    if ((form.received & (1 << 5)) && s.batchMode[0])
+        MQTT_updateBatchMode(s.batchMode);
+    MQTT_reInit();
+
+    // Back to the page, it loads updated config by itself.
+    httpd_resp_set_status(req, "303 See Other");
+    httpd_resp_set_hdr(req, "Location", mqttURI);
+    return httpd_resp_send(req, NULL, 0);
+}
+
+static void onConfigField(const char *key, const char *value, void *ctx)
+{
+    ConfigForm *form = (ConfigForm *)ctx;
+    MQTT_Settings &s = form->settings;
+
+    // Same order as bits of ConfigForm::received.
+    const char *keys[] = {"brokerip", "brokerport", "user", "password", "namespace", "batch"};
+    char *fields[] = {s.ip, s.port, s.username, s.password, s.ns, s.batchMode};
+    const size_t sizes[] = {sizeof(s.ip), sizeof(s.port), sizeof(s.username),
+                            sizeof(s.password), sizeof(s.ns), sizeof(s.batchMode)};
+
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+    {
+        if (strcmp(key, keys[i]) == 0)
+        {
+            if (strlcpy(fields[i], value, sizes[i]) >= sizes[i])
+                form->tooLong = true;
+            form->received |= 1 << i;
+            return;
+        }
+    }
+}
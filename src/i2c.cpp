@@ -1,58 +1,241 @@
 #include "../include/i2c.hpp"
+#include <atomic>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_rom_sys.h"
+#include "esp_log.h"
+
+static const char *TAG_I2C = "I2C";
 
 static i2c_port_t _port;
+static i2c_config_t busConfig;    //!< Config of peripheral, clock follows addressed device.
+static uint32_t busMaxFreq;
+static SemaphoreHandle_t busLock; //!< Held for whole transaction, guards peripheral and command link storage.
+
+static const TickType_t transactionTimeout = 1000 / portTICK_PERIOD_MS;
+
+static const int recoveryPulses = 9;            //!< Clocks out rest of any byte and its ACK.
+static const uint32_t recoveryHalfPeriodUs = 5; //!< Recovery runs at 100 kHz, every slave supports that.
+
+// Storage for command links, big enough for write + repeated start read.
+static uint8_t cmdLinkBuffer[I2C_LINK_RECOMMENDED_SIZE(2)];
+
+static std::atomic<uint32_t> transactionCount{0};
+static std::atomic<uint32_t> errorCount{0};
+static std::atomic<uint32_t> recoveryCount{0};
+
+// External functions.
+void I2C_init(i2c_port_t port, gpio_num_t sda, gpio_num_t scl, uint32_t maxFreq);
+esp_err_t I2C_read(const I2C_Device &dev, uint8_t reg, uint8_t *data, size_t len);
+esp_err_t I2C_write(const I2C_Device &dev, uint8_t reg, const uint8_t *data, size_t len);
+esp_err_t I2C_writeByte(const I2C_Device &dev, uint8_t reg, uint8_t b);
+I2C_Stats I2C_getStats();
 
-void I2C_init(i2c_port_t port, gpio_num_t sda, gpio_num_t scl, uint32_t freq)
+// Helper functions.
+/**
+ * @brief Take bus lock and set clock of device.
+ * @param dev Slave of transaction.
+ * @return False if lock wasn't taken in time.
+ */
+static bool lockBus(const I2C_Device &dev);
+
+/**
+ * @brief Count result of transaction, recover bus after timeout and give bus lock.
+ * @param err Result of transaction.
+ * @return err.
+ */
+static esp_err_t unlockBus(esp_err_t err);
+
+/**
+ * @brief Set bus clock, peripheral is reconfigured only if clock changes.
+ * @param freq Clock.
+ */
+static void setClock(uint32_t freq);
+
+/**
+ * @brief Free SDA held low by slave by pulsing SCL and generate stop condition.
+ * Pins are driven as GPIOs meanwhile and given back to peripheral afterwards.
+ */
+static void recoverBus();
+
+// Function definitions.
+void I2C_init(i2c_port_t port, gpio_num_t sda, gpio_num_t scl, uint32_t maxFreq)
 {
     _port = port;
+    busMaxFreq = maxFreq;
+    busLock = xSemaphoreCreateMutex();
 
-    i2c_config_t conf = {
+    busConfig = {
         .mode = I2C_MODE_MASTER,
         .sda_io_num = sda,
         .scl_io_num = scl,
         .sda_pullup_en = GPIO_PULLUP_ENABLE,
         .scl_pullup_en = GPIO_PULLUP_ENABLE,
         .master = {
-            .clk_speed = freq}};
+            .clk_speed = maxFreq}};
 
-    i2c_param_config(_port, &conf);
+    // Slave may still be in middle of transaction interrupted by reset.
+    recoverBus();
     i2c_driver_install(_port, I2C_MODE_MASTER, 0, 0, 0);
 }
 
-void I2C_writeByte(uint8_t addr, uint8_t reg, uint8_t b)
+esp_err_t I2C_read(const I2C_Device &dev, uint8_t reg, uint8_t *data, size_t len)
+{
+    if (data == nullptr || len == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    if (!lockBus(dev))
+        return ESP_ERR_TIMEOUT;
+
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(cmdLinkBuffer, sizeof(cmdLinkBuffer));
+    if (cmd == NULL)
+        return unlockBus(ESP_ERR_NO_MEM);
+
+    esp_err_t err = i2c_master_start(cmd);
+    if (err == ESP_OK)
+        err = i2c_master_write_byte(cmd, dev.addr, true);
+    if (err == ESP_OK)
+        err = i2c_master_write_byte(cmd, reg, true);
+
+    if (err == ESP_OK)
+        err = i2c_master_start(cmd); // Repeated start.
+    if (err == ESP_OK)
+        err = i2c_master_write_byte(cmd, dev.addr | 1, true);
+    if (err == ESP_OK)
+        err = i2c_master_read(cmd, data, len, I2C_MASTER_LAST_NACK); // ACK every byte but last one.
+    if (err == ESP_OK)
+        err = i2c_master_stop(cmd);
+
+    if (err == ESP_OK)
+        err = i2c_master_cmd_begin(_port, cmd, transactionTimeout);
+    i2c_cmd_link_delete_static(cmd);
+
+    return unlockBus(err);
+}
+
+esp_err_t I2C_write(const I2C_Device &dev, uint8_t reg, const uint8_t *data, size_t len)
+{
+    if (data == nullptr || len == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    if (!lockBus(dev))
+        return ESP_ERR_TIMEOUT;
+
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(cmdLinkBuffer, sizeof(cmdLinkBuffer));
+    if (cmd == NULL)
+        return unlockBus(ESP_ERR_NO_MEM);
+
+    esp_err_t err = i2c_master_start(cmd);
+    if (err == ESP_OK)
+        err = i2c_master_write_byte(cmd, dev.addr, true);
+    if (err == ESP_OK)
+        err = i2c_master_write_byte(cmd, reg, true);
+    if (err == ESP_OK)
+        err = i2c_master_write(cmd, data, len, true);
+    if (err == ESP_OK)
+        err = i2c_master_stop(cmd);
+
+    if (err == ESP_OK)
+        err = i2c_master_cmd_begin(_port, cmd, transactionTimeout);
+    i2c_cmd_link_delete_static(cmd);
+
+    return unlockBus(err);
+}
+
+esp_err_t I2C_writeByte(const I2C_Device &dev, uint8_t reg, uint8_t b)
 {
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    ESP_ERROR_CHECK(i2c_master_start(cmd));
+    return I2C_write(dev, reg, &b, 1);
+}
 
-    ESP_ERROR_CHECK(i2c_master_write_byte(cmd, addr, true));
-    ESP_ERROR_CHECK(i2c_master_write_byte(cmd, reg, true));
-    ESP_ERROR_CHECK(i2c_master_write_byte(cmd, b, true));
-    ESP_ERROR_CHECK(i2c_master_stop(cmd));
+I2C_Stats I2C_getStats()
+{
+    I2C_Stats stats;
+    stats.transactions = transactionCount;
+    stats.errors = errorCount;
+    stats.recoveries = recoveryCount;
+    return stats;
+}
+
+static bool lockBus(const I2C_Device &dev)
+{
+    if (xSemaphoreTake(busLock, transactionTimeout) != pdTRUE)
+    {
+        errorCount++;
+        return false;
+    }
 
-    ESP_ERROR_CHECK(i2c_master_cmd_begin(_port, cmd, 1000 / portTICK_PERIOD_MS));
-    i2c_cmd_link_delete(cmd);
+    transactionCount++;
+    setClock(dev.maxFreq < busMaxFreq ? dev.maxFreq : busMaxFreq);
+    return true;
 }
 
-uint16_t I2C_readRegister(uint8_t addr, uint8_t reg)
+static esp_err_t unlockBus(esp_err_t err)
 {
-    uint8_t resMsb = 0;
-    uint8_t resLsb = 0;
+    if (err != ESP_OK)
+        errorCount++;
 
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    ESP_ERROR_CHECK(i2c_master_start(cmd));
-    ESP_ERROR_CHECK(i2c_master_write_byte(cmd, addr, true));
-    ESP_ERROR_CHECK(i2c_master_write_byte(cmd, reg, true));
+    // Timeout means bus was busy or slave stretched clock forever, NACK (ESP_FAIL) leaves bus free.
+    if (err == ESP_ERR_TIMEOUT)
+    {
+        recoveryCount++;
+        recoverBus();
+    }
 
-    ESP_ERROR_CHECK(i2c_master_start(cmd)); // Repeated start.
-    ESP_ERROR_CHECK(i2c_master_write_byte(cmd, addr | 1, true));
-    ESP_ERROR_CHECK(i2c_master_read_byte(cmd, &resMsb, I2C_MASTER_ACK));
-    ESP_ERROR_CHECK(i2c_master_read_byte(cmd, &resLsb, I2C_MASTER_LAST_NACK));
-    ESP_ERROR_CHECK(i2c_master_stop(cmd));
+    xSemaphoreGive(busLock);
+    return err;
+}
+
+static void setClock(uint32_t freq)
+{
+    if (freq == busConfig.master.clk_speed)
+        return;
+
+    busConfig.master.clk_speed = freq;
+    i2c_param_config(_port, &busConfig);
+}
 
-    ESP_ERROR_CHECK(i2c_master_cmd_begin(_port, cmd, 1000 / portTICK_PERIOD_MS));
-    i2c_cmd_link_delete(cmd);
+static void recoverBus()
+{
+    gpio_num_t sda = (gpio_num_t)busConfig.sda_io_num;
+    gpio_num_t scl = (gpio_num_t)busConfig.scl_io_num;
+
+    gpio_config_t conf = {
+        .pin_bit_mask = (1ULL << sda) | (1ULL << scl),
+        .mode = GPIO_MODE_INPUT_OUTPUT_OD,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE};
+    gpio_set_level(sda, 1);
+    gpio_set_level(scl, 1);
+    gpio_config(&conf);
+    esp_rom_delay_us(recoveryHalfPeriodUs);
+
+    // Slave holding SDA low waits for clocks of byte it's sending, it releases SDA on its ACK bit at latest.
+    int pulses = 0;
+    while (pulses < recoveryPulses && gpio_get_level(sda) == 0)
+    {
+        gpio_set_level(scl, 0);
+        esp_rom_delay_us(recoveryHalfPeriodUs);
+        gpio_set_level(scl, 1);
+        esp_rom_delay_us(recoveryHalfPeriodUs);
+        pulses++;
+    }
 
-    uint16_t res = (((uint16_t)resMsb << 8) | resLsb);
+    // Stop condition, SDA rises while SCL is high.
+    gpio_set_level(scl, 0);
+    esp_rom_delay_us(recoveryHalfPeriodUs);
+    gpio_set_level(sda, 0);
+    esp_rom_delay_us(recoveryHalfPeriodUs);
+    gpio_set_level(scl, 1);
+    esp_rom_delay_us(recoveryHalfPeriodUs);
+    gpio_set_level(sda, 1);
+    esp_rom_delay_us(recoveryHalfPeriodUs);
 
-    return res;
-}
\ No newline at end of file
+    if (gpio_get_level(sda) == 0)
+        ESP_LOGE(TAG_I2C, "SDA still held low after %d clock pulses", pulses);
+    else if (pulses)
+        ESP_LOGW(TAG_I2C, "Bus recovered after %d clock pulses", pulses);
+
+    // Routes pins back to peripheral.
+    i2c_param_config(_port, &busConfig);
+}
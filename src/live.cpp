@@ -0,0 +1,229 @@
+#include "../include/live.hpp"
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+#include "lwip/sockets.h"
+#include "esp_log.h"
+
+static const char *TAG_LIVE = "LIVE";
+static const char *liveURI = "/live";
+
+static const size_t maxClients = 3;     //!< Further clients get 503.
+static const size_t eventSlots = 4;     //!< Samples that may wait for HTTP server task at once.
+static const size_t maxEventSize = 96;
+
+// Status line and headers are written by hand as response never ends.
+static const char *streamHeaders = "HTTP/1.1 200 OK\r\n"
+                                   "Content-Type: text/event-stream\r\n"
+                                   "Cache-Control: no-cache\r\n"
+                                   "Connection: keep-alive\r\n"
+                                   "\r\n"
+                                   "retry: 5000\n\n";
+
+/**
+ * @brief Encoded sample shared by all clients.
+ */
+struct Event
+{
+    std::atomic<bool> busy{false}; //!< Queued to HTTP server task, set by publisher and cleared by server task.
+    char data[maxEventSize];
+    size_t len;
+};
+
+static std::atomic<httpd_handle_t> liveServer{nullptr};
+static int clients[maxClients]; //!< Sockets of connected clients, -1 if free. Accessed by HTTP server task only.
+static Event events[eventSlots];
+
+static std::atomic<uint32_t> clientCount{0};
+static std::atomic<uint32_t> rejectedCount{0};
+static std::atomic<uint32_t> eventCount{0};
+static std::atomic<uint32_t> droppedEventCount{0};
+static std::atomic<uint32_t> droppedClientCount{0};
+
+// External functions.
+void Live_start(httpd_handle_t server);
+void Live_stop();
+void Live_closeSocket(httpd_handle_t server, int sockfd);
+void Live_push(const char *topic, const char *value, int64_t timestamp);
+Live_Stats Live_getStats();
+
+// Helper functions.
+/**
+ * @brief GET handler of /live, turns connection into event stream.
+ * @param req User's request.
+ * @return ESP error.
+ */
+static esp_err_t liveHandler(httpd_req_t *req);
+
+/**
+ * @brief Send event to every client. Runs in HTTP server task.
+ * @param arg Event.
+ */
+static void broadcast(void *arg);
+
+/**
+ * @brief Remove socket from clients.
+ * @param sockfd Socket.
+ * @return True if socket was a client.
+ */
+static bool removeClient(int sockfd);
+
+// Function definitions.
+void Live_start(httpd_handle_t server)
+{
+    // Server is not running so nothing is sent or queued now.
+    for (int &fd : clients)
+        fd = -1;
+    for (Event &event : events)
+        event.busy = false;
+    clientCount = 0;
+
+    httpd_uri_t liveGet = {
+        .uri = liveURI,
+        .method = HTTP_GET,
+        .handler = liveHandler,
+        .user_ctx = NULL};
+    ESP_ERROR_CHECK(httpd_register_uri_handler(server, &liveGet));
+
+    liveServer = server;
+}
+
+void Live_stop()
+{
+    liveServer = nullptr;
+}
+
+void Live_closeSocket(httpd_handle_t server, int sockfd)
+{
+    if (removeClient(sockfd))
+        ESP_LOGI(TAG_LIVE, "Client %d disconnected", sockfd);
+
+    close(sockfd);
+}
+
+void Live_push(const char *topic, const char *value, int64_t timestamp)
+{
+    httpd_handle_t server = liveServer;
+    if (!server || !clientCount)
+        return;
+
+    // Publisher is the only one taking slots, server task only frees them.
+    Event *event = nullptr;
+    for (Event &e : events)
+    {
+        if (!e.busy)
+        {
+            event = &e;
+            break;
+        }
+    }
+
+    // Server task is behind, skip sample rather than wait.
+    if (!event)
+    {
+        droppedEventCount++;
+        return;
+    }
+
+    int len = snprintf(event->data, sizeof(event->data), "data: {\"topic\":\"%s\",\"value\":%s,\"ts\":%lld}\n\n",
+                       topic, value, (long long)(timestamp / 1000));
+    if (len < 0 || (size_t)len >= sizeof(event->data))
+    {
+        droppedEventCount++;
+        return;
+    }
+    event->len = len;
+
+    event->busy = true;
+    if (httpd_queue_work(server, broadcast, event) != ESP_OK)
+    {
+        event->busy = false;
+        droppedEventCount++;
+    }
+}
+
+Live_Stats Live_getStats()
+{
+    Live_Stats stats;
+    stats.clients = clientCount;
+    stats.rejected = rejectedCount;
+    stats.events = eventCount;
+    stats.droppedEvents = droppedEventCount;
+    stats.droppedClients = droppedClientCount;
+    return stats;
+}
+
+static esp_err_t liveHandler(httpd_req_t *req)
+{
+    int sockfd = httpd_req_to_sockfd(req);
+
+    int *slot = nullptr;
+    for (int &fd : clients)
+    {
+        if (fd < 0)
+        {
+            slot = &fd;
+            break;
+        }
+    }
+
+    if (!slot)
+    {
+        rejectedCount++;
+        ESP_LOGW(TAG_LIVE, "Rejected client %d, %u connected", sockfd, (unsigned)maxClients);
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "10");
+        return httpd_resp_send(req, "Too many live clients", HTTPD_RESP_USE_STRLEN);
+    }
+
+    if (httpd_send(req, streamHeaders, strlen(streamHeaders)) < 0)
+        return ESP_FAIL;
+
+    // Session stays open, events are written straight to the socket by broadcast().
+    *slot = sockfd;
+    clientCount++;
+    ESP_LOGI(TAG_LIVE, "Client %d connected", sockfd);
+
+    return ESP_OK;
+}
+
+static void broadcast(void *arg)
+{
+    Event *event = (Event *)arg;
+    httpd_handle_t server = liveServer;
+
+    for (int &fd : clients)
+    {
+        if (fd < 0 || !server)
+            continue;
+
+        // Never wait for client, partial event would break the stream anyway.
+        int ret = httpd_socket_send(server, fd, event->data, event->len, MSG_DONTWAIT);
+        if (ret != (int)event->len)
+        {
+            ESP_LOGW(TAG_LIVE, "Client %d too slow, disconnecting", fd);
+            droppedClientCount++;
+            int sockfd = fd;
+            removeClient(sockfd);
+            httpd_sess_trigger_close(server, sockfd);
+        }
+    }
+
+    eventCount++;
+    event->busy = false;
+}
+
+static bool removeClient(int sockfd)
+{
+    for (int &fd : clients)
+    {
+        if (fd == sockfd)
+        {
+            fd = -1;
+            clientCount--;
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -5,13 +5,72 @@
 #include "../include/wifi.hpp"
 #include "../include/mqtt.hpp"
 #include "../include/http.hpp"
+#include "../include/benchmark.hpp"
+#include "../include/filters.hpp"
+#include "../include/time_sync.hpp"
+#include "../include/scheduler.hpp"
+#include "../include/sampling.hpp"
 
 #include "nvs_flash.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_sleep.h"
+#include "esp_attr.h"
 
-static void pressureTask(void *arg);
-static void humidityTask(void *arg);
+// Survive deep sleep so sequence numbers keep growing across wake ups.
+RTC_DATA_ATTR static uint32_t bmp180Seq = 0;
+RTC_DATA_ATTR static uint32_t dht11Seq = 0;
+
+#if DEEP_SLEEP_MODE
+static const char *TAG_MAIN = "MAIN";
+
+RTC_DATA_ATTR static uint32_t lastWakeToPublishUs = 0; //!< Reported on next wake as it's known only after publishing.
+
+/**
+ * @brief Take all measurements, publish them and go to deep sleep until next period.
+ */
+static void measureAndSleep();
+#else
+static DHT11 humiditySensor;
+
+#if PRESSURE_FILTER == PRESSURE_FILTER_MEDIAN
+static MedianFilter<int32_t, PRESSURE_MEDIAN_SIZE> pressureFilter;
+#elif PRESSURE_FILTER == PRESSURE_FILTER_EMA
+static EmaFilter<int32_t, PRESSURE_EMA_SHIFT> pressureFilter;
+#elif PRESSURE_FILTER == PRESSURE_FILTER_KALMAN
+static KalmanFilter<int32_t> pressureFilter(PRESSURE_KALMAN_Q, PRESSURE_KALMAN_R);
+#else
+#error "Unknown PRESSURE_FILTER"
+#endif
+
+static const uint32_t minHumidityPeriodMs = 2500; // DHT11 is too slow for faster readings.
+static const size_t humidityJob = 1;              // Index in sensorJobs.
+
+/**
+ * @brief Take single pressure sample, publish filtered value every publish interval.
+ * @param ctx Unused.
+ */
+static void samplePressure(void *ctx);
+
+/**
+ * @brief Read and publish humidity.
+ * @param ctx Unused.
+ */
+static void sampleHumidity(void *ctx);
+
+/**
+ * @brief Get period of humidity job.
+ * @param intervalMs Publish interval.
+ * @return Period.
+ */
+static uint32_t humidityPeriod(uint32_t intervalMs);
+
+// Both sensors are read by one worker, humidity is shifted so reads don't queue behind each other.
+static const Scheduler_Job sensorJobs[] = {
+    {"pressure", samplePressure, NULL, PRESSURE_SAMPLE_PERIOD_MS, 0, 100},
+    {"humidity", sampleHumidity, NULL, MEASUREMENT_PERIOD_MS, PRESSURE_SAMPLE_PERIOD_MS / 2, 200}};
+#endif
 
 extern "C"
 {
@@ -27,6 +86,12 @@ extern "C"
             err = nvs_flash_init();
         }
 
+#if RUN_BENCHMARKS
+        Benchmark_run();
+#endif
+
+        Sampling_init();
+
         // Create ESP event loop.
         esp_event_loop_create_default();
 
@@ -34,55 +99,129 @@ extern "C"
         I2C_init(I2C_PORT, I2C_SDA, I2C_SCL, I2C_FREQ);
         WiFi_init(SMART_CONFIG_BUTTON_PIN, SMART_CONFIG_LED_PIN, WIFI_LED_PIN);
         MQTT_init(MQTT_LED_PIN);
-        HTTP_init(HTTP_BUTTON_PIN, HTTP_LED_PIN);
+        MQTT_setCommandHandler(Sampling_handleCommand);
 
-        // Create tasks.
-        xTaskCreate(pressureTask, "pressureTask", 2048, (void *)5000, tskIDLE_PRIORITY, NULL);
-        xTaskCreate(humidityTask, "humidityTask", 4096, (void *)5000, tskIDLE_PRIORITY, NULL);
+#if DEEP_SLEEP_MODE
+        measureAndSleep();
+#else
+        HTTP_init(HTTP_BUTTON_PIN, HTTP_LED_PIN, &humiditySensor);
 
-        while (true)
-        {
-            vTaskDelay(1000 / portTICK_PERIOD_MS);
-        }
+        humiditySensor.init(DHT11_DATA_PIN, DHT11_RMT_CHANNEL);
+        Scheduler_start(sensorJobs, sizeof(sensorJobs) / sizeof(sensorJobs[0]));
+        Scheduler_setPeriod(humidityJob, humidityPeriod(Sampling_getSettings()->intervalMs));
+#endif
+        // Returning deletes main task, created tasks keep running.
     }
 }
 
-static void pressureTask(void *arg)
+#if !DEEP_SLEEP_MODE
+static void samplePressure(void *ctx)
 {
-    uint16_t delayTime = (uint16_t)((size_t)arg);
-
     static BMP180 sensor;
+    static RunningStats<int32_t> pressureStats; // Raw samples of current publish period.
+    static RunningStats<int32_t> temperatureStats;
+    static int32_t filteredPressure = 0;
+    static int64_t lastCapture = 0;
+    static uint32_t samples = 0;
 
-    while (true)
+    // Single version of settings for whole run, commands apply between runs.
+    Sampling_SettingsRef settings = Sampling_getSettings();
+    uint32_t samplesPerPublish = settings->intervalMs / PRESSURE_SAMPLE_PERIOD_MS;
+
+    // One cycle gives both values, temperature's B5 is reused for pressure.
+    if (sensor.start(settings->pressureMode) &&
+        sensor.wait() == BMP180::Status::READY)
     {
-        MQTT_publish("temperature", sensor.read(BMP180::MeasurementType::TEMPERATURE), 1);
-        MQTT_publish("pressure", sensor.read(BMP180::MeasurementType::ULTRA_HIGH_RES), 1);
-        vTaskDelay(delayTime / portTICK_PERIOD_MS);
+        lastCapture = TimeSync_nowUs();
+        filteredPressure = pressureFilter.update(sensor.getPressurePa());
+        pressureStats.add(sensor.getPressurePa());
+        temperatureStats.add(sensor.getTemperatureDeci());
     }
+
+    if (++samples < samplesPerPublish)
+        return;
+    samples = 0;
+
+    if (pressureStats.count())
+    {
+        // Aggregate is single sample stamped with its last read.
+        // Integer results, Pa with 2 decimals gives hPa, temperature has sensor's 0.1 °C resolution.
+        uint32_t seq = ++bmp180Seq;
+        MQTT_publishSample("temperature", {lastCapture, seq, SensorId::BMP180, (int32_t)lround(temperatureStats.mean()), 1}, settings->qos);
+        MQTT_publishSample("pressure", {lastCapture, seq, SensorId::BMP180, filteredPressure, 2}, settings->qos);
+#if PUBLISH_PRESSURE_STATS
+        MQTT_publishSample("pressure_min", {lastCapture, seq, SensorId::BMP180, pressureStats.min(), 2}, settings->qos);
+        MQTT_publishSample("pressure_max", {lastCapture, seq, SensorId::BMP180, pressureStats.max(), 2}, settings->qos);
+        MQTT_publishSample("pressure_stddev", {lastCapture, seq, SensorId::BMP180, (int32_t)lround(pressureStats.stddev() * 100), 4}, settings->qos);
+#endif
+    }
+    pressureStats.reset();
+    temperatureStats.reset();
 }
 
-static void humidityTask(void *arg)
+static void sampleHumidity(void *ctx)
 {
-    int16_t delayTime = (uint16_t)((size_t)arg);
+    Sampling_SettingsRef settings = Sampling_getSettings();
 
-    // This sensor is too slow to handle faster measurements.
-    if(delayTime < 2500)
-        delayTime = 2500;
+    int64_t capture = TimeSync_nowUs();
+    float result = humiditySensor.read();
+    if (result >= 0)
+        MQTT_publishSample("humidity", {capture, ++dht11Seq, SensorId::DHT11, (int32_t)result, 0}, settings->qos); // DHT11 gives integral % only.
 
-    static DHT11 sensor;
-    static bool fstScan = true;
-    if(fstScan){
-        sensor.init(DHT11_DATA_PIN);
-        fstScan = false;
-    }
-    
-    while (true)
-    {
-        float result = sensor.read();
-        if (result >= 0)
-            MQTT_publish("humidity", result, 1);
+    // Interval changed by command applies from next release.
+    Scheduler_setPeriod(humidityJob, humidityPeriod(settings->intervalMs));
+}
+
+static uint32_t humidityPeriod(uint32_t intervalMs)
+{
+    return intervalMs < minHumidityPeriodMs ? minHumidityPeriodMs : intervalMs;
+}
+#endif
+
+#if DEEP_SLEEP_MODE
+static void measureAndSleep()
+{
+    static BMP180 pressureSensor; // Calibration comes from RTC memory after first wake.
+    static DHT11 humiditySensor;
+    humiditySensor.init(DHT11_DATA_PIN, DHT11_RMT_CHANNEL);
 
-        // This sensor is too slow to handle faster readings.
-        vTaskDelay(delayTime / portTICK_PERIOD_MS);
+    Sampling_SettingsRef settings = Sampling_getSettings();
+
+    // Measure while WiFi and MQTT are connecting, BMP180 converts during DHT11 transaction.
+    // Clock runs through deep sleep, so it's valid once it was synced on any earlier wake.
+    int64_t capture = TimeSync_nowUs();
+    bool pressureStarted = pressureSensor.start(settings->pressureMode);
+    float humidity = humiditySensor.read();
+    bool pressureReady = pressureStarted && pressureSensor.wait() == BMP180::Status::READY;
+
+    // Publishing before connection would send samples to flash for replay.
+    MQTT_waitConnected(DEEP_SLEEP_PUBLISH_TIMEOUT_MS);
+
+    if (pressureReady)
+    {
+        uint32_t seq = ++bmp180Seq;
+        MQTT_publishSample("temperature", {capture, seq, SensorId::BMP180, pressureSensor.getTemperatureDeci(), 1}, settings->qos);
+        MQTT_publishSample("pressure", {capture, seq, SensorId::BMP180, pressureSensor.getPressurePa(), 2}, settings->qos);
     }
-}
\ No newline at end of file
+    if (humidity >= 0)
+        MQTT_publishSample("humidity", {capture, ++dht11Seq, SensorId::DHT11, (int32_t)humidity, 0}, settings->qos);
+    if (lastWakeToPublishUs)
+        MQTT_publishFixed("wake_publish", lastWakeToPublishUs, 3, 1); // In ms.
+
+    uint32_t timeout = DEEP_SLEEP_PUBLISH_TIMEOUT_MS - esp_timer_get_time() / 1000;
+    if (timeout > DEEP_SLEEP_PUBLISH_TIMEOUT_MS)
+        timeout = 0;
+    bool published = MQTT_flush(timeout) && MQTT_waitConnected(0);
+
+    // esp_timer counts from application start, so this excludes ROM and bootloader time.
+    int64_t awake = esp_timer_get_time();
+    lastWakeToPublishUs = published ? awake : 0;
+    ESP_LOGI(TAG_MAIN, "Awake for %lld us, %s", (long long)awake, published ? "published" : "broker not reached");
+
+    int64_t sleepTime = (int64_t)settings->intervalMs * 1000 - awake;
+    if (sleepTime < 0)
+        sleepTime = 0;
+    esp_sleep_enable_timer_wakeup(sleepTime);
+    esp_deep_sleep_start();
+}
+#endif
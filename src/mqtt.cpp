@@ -1,57 +1,222 @@
 #include "../include/mqtt.hpp"
+#include "../include/config.hpp"
+#include "../include/spsc_queue.hpp"
+#include "../include/sample_log.hpp"
+#include "../include/cbor.hpp"
+#include "../include/trace.hpp"
+#include "../include/time_sync.hpp"
+#include "../include/deadband.hpp"
+#include "../include/mqtt_format.hpp"
+#include <stddef.h>
+#include <stdlib.h>
+#include <atomic>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
+#include "esp_rom_crc.h"
 #include "mqtt_client.h"
 #include "driver/gpio.h"
 
 static const char *TAG_MQTT = "MQTT";
 
-static SemaphoreHandle_t mqttResourceSemaphore;
+static SemaphoreHandle_t configWriteSemaphore; //!< Serializes config writers, readers use snapshots.
+static SemaphoreHandle_t reInitSemaphore;      //!< Serializes MQTT_reInit() calls.
+static SemaphoreHandle_t switchDoneSemaphore;  //!< Given by publisher task after switching sessions.
 
-static bool connected = false;
 static gpio_num_t _led;
 
-static const size_t maxIpSize = 16;
-static const size_t maxPortSize = 6;
-static const size_t maxUsernameSize = 33;
-static const size_t maxPasswordSize = 33;
-static const size_t maxNamespaceSize = 33;
+static const size_t maxNamespaceSize = sizeof(MQTT_Settings::ns);
 
-static char ip[maxIpSize], port[maxPortSize], username[maxUsernameSize], password[maxPasswordSize], ns[maxNamespaceSize];
-static size_t ipSize = maxIpSize,
-              portSize = maxPortSize,
-              usernameSize = maxUsernameSize,
-              passwordSize = maxPasswordSize,
-              namespaceSize = maxNamespaceSize;
+static const uint16_t configVersion = 1; //!< Bump when layout of Config changes and add migration.
 
-static esp_mqtt_client_handle_t client;
+/**
+ * @brief MQTT config, stored in flash as single blob.
+ */
+struct Config
+{
+    uint16_t version;       //!< Layout version.
+    uint16_t size;          //!< Size of blob.
+    MQTT_Settings settings; //!< Settings.
+    uint32_t crc;           //!< CRC32 of all previous bytes.
+};
+
+static Config config;                     //!< Cached copy of flash, accessed by writers only.
+static MQTT_Settings staged;              //!< Settings in use with changes from MQTT_updateX() applied, committed by MQTT_reInit().
+static Snapshots<MQTT_Settings> settings; //!< Settings in use, read without locking.
+
+/**
+ * @brief Payload format of batched measurements.
+ */
+enum class BatchMode : uint8_t
+{
+    OFF,  //!< Every sample in its own message.
+    JSON, //!< Samples of single window in one JSON object.
+    CBOR  //!< Samples of single window in one CBOR map.
+};
+
+/**
+ * @brief Connection to broker made by single MQTT client.
+ */
+struct Session
+{
+    esp_mqtt_client_handle_t client = nullptr;
+    std::atomic<bool> connected{false};
+    std::atomic<uint32_t> inFlight{0}; //!< QoS > 0 messages waiting for acknowledge.
+};
+
+static Session sessions[2];                                //!< Active one and one being brought up by MQTT_reInit().
+static std::atomic<Session *> activeSession{&sessions[0]}; //!< Used by publisher task.
+static std::atomic<Session *> pendingSession{nullptr};     //!< Handed over to publisher task to switch to.
+static const TickType_t sessionStartTimeout = pdMS_TO_TICKS(5000); //!< Max time old session keeps publishing after reconfiguration.
+static const TickType_t sessionDrainTimeout = pdMS_TO_TICKS(2000); //!< Max time old session waits for acknowledges before it's destroyed.
+
+static const size_t maxTopicSize = 16;
+static const size_t maxPayloadSize = 68; //!< Single sample payload, see formatPayload().
+static const size_t maxProducers = 4;         //!< Max number of tasks calling MQTT_publishX().
+static const uint32_t producerQueueSize = 16; //!< Samples buffered per producer task.
+
+/**
+ * @brief Sample waiting in publish queue.
+ */
+struct Sample
+{
+    int64_t timestamp; //!< Capture time in µs since epoch, 0 if clock was not set.
+    uint32_t seq;      //!< Sequence number of sensor read.
+    uint32_t topicSeq; //!< Number of message on its topic, assigned once sample passed deadband.
+    union
+    {
+        float f;       //!< Published with "%f".
+        int32_t fixed; //!< Published with given number of decimals.
+    } value;
+    char topic[maxTopicSize]; //!< Topic without namespace.
+    bool isFloat;             //!< Which member of value is valid.
+    uint8_t decimals;         //!< Decimals of fixed point value.
+    uint8_t qos;              //!< QoS.
+    SensorId sensor;          //!< Source.
+};
+
+static_assert(sizeof(Sample) <= SAMPLE_LOG_PAYLOAD_SIZE, "Sample must fit in sample log record");
+
+/**
+ * @brief Publish queue owned by single task.
+ */
+struct Producer
+{
+    std::atomic<TaskHandle_t> owner{nullptr};   //!< Task that pushes to this queue.
+    SPSCQueue<Sample, producerQueueSize> queue; //!< Samples waiting for publisher task.
+};
+
+static Producer producers[maxProducers];
+static TaskHandle_t publisherTaskHandle;
+
+static std::atomic<uint32_t> maxQueueDepth{0};
+static std::atomic<uint32_t> publishedCount{0};
+static std::atomic<uint32_t> suppressedCount{0};
+static std::atomic<uint32_t> droppedFullCount{0};
+static std::atomic<uint32_t> droppedNoQueueCount{0};
+static std::atomic<uint32_t> droppedOfflineCount{0};
+static std::atomic<uint32_t> unacknowledgedCount{0};
+static std::atomic<uint32_t> storedCount{0};
+static std::atomic<uint32_t> replayedCount{0};
+static std::atomic<uint32_t> publishFailedCount{0};
+static std::atomic<uint32_t> connectCount{0};
+static std::atomic<uint32_t> disconnectCount{0};
+
+static std::atomic<bool> flushRequested{false}; //!< Set by MQTT_flush(), publisher closes batch window right away.
+static std::atomic<bool> publisherIdle{false};  //!< Publisher holds no sample outside of producer queues.
+static const TickType_t flushPollPeriod = pdMS_TO_TICKS(10);
+
+/**
+ * @brief Report by exception state of topic, accessed by publisher task only.
+ */
+struct DeadbandTopic
+{
+    const char *topic;
+    Deadband<int32_t> filter; //!< Fixed point value, time in ms.
+
+    DeadbandTopic(const char *topic, int32_t band, uint32_t heartbeatMs) : topic(topic), filter(band, heartbeatMs) {}
+};
+
+static DeadbandTopic deadbands[] = {MQTT_DEADBANDS};
+
+/**
+ * @brief Messages sent on topic since boot, accessed by publisher task only.
+ */
+struct TopicCounter
+{
+    char topic[maxTopicSize];
+    uint32_t count;
+};
+
+static const size_t maxCountedTopics = 16; //!< Further topics are published with message number 0.
+static TopicCounter topicCounters[maxCountedTopics];
+
+static std::atomic<MQTT_SampleSink> sampleSink{nullptr};
+static std::atomic<MQTT_CommandHandler> commandHandler{nullptr};
+static const size_t maxCommandSize = 128; //!< Longer commands are rejected.
+static const size_t maxReplySize = 64;
+
+static const size_t maxBatchSize = 8;                       //!< Max samples in single batched message.
+static const TickType_t batchWindow = pdMS_TO_TICKS(1000);  //!< Samples arriving within this time go to the same message.
+static const size_t maxBatchPayloadSize = 320;
+
+static Sample batch[maxBatchSize]; //!< Samples of current window, accessed by publisher task only.
+static size_t batchCount;
+static TickType_t batchStart;
+static uint32_t batchMessageCount; //!< Batched messages sent since boot.
+
+static const uint32_t replayBatchSize = 10;                //!< Max stored samples replayed at once.
+static const TickType_t replayPeriod = pdMS_TO_TICKS(1000); //!< Min time between replay batches.
+
+static const TickType_t statsPeriod = pdMS_TO_TICKS(60000); //!< Period of latency stats messages.
+static const size_t maxStatsPayloadSize = 512;
 
 // External functions.
 void MQTT_init(gpio_num_t LEDGPIO);
 void MQTT_reInit();
 
-void MQTT_resourceTake();
-void MQTT_resourceRelease();
-
 void MQTT_publish(const char *topic, float data, int qos);
+void MQTT_publishFixed(const char *topic, int32_t value, uint8_t decimals, int qos);
+void MQTT_publishSample(const char *topic, const SampleRecord &record, int qos);
+bool MQTT_waitConnected(uint32_t timeoutMs);
+bool MQTT_flush(uint32_t timeoutMs);
+void MQTT_setSampleSink(MQTT_SampleSink sink);
+void MQTT_setCommandHandler(MQTT_CommandHandler handler);
+MQTT_QueueStats MQTT_getQueueStats();
+MQTT_ConnectionStats MQTT_getConnectionStats();
 
 void MQTT_updateIP(const char *ip);
 void MQTT_updatePort(const char *port);
 void MQTT_updateUser(const char *usr);
 void MQTT_updatePassword(const char *passwd);
 void MQTT_updateNamespace(const char *ns);
+void MQTT_updateBatchMode(const char *mode);
+void MQTT_setBatchMode(const char *mode);
 
-const char *MQTT_getIP();
-const char *MQTT_getPort();
-const char *MQTT_getUser();
-const char *MQTT_getPassword();
-const char *MQTT_getNamespace();
+MQTT_SettingsRef MQTT_getSettings();
 
 // Helper functions.
 /**
- * @brief Init MQTT.
+ * @brief Create and start client of session using current settings.
+ * @param session Unused session.
  */
-void init_impl();
+static void startSession(Session &session);
+
+/**
+ * @brief Make session active and free client of previous one once broker acknowledged its messages or drain timeout passed.
+ * Called from publisher task only.
+ * @param next Session to switch to.
+ */
+static void switchSession(Session *next);
+
+/**
+ * @brief Check whether active session is connected.
+ * @return True if connected.
+ */
+static bool isConnected();
 
 /**
  * @brief Init GPIO that will be used for MQTT LED.
@@ -59,24 +224,210 @@ void init_impl();
 static void initGPIO(gpio_num_t gpio);
 
 /**
- * @brief Publish any primitive data to broker.
- * @param topic Topic to publish.
- * @param data Data to publish.
+ * @brief Get publish queue of calling task, claim free one on first call.
+ * @return Queue or nullptr if all queues are taken by other tasks.
+ */
+static Producer *getProducer();
+
+/**
+ * @brief Put sample into calling task's queue and wake publisher task. Never blocks.
+ * @param sample Sample to queue.
+ */
+static void enqueue(const Sample &sample);
+
+/**
+ * @brief Only task that talks to MQTT client. Drains producer queues.
+ * @param arg Unused.
+ */
+static void publisherTask(void *arg);
+
+/**
+ * @brief Check whether every sample was published or stored.
+ * @return True if nothing is left in RAM.
+ */
+static bool flushed();
+
+/**
+ * @brief Pass sample to sample sink if there is one. Called from publisher task only.
+ * @param sample Sample.
+ */
+static void forwardToSink(const Sample &sample);
+
+/**
+ * @brief Check deadband of sample's topic. Called from publisher task only.
+ * @param sample Sample.
+ * @return True if sample should be published.
+ */
+static bool passesDeadband(const Sample &sample);
+
+/**
+ * @brief Number next message on topic. Called from publisher task only.
+ * @param topic Topic without namespace.
+ * @return Message number starting at 1, 0 if there are too many topics to count.
+ */
+static uint32_t nextTopicSeq(const char *topic);
+
+/**
+ * @brief Publish message and track its acknowledge. Called from publisher task only.
+ * @param topic Topic.
+ * @param data Payload.
+ * @param len Length of payload or 0 if it is null terminated.
  * @param qos QoS.
- * @param formatter Formatter string such as in printf().
+ * @return Message id or -1 on failure.
+ */
+static int clientPublish(const char *topic, const char *data, int len, int qos);
+
+/**
+ * @brief Publish sample to broker or store it in sample log if broker is not connected.
+ * Called from publisher task only.
+ * @param sample Sample to publish.
+ */
+static void MQTT_publish_impl(const Sample &sample);
+
+/**
+ * @brief Publish batch of samples stored while broker was not connected.
+ * Called from publisher task only.
+ * @return False if there are no more stored samples.
+ */
+static bool replayStored();
+
+/**
+ * @brief Add sample to current batch window. Called from publisher task only.
+ * @param sample Sample to add.
+ */
+static void addToBatch(const Sample &sample);
+
+/**
+ * @brief Publish all samples of current batch window as single message on <namespace>/batch.
+ * Called from publisher task only.
+ */
+static void flushBatch();
+
+/**
+ * @brief Publish latency stats of last period on <namespace>/stats.
+ * Called from publisher task only.
+ */
+static void publishStats();
+
+/**
+ * @brief Encode batch as JSON object.
+ * @param buf Output buffer.
+ * @param size Size of output buffer.
+ * @return Length of payload or 0 if it didn't fit.
+ */
+static size_t encodeBatchJSON(char *buf, size_t size);
+
+/**
+ * @brief Encode batch as CBOR map.
+ * @param buf Output buffer.
+ * @param size Size of output buffer.
+ * @return Length of payload or 0 if it didn't fit.
+ */
+static size_t encodeBatchCBOR(uint8_t *buf, size_t size);
+
+/**
+ * @brief Get newest sequence number of every sensor in batch.
+ * @param seqs Output, indexed by SensorId, 0 if sensor has no sample in batch.
+ * @return Number of sensors with samples in batch.
  */
-template <typename T>
-void MQTT_publish_impl(const char *topic, T data, int qos, const char *formatter);
+static size_t batchSequences(uint32_t seqs[(size_t)SensorId::COUNT]);
 
 /**
- * @brief Load MQTT config from flash. 
- * Must be able to take resources using MQTT_resourceTake().
+ * @brief Parse batch mode name.
+ * @param mode "off", "json" or "cbor".
+ * @return Batch mode, OFF for unknown names.
+ */
+static BatchMode parseBatchMode(const char *mode);
+
+/**
+ * @brief Format sample's value as text.
+ * @param sample Sample.
+ * @param buf Output buffer.
+ * @param size Size of output buffer.
+ */
+static void formatValue(const Sample &sample, char *buf, size_t size);
+
+/**
+ * @brief Format payload of single sample as <value>,<capture time in ms since epoch>,<sensor>,<seq>.
+ * @param sample Sample.
+ * @param buf Output buffer.
+ * @param size Size of output buffer.
+ */
+static void formatPayload(const Sample &sample, char *buf, size_t size);
+
+/**
+ * @brief Load MQTT config from flash, migrate it from separate string keys if blob doesn't exist yet.
  */
 static void loadFromFlash();
 
 /**
- * @brief 
- * @param handlerArgs Unused.
+ * @brief Read config stored by previous firmware as separate string keys
+ * and replace them with config blob.
+ * @param nvsHandle Opened "mqtt" namespace.
+ */
+static void migrateFromStrings(nvs_handle_t nvsHandle);
+
+/**
+ * @brief Write staged config to flash with single commit if it differs from config in use and start using it.
+ * @return True if broker or credentials changed so new connection is needed.
+ */
+static bool commitConfig();
+
+/**
+ * @brief Save settings to flash with single commit and start using them.
+ * Called with configWriteSemaphore taken.
+ * @param newSettings Settings.
+ */
+static void writeConfig(const MQTT_Settings &newSettings);
+
+/**
+ * @brief Make settings current for readers.
+ * Called with configWriteSemaphore taken.
+ * @param newSettings Settings.
+ */
+static void publishSettings(const MQTT_Settings &newSettings);
+
+/**
+ * @brief Write config to flash with single commit.
+ * @param nvsHandle Opened "mqtt" namespace.
+ * @param conf Config to write, its checksum is updated.
+ * @return ESP_OK on success.
+ */
+static esp_err_t saveConfig(nvs_handle_t nvsHandle, Config &conf);
+
+/**
+ * @brief Checksum of config.
+ * @param conf Config.
+ * @return CRC32 of everything before crc field.
+ */
+static uint32_t configCrc(const Config &conf);
+
+/**
+ * @brief Copy value to field of staged config.
+ * @param field Field.
+ * @param size Size of field.
+ * @param value Value to copy, truncated to field's size.
+ */
+static void stageField(char *field, size_t size, const char *value);
+
+/**
+ * @brief Subscribe session to command topic of namespace.
+ * @param session Connected session.
+ * @param ns Namespace.
+ */
+static void subscribeCommands(Session &session, const char *ns);
+
+/**
+ * @brief Pass message received on command topic to command handler and publish its reply.
+ * Called from MQTT client's task.
+ * @param session Session that received the message.
+ * @param event Data event.
+ */
+static void handleCommand(Session &session, esp_mqtt_event_handle_t event);
+
+/**
+ * @brief Track connection state of session.
+ * @param handlerArgs Session.
  * @param base Unused.
  * @param eventId Event id.
  * @param eventData Unused.
@@ -87,129 +438,292 @@ static void eventHandler(void *handlerArgs, esp_event_base_t base, int32_t event
 void MQTT_init(gpio_num_t LEDGPIO)
 {
     initGPIO(LEDGPIO);
-    init_impl();
+
+    configWriteSemaphore = xSemaphoreCreateMutex();
+    reInitSemaphore = xSemaphoreCreateMutex();
+    switchDoneSemaphore = xSemaphoreCreateBinary();
+    loadFromFlash();
+
+    startSession(*activeSession);
+
+    SampleLog_init();
+    xTaskCreate(publisherTask, "MQTTPublisherTask", 4096, NULL, tskIDLE_PRIORITY + 1, &publisherTaskHandle);
 }
 
 void MQTT_reInit()
 {
-    esp_mqtt_client_disconnect(client);
-    esp_mqtt_client_stop(client);
-    init_impl();
+    xSemaphoreTake(reInitSemaphore, portMAX_DELAY);
+
+    char oldNs[maxNamespaceSize];
+    strlcpy(oldNs, settings.acquire()->ns, sizeof(oldNs));
+
+    // Namespace and batch mode are picked up by next sample, only broker change needs new connection.
+    if (!commitConfig())
+    {
+        // Command topic follows namespace.
+        MQTT_SettingsRef current = settings.acquire();
+        Session *session = activeSession;
+        if (strcmp(oldNs, current->ns) != 0 && session->connected)
+        {
+            char topic[maxNamespaceSize + sizeof("/cmd")];
+            MQTT_formatTopic(topic, sizeof(topic), oldNs, "cmd");
+            esp_mqtt_client_unsubscribe(session->client, topic);
+            subscribeCommands(*session, current->ns);
+        }
+
+        xSemaphoreGive(reInitSemaphore);
+        return;
+    }
+
+    Session *old = activeSession;
+    Session *next = old == &sessions[0] ? &sessions[1] : &sessions[0];
+    startSession(*next);
+
+    // Old session keeps publishing until new one is up.
+    TickType_t start = xTaskGetTickCount();
+    while (!next->connected && xTaskGetTickCount() - start < sessionStartTimeout)
+        vTaskDelay(flushPollPeriod);
+
+    if (!next->connected)
+        ESP_LOGW(TAG_MQTT, "New broker not connected yet, switching anyway");
+
+    // Publisher task owns active client so it switches between two messages.
+    pendingSession = next;
+    xTaskNotifyGive(publisherTaskHandle);
+    xSemaphoreTake(switchDoneSemaphore, portMAX_DELAY);
+
+    ESP_LOGI(TAG_MQTT, "Switched to new session, free heap: %u", (unsigned)esp_get_free_heap_size());
+
+    xSemaphoreGive(reInitSemaphore);
 }
 
-void MQTT_resourceTake()
+void MQTT_publish(const char *topic, float data, int qos)
 {
-    xSemaphoreTake(mqttResourceSemaphore, (TickType_t)10);
+    Sample sample;
+    sample.timestamp = TimeSync_nowUs();
+    sample.seq = 0;
+    sample.topicSeq = 0;
+    sample.sensor = SensorId::NONE;
+    strlcpy(sample.topic, topic, sizeof(sample.topic));
+    sample.isFloat = true;
+    sample.value.f = data;
+    sample.decimals = 0;
+    sample.qos = qos;
+    enqueue(sample);
 }
 
-void MQTT_resourceRelease()
+void MQTT_publishFixed(const char *topic, int32_t value, uint8_t decimals, int qos)
 {
-    xSemaphoreGive(mqttResourceSemaphore);
+    Sample sample;
+    sample.timestamp = TimeSync_nowUs();
+    sample.seq = 0;
+    sample.topicSeq = 0;
+    sample.sensor = SensorId::NONE;
+    strlcpy(sample.topic, topic, sizeof(sample.topic));
+    sample.isFloat = false;
+    sample.value.fixed = value;
+    sample.decimals = decimals;
+    sample.qos = qos;
+    enqueue(sample);
 }
 
-void MQTT_publish(const char *topic, float data, int qos)
+void MQTT_publishSample(const char *topic, const SampleRecord &record, int qos)
+{
+    Sample sample;
+    sample.timestamp = record.timestamp;
+    sample.seq = record.seq;
+    sample.topicSeq = 0;
+    sample.sensor = record.sensor;
+    strlcpy(sample.topic, topic, sizeof(sample.topic));
+    sample.isFloat = false;
+    sample.value.fixed = record.value;
+    sample.decimals = record.decimals;
+    sample.qos = qos;
+    enqueue(sample);
+}
+
+bool MQTT_waitConnected(uint32_t timeoutMs)
+{
+    TickType_t start = xTaskGetTickCount();
+    while (!isConnected() && xTaskGetTickCount() - start < pdMS_TO_TICKS(timeoutMs))
+        vTaskDelay(flushPollPeriod);
+
+    return isConnected();
+}
+
+bool MQTT_flush(uint32_t timeoutMs)
+{
+    flushRequested = true;
+    if (publisherTaskHandle)
+        xTaskNotifyGive(publisherTaskHandle);
+
+    TickType_t start = xTaskGetTickCount();
+    bool done;
+    while (!(done = flushed()) && xTaskGetTickCount() - start < pdMS_TO_TICKS(timeoutMs))
+        vTaskDelay(flushPollPeriod);
+
+    flushRequested = false;
+    return done;
+}
+
+void MQTT_setSampleSink(MQTT_SampleSink sink)
+{
+    sampleSink = sink;
+}
+
+void MQTT_setCommandHandler(MQTT_CommandHandler handler)
+{
+    commandHandler = handler;
+}
+
+MQTT_QueueStats MQTT_getQueueStats()
+{
+    MQTT_QueueStats stats;
+
+    stats.depth = 0;
+    for (Producer &p : producers)
+        stats.depth += p.queue.size();
+
+    stats.maxDepth = maxQueueDepth;
+    stats.published = publishedCount;
+    stats.suppressed = suppressedCount;
+    stats.droppedFull = droppedFullCount;
+    stats.droppedNoQueue = droppedNoQueueCount;
+    stats.droppedOffline = droppedOfflineCount;
+    stats.unacknowledged = unacknowledgedCount;
+    stats.stored = storedCount;
+    stats.replayed = replayedCount;
+    stats.storedPending = SampleLog_getStats().pending;
+    return stats;
+}
+
+MQTT_ConnectionStats MQTT_getConnectionStats()
 {
-    MQTT_publish_impl(topic, data, qos, "%f");
+    MQTT_ConnectionStats stats;
+    stats.connected = isConnected();
+    stats.connects = connectCount;
+    stats.disconnects = disconnectCount;
+    stats.publishFailures = publishFailedCount;
+    return stats;
 }
 
 void MQTT_updateIP(const char *ip)
 {
     ESP_LOGI(TAG_MQTT, "Updated IP: %s", ip);
-
-    nvs_handle_t nvsHandle;
-    ESP_ERROR_CHECK(nvs_open("mqtt", NVS_READWRITE, &nvsHandle));
-    ESP_ERROR_CHECK(nvs_set_str(nvsHandle, "ip", ip));
-    ESP_ERROR_CHECK(nvs_commit(nvsHandle));
-    nvs_close(nvsHandle);
+    stageField(staged.ip, sizeof(staged.ip), ip);
 }
 
 void MQTT_updatePort(const char *port)
 {
     ESP_LOGI(TAG_MQTT, "Updated port: %s", port);
-
-    nvs_handle_t nvsHandle;
-    ESP_ERROR_CHECK(nvs_open("mqtt", NVS_READWRITE, &nvsHandle));
-    ESP_ERROR_CHECK(nvs_set_str(nvsHandle, "port", port));
-    ESP_ERROR_CHECK(nvs_commit(nvsHandle));
-    nvs_close(nvsHandle);
+    stageField(staged.port, sizeof(staged.port), port);
 }
 
 void MQTT_updateUser(const char *usr)
 {
     ESP_LOGI(TAG_MQTT, "Updated username: %s", usr);
-
-    nvs_handle_t nvsHandle;
-    ESP_ERROR_CHECK(nvs_open("mqtt", NVS_READWRITE, &nvsHandle));
-    ESP_ERROR_CHECK(nvs_set_str(nvsHandle, "usr", usr));
-    ESP_ERROR_CHECK(nvs_commit(nvsHandle));
-    nvs_close(nvsHandle);
+    stageField(staged.username, sizeof(staged.username), usr);
 }
 
 void MQTT_updatePassword(const char *passwd)
 {
     ESP_LOGI(TAG_MQTT, "Updated password: %s", passwd);
-
-    nvs_handle_t nvsHandle;
-    ESP_ERROR_CHECK(nvs_open("mqtt", NVS_READWRITE, &nvsHandle));
-    ESP_ERROR_CHECK(nvs_set_str(nvsHandle, "pwd", passwd));
-    ESP_ERROR_CHECK(nvs_commit(nvsHandle));
-    nvs_close(nvsHandle);
+    stageField(staged.password, sizeof(staged.password), passwd);
 }
 
 void MQTT_updateNamespace(const char *ns)
 {
     ESP_LOGI(TAG_MQTT, "Updated namespace: %s", ns);
-
-    nvs_handle_t nvsHandle;
-    ESP_ERROR_CHECK(nvs_open("mqtt", NVS_READWRITE, &nvsHandle));
-    ESP_ERROR_CHECK(nvs_set_str(nvsHandle, "ns", ns));
-    ESP_ERROR_CHECK(nvs_commit(nvsHandle));
-    nvs_close(nvsHandle);
+    stageField(staged.ns, sizeof(staged.ns), ns);
 }
 
-const char *MQTT_getIP()
+void MQTT_updateBatchMode(const char *mode)
 {
-    return ip;
+    ESP_LOGI(TAG_MQTT, "Updated batch mode: %s", mode);
+    stageField(staged.batchMode, sizeof(staged.batchMode), mode);
 }
 
-const char *MQTT_getPort()
+void MQTT_setBatchMode(const char *mode)
 {
-    return port;
-}
+    ESP_LOGI(TAG_MQTT, "Set batch mode: %s", mode);
 
-const char *MQTT_getUser()
-{
-    return username;
+    xSemaphoreTake(configWriteSemaphore, portMAX_DELAY);
+
+    MQTT_Settings newSettings = config.settings;
+    strncpy(newSettings.batchMode, mode, sizeof(newSettings.batchMode) - 1); // Pads with zeros like stageField().
+    newSettings.batchMode[sizeof(newSettings.batchMode) - 1] = 0;
+
+    // Staged batch mode follows the one in use unless web form staged its own, which then wins on MQTT_reInit().
+    if (memcmp(staged.batchMode, config.settings.batchMode, sizeof(staged.batchMode)) == 0)
+        memcpy(staged.batchMode, newSettings.batchMode, sizeof(staged.batchMode));
+
+    // Batch mode is picked up by next sample, broker fields of saved config stay as they are.
+    if (memcmp(newSettings.batchMode, config.settings.batchMode, sizeof(newSettings.batchMode)) != 0)
+        writeConfig(newSettings);
+
+    xSemaphoreGive(configWriteSemaphore);
 }
 
-const char *MQTT_getPassword()
+MQTT_SettingsRef MQTT_getSettings()
 {
-    return password;
+    return settings.acquire();
 }
 
-const char *MQTT_getNamespace()
+static void startSession(Session &session)
 {
-    return ns;
+    ESP_LOGI(TAG_MQTT, "Starting MQTT client");
+
+    MQTT_SettingsRef current = settings.acquire();
+
+    // Client keeps its own copies of strings.
+    const esp_mqtt_client_config_t mqtt_cfg = {
+        .host = current->ip,
+        .port = (uint32_t)atoi(current->port),
+        .username = current->username,
+        .password = current->password};
+
+    session.connected = false;
+    session.inFlight = 0;
+    session.client = esp_mqtt_client_init(&mqtt_cfg);
+    esp_mqtt_client_register_event(session.client, (esp_mqtt_event_id_t)ESP_EVENT_ANY_ID, eventHandler, &session);
+    esp_mqtt_client_start(session.client);
 }
 
-void init_impl()
+static void switchSession(Session *next)
 {
-    ESP_LOGI(TAG_MQTT, "Starting MQTT client");
+    // Samples of open window were meant for previous session.
+    if (batchCount)
+        flushBatch();
 
-    if (mqttResourceSemaphore == NULL)
-        mqttResourceSemaphore = xSemaphoreCreateMutex();
+    Session *old = activeSession;
 
-    loadFromFlash();
+    // Client's outbox dies with it, give broker a chance to acknowledge what it holds.
+    TickType_t start = xTaskGetTickCount();
+    while (old->connected && old->inFlight && xTaskGetTickCount() - start < sessionDrainTimeout)
+        vTaskDelay(flushPollPeriod);
 
-    const esp_mqtt_client_config_t mqtt_cfg = {
-        .host = ip,
-        .port = (uint32_t)atoi(port),
-        .username = username,
-        .password = password};
+    activeSession = next;
+    gpio_set_level(_led, next->connected);
+
+    // Destroy stops client's task so its events can't arrive anymore.
+    esp_mqtt_client_disconnect(old->client);
+    esp_mqtt_client_destroy(old->client);
+    old->client = nullptr;
+    old->connected = false;
+
+    uint32_t lost = old->inFlight.exchange(0);
+    if (lost)
+    {
+        unacknowledgedCount += lost;
+        ESP_LOGW(TAG_MQTT, "%u messages of previous session were not acknowledged", (unsigned)lost);
+    }
 
-    client = esp_mqtt_client_init(&mqtt_cfg);
-    esp_mqtt_client_register_event(client, (esp_mqtt_event_id_t)ESP_EVENT_ANY_ID, eventHandler, client);
-    esp_mqtt_client_start(client);
+    xSemaphoreGive(switchDoneSemaphore);
+}
+
+static bool isConnected()
+{
+    return activeSession.load()->connected;
 }
 
 static void initGPIO(gpio_num_t led)
@@ -224,91 +738,666 @@ static void initGPIO(gpio_num_t led)
     _led = led;
 }
 
-template <typename T>
-void MQTT_publish_impl(const char *topic, T data, int qos, const char *formatter)
+static Producer *getProducer()
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+
+    for (Producer &p : producers)
+    {
+        if (p.owner.load(std::memory_order_acquire) == self)
+            return &p;
+    }
+
+    // First publish from this task.
+    for (Producer &p : producers)
+    {
+        TaskHandle_t expected = nullptr;
+        if (p.owner.compare_exchange_strong(expected, self))
+            return &p;
+    }
+
+    return nullptr;
+}
+
+static void enqueue(const Sample &sample)
+{
+    Producer *p = getProducer();
+    if (p == nullptr)
+    {
+        // More publishing tasks than producer slots, raise maxProducers.
+        droppedNoQueueCount++;
+        return;
+    }
+    if (!p->queue.push(sample))
+    {
+        droppedFullCount++;
+        return;
+    }
+
+    // Track max depth without locking.
+    uint32_t depth = p->queue.size();
+    uint32_t prevMax = maxQueueDepth.load();
+    while (depth > prevMax && !maxQueueDepth.compare_exchange_weak(prevMax, depth))
+    {
+    }
+
+    if (publisherTaskHandle)
+        xTaskNotifyGive(publisherTaskHandle);
+}
+
+static void publisherTask(void *arg)
+{
+    const TickType_t maxBlockTime = pdMS_TO_TICKS(1000);
+
+    TickType_t blockTime = maxBlockTime;
+    TickType_t lastReplay = xTaskGetTickCount() - replayPeriod;
+    TickType_t lastStats = xTaskGetTickCount();
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, blockTime);
+        publisherIdle = false;
+
+        Session *next = pendingSession.exchange(nullptr);
+        if (next)
+            switchSession(next);
+
+        // Live samples first so replay never delays them.
+        Sample sample;
+        for (Producer &p : producers)
+        {
+            while (p.queue.pop(sample))
+            {
+                // Live feed shows every sample, broker gets changes only.
+                forwardToSink(sample);
+                if (passesDeadband(sample))
+                {
+                    // Numbered after deadband, so gaps are messages lost on the way, not suppressed ones.
+                    sample.topicSeq = nextTopicSeq(sample.topic);
+                    MQTT_publish_impl(sample);
+                }
+                else
+                    suppressedCount++;
+            }
+        }
+
+        blockTime = maxBlockTime;
+
+        // Close batch window.
+        if (batchCount)
+        {
+            TickType_t sinceStart = xTaskGetTickCount() - batchStart;
+            if (sinceStart >= batchWindow || flushRequested)
+                flushBatch();
+            else
+                blockTime = batchWindow - sinceStart;
+        }
+
+        // Rate limited replay of samples stored while offline.
+        if (isConnected() && SampleLog_getStats().pending)
+        {
+            TickType_t sinceReplay = xTaskGetTickCount() - lastReplay;
+            if (sinceReplay >= replayPeriod)
+            {
+                replayStored();
+                lastReplay = xTaskGetTickCount();
+                if (replayPeriod < blockTime)
+                    blockTime = replayPeriod;
+            }
+            else if (replayPeriod - sinceReplay < blockTime)
+            {
+                blockTime = replayPeriod - sinceReplay;
+            }
+        }
+
+        // Periodic latency stats.
+        TickType_t sinceStats = xTaskGetTickCount() - lastStats;
+        if (sinceStats >= statsPeriod)
+        {
+            publishStats();
+            lastStats = xTaskGetTickCount();
+        }
+        else if (statsPeriod - sinceStats < blockTime)
+        {
+            blockTime = statsPeriod - sinceStats;
+        }
+
+        publisherIdle = batchCount == 0;
+    }
+}
+
+static bool flushed()
+{
+    if (!publisherIdle || (isConnected() && activeSession.load()->inFlight))
+        return false;
+
+    for (Producer &p : producers)
+    {
+        if (p.queue.size())
+            return false;
+    }
+
+    return true;
+}
+
+static void forwardToSink(const Sample &sample)
+{
+    MQTT_SampleSink sink = sampleSink;
+    if (!sink)
+        return;
+
+    char valueStr[16];
+    formatValue(sample, valueStr, sizeof(valueStr));
+    sink(sample.topic, valueStr, sample.timestamp);
+}
+
+static bool passesDeadband(const Sample &sample)
+{
+    if (sample.isFloat)
+        return true;
+
+    for (DeadbandTopic &d : deadbands)
+    {
+        if (strcmp(sample.topic, d.topic) == 0)
+            return d.filter.pass(sample.value.fixed, esp_timer_get_time() / 1000);
+    }
+    return true;
+}
+
+static uint32_t nextTopicSeq(const char *topic)
+{
+    for (TopicCounter &c : topicCounters)
+    {
+        if (c.topic[0] == 0)
+            strlcpy(c.topic, topic, sizeof(c.topic));
+        if (strcmp(c.topic, topic) == 0)
+            return ++c.count;
+    }
+    return 0;
+}
+
+static int clientPublish(const char *topic, const char *data, int len, int qos)
 {
-    static char dataStr[128];
-    static char completedTopic[64];
+    Session *session = activeSession;
+    int msgId = esp_mqtt_client_publish(session->client, topic, data, len, qos, false);
+    if (msgId < 0)
+        publishFailedCount++;
+    else if (msgId > 0 && qos > 0)
+        session->inFlight++;
+
+    return msgId;
+}
+
+static void MQTT_publish_impl(const Sample &sample)
+{
+    char dataStr[maxPayloadSize];
+    char completedTopic[maxNamespaceSize + maxTopicSize + 1];
+
+    if (!isConnected())
+    {
+        // Keep it for replay after reconnect.
+        if (SampleLog_append(&sample, sizeof(sample)))
+            storedCount++;
+        else
+            droppedOfflineCount++;
+        return;
+    }
+
+    // Whole sample uses single version of settings.
+    MQTT_SettingsRef current = settings.acquire();
 
-    if (!connected)
+    if (parseBatchMode(current->batchMode) != BatchMode::OFF)
+    {
+        addToBatch(sample);
         return;
+    }
+
+    TraceScope trace(TracePoint::MQTT_PUBLISH);
 
     // Prepare topic.
-    memset(completedTopic, 0, sizeof(completedTopic)); // Zero just in case.
-    memcpy(completedTopic, ns, strlen(ns));            // Prepend namespace.
-    strcat(completedTopic, "/");                       // Append slash.
-    strcat(completedTopic, topic);                     // Append topic.
+    MQTT_formatTopic(completedTopic, sizeof(completedTopic), current->ns, sample.topic);
 
     // Prepare data.
-    memset(dataStr, 0, sizeof(dataStr));                 // Zero just in case.
-    snprintf(dataStr, sizeof(dataStr), formatter, data); // Replace formatter with given data.
+    formatPayload(sample, dataStr, sizeof(dataStr));
 
-    esp_mqtt_client_publish(client, completedTopic, dataStr, 0, qos, false);
+    clientPublish(completedTopic, dataStr, 0, sample.qos);
+    publishedCount++;
     ESP_LOGI(TAG_MQTT, "%s\n", completedTopic);
 }
 
-static void loadFromFlash()
+static bool replayStored()
 {
-    MQTT_resourceTake();
+    char dataStr[maxPayloadSize];
+    char completedTopic[maxNamespaceSize + maxTopicSize + sizeof("/replay")];
 
-    nvs_handle_t nvsHandle;
-    ESP_ERROR_CHECK(nvs_open("mqtt", NVS_READONLY, &nvsHandle));
+    Sample sample;
+    for (uint32_t i = 0; i < replayBatchSize; i++)
+    {
+        if (!isConnected() || !SampleLog_peek(&sample))
+            return false;
 
-    esp_err_t err = nvs_get_str(nvsHandle, "ip", ip, &ipSize);
-    if (err == ESP_OK)
-        ESP_LOGI(TAG_MQTT, "Loaded IP: %s", ip);
-    else
-        ESP_LOGI(TAG_MQTT, "%s", esp_err_to_name(err));
-    ipSize = maxIpSize;
+        // Replayed samples carry their capture time as they arrive late.
+        MQTT_formatTopic(completedTopic, sizeof(completedTopic), MQTT_getSettings()->ns, sample.topic, "replay");
+        formatPayload(sample, dataStr, sizeof(dataStr));
+
+        if (clientPublish(completedTopic, dataStr, 0, sample.qos) < 0)
+            return true; // Try again with next batch.
+
+        SampleLog_consume();
+        replayedCount++;
+    }
+
+    return SampleLog_getStats().pending != 0;
+}
+
+static void addToBatch(const Sample &sample)
+{
+    // Newer reading of the same measurement replaces older one.
+    for (size_t i = 0; i < batchCount; i++)
+    {
+        if (strcmp(batch[i].topic, sample.topic) == 0)
+        {
+            batch[i] = sample;
+            return;
+        }
+    }
 
-    err = nvs_get_str(nvsHandle, "port", port, &portSize);
-    if (err == ESP_OK)
-        ESP_LOGI(TAG_MQTT, "Loaded port: %s", port);
+    if (batchCount == 0)
+        batchStart = xTaskGetTickCount();
+
+    batch[batchCount++] = sample;
+    if (batchCount == maxBatchSize)
+        flushBatch();
+}
+
+static void flushBatch()
+{
+    union
+    {
+        char json[maxBatchPayloadSize];
+        uint8_t cbor[maxBatchPayloadSize];
+    } payload;
+    char completedTopic[maxNamespaceSize + sizeof("/batch")];
+
+    MQTT_SettingsRef current = settings.acquire();
+
+    size_t len = 0;
+    if (parseBatchMode(current->batchMode) == BatchMode::CBOR)
+        len = encodeBatchCBOR(payload.cbor, sizeof(payload.cbor));
     else
-        ESP_LOGI(TAG_MQTT, "%s", esp_err_to_name(err));
-    portSize = maxPortSize;
+        len = encodeBatchJSON(payload.json, sizeof(payload.json));
 
-    err = nvs_get_str(nvsHandle, "usr", username, &usernameSize);
-    if (err == ESP_OK)
-        ESP_LOGI(TAG_MQTT, "Loaded user: %s", username);
+    // Message uses highest QoS requested by any of its samples.
+    uint8_t qos = 0;
+    for (size_t i = 0; i < batchCount; i++)
+    {
+        if (batch[i].qos > qos)
+            qos = batch[i].qos;
+    }
+
+    MQTT_formatTopic(completedTopic, sizeof(completedTopic), current->ns, "batch");
+
+    if (!isConnected() || len == 0 || clientPublish(completedTopic, payload.json, len, qos) < 0)
+    {
+        // Keep samples for replay.
+        for (size_t i = 0; i < batchCount; i++)
+        {
+            if (SampleLog_append(&batch[i], sizeof(batch[i])))
+                storedCount++;
+            else
+                droppedOfflineCount++;
+        }
+    }
     else
-        ESP_LOGI(TAG_MQTT, "%s", esp_err_to_name(err));
-    usernameSize = maxUsernameSize;
+    {
+        batchMessageCount++;
+        publishedCount += batchCount;
+        ESP_LOGI(TAG_MQTT, "%s\n", completedTopic);
+    }
+
+    batchCount = 0;
+}
+
+static void publishStats()
+{
+    static char payload[maxStatsPayloadSize];
+    char completedTopic[maxNamespaceSize + sizeof("/stats")];
+
+    // Window is consumed even when offline so next message covers only its own period.
+    size_t len = Trace_formatWindowJSON(payload, sizeof(payload));
+    if (!isConnected() || len == 0)
+        return;
+
+    MQTT_formatTopic(completedTopic, sizeof(completedTopic), settings.acquire()->ns, "stats");
+    clientPublish(completedTopic, payload, len, 0);
+}
+
+static size_t encodeBatchJSON(char *buf, size_t size)
+{
+    char valueStr[16];
+
+    uint32_t seqs[(size_t)SensorId::COUNT];
+    size_t sensors = batchSequences(seqs);
+
+    // {"ts":<ms of first sample>,"n":<message number>,"<topic>":<value>,...,"seq":{"<sensor>":<seq>,...}}
+    int len = snprintf(buf, size, "{\"ts\":%lld,\"n\":%u", (long long)(batch[0].timestamp / 1000), (unsigned)(batchMessageCount + 1));
+    for (size_t i = 0; i < batchCount && len > 0 && (size_t)len < size; i++)
+    {
+        formatValue(batch[i], valueStr, sizeof(valueStr));
+        len += snprintf(buf + len, size - len, ",\"%s\":%s", batch[i].topic, valueStr);
+    }
+    if (sensors)
+    {
+        const char *separator = ",\"seq\":{";
+        for (size_t s = 1; s < (size_t)SensorId::COUNT && len > 0 && (size_t)len < size; s++)
+        {
+            if (!seqs[s])
+                continue;
+            len += snprintf(buf + len, size - len, "%s\"%s\":%u", separator, Sample_sensorName((SensorId)s), (unsigned)seqs[s]);
+            separator = ",";
+        }
+        if (len > 0 && (size_t)len < size)
+            len += snprintf(buf + len, size - len, "}");
+    }
+    if (len > 0 && (size_t)len < size)
+        len += snprintf(buf + len, size - len, "}");
+
+    if (len <= 0 || (size_t)len >= size)
+        return 0;
+    return len;
+}
+
+static size_t encodeBatchCBOR(uint8_t *buf, size_t size)
+{
+    uint32_t seqs[(size_t)SensorId::COUNT];
+    size_t sensors = batchSequences(seqs);
+
+    // {"ts": <ms of first sample>, "n": <message number>, "<topic>": <value>, ..., "seq": {"<sensor>": <seq>, ...}}
+    CborWriter writer(buf, size);
+    writer.map(batchCount + 2 + (sensors ? 1 : 0));
+    writer.text("ts");
+    writer.integer(batch[0].timestamp / 1000);
+    writer.text("n");
+    writer.integer(batchMessageCount + 1);
+
+    for (size_t i = 0; i < batchCount; i++)
+    {
+        writer.text(batch[i].topic);
+        if (batch[i].isFloat)
+            writer.float32(batch[i].value.f);
+        else if (batch[i].decimals)
+            writer.decimal(batch[i].value.fixed, -batch[i].decimals); // Exact, no float conversion.
+        else
+            writer.integer(batch[i].value.fixed);
+    }
+
+    if (sensors)
+    {
+        writer.text("seq");
+        writer.map(sensors);
+        for (size_t s = 1; s < (size_t)SensorId::COUNT; s++)
+        {
+            if (!seqs[s])
+                continue;
+            writer.text(Sample_sensorName((SensorId)s));
+            writer.integer(seqs[s]);
+        }
+    }
+
+    return writer.ok() ? writer.length() : 0;
+}
+
+static size_t batchSequences(uint32_t seqs[(size_t)SensorId::COUNT])
+{
+    for (size_t s = 0; s < (size_t)SensorId::COUNT; s++)
+        seqs[s] = 0;
+
+    // Sequence numbers start at 1, so 0 marks sensor without sample.
+    for (size_t i = 0; i < batchCount; i++)
+    {
+        size_t s = (size_t)batch[i].sensor;
+        if (batch[i].sensor != SensorId::NONE && batch[i].seq > seqs[s])
+            seqs[s] = batch[i].seq;
+    }
+
+    size_t sensors = 0;
+    for (size_t s = 1; s < (size_t)SensorId::COUNT; s++)
+    {
+        if (seqs[s])
+            sensors++;
+    }
+
+    return sensors;
+}
 
-    err = nvs_get_str(nvsHandle, "pwd", password, &passwordSize);
-    if (err == ESP_OK)
-        ESP_LOGI(TAG_MQTT, "Loaded password: %s", password);
+static BatchMode parseBatchMode(const char *mode)
+{
+    if (strcmp(mode, "json") == 0)
+        return BatchMode::JSON;
+    if (strcmp(mode, "cbor") == 0)
+        return BatchMode::CBOR;
+    return BatchMode::OFF;
+}
+
+static void formatValue(const Sample &sample, char *buf, size_t size)
+{
+    if (sample.isFloat)
+        snprintf(buf, size, "%f", sample.value.f);
     else
-        ESP_LOGI(TAG_MQTT, "%s", esp_err_to_name(err));
-    passwordSize = maxPasswordSize;
+        MQTT_formatFixed(buf, size, sample.value.fixed, sample.decimals);
+}
+
+static void formatPayload(const Sample &sample, char *buf, size_t size)
+{
+    char valueStr[16];
+    formatValue(sample, valueStr, sizeof(valueStr));
+    MQTT_formatPayload(buf, size, valueStr, sample.timestamp, Sample_sensorName(sample.sensor), sample.seq, sample.topicSeq);
+}
+
+static void loadFromFlash()
+{
+    xSemaphoreTake(configWriteSemaphore, portMAX_DELAY);
+
+    nvs_handle_t nvsHandle;
+    ESP_ERROR_CHECK(nvs_open("mqtt", NVS_READWRITE, &nvsHandle));
 
-    err = nvs_get_str(nvsHandle, "ns", ns, &namespaceSize);
-    if (err == ESP_OK)
-        ESP_LOGI(TAG_MQTT, "Loaded namespace: %s", ns);
+    size_t size = sizeof(config);
+    esp_err_t err = nvs_get_blob(nvsHandle, "cfg", &config, &size);
+    if (err == ESP_OK && size == sizeof(config) && config.version == configVersion &&
+        config.size == sizeof(config) && config.crc == configCrc(config))
+    {
+        ESP_LOGI(TAG_MQTT, "Loaded config: %s:%s, user: %s, namespace: %s, batch mode: %s",
+                 config.settings.ip, config.settings.port, config.settings.username,
+                 config.settings.ns, config.settings.batchMode);
+    }
     else
-        ESP_LOGI(TAG_MQTT, "%s", esp_err_to_name(err));
-    namespaceSize = maxNamespaceSize;
+    {
+        if (err == ESP_OK)
+            ESP_LOGW(TAG_MQTT, "Stored config is corrupted");
+        migrateFromStrings(nvsHandle);
+    }
+
+    nvs_close(nvsHandle);
+
+    staged = config.settings;
+    publishSettings(config.settings);
+
+    xSemaphoreGive(configWriteSemaphore);
+}
+
+static void migrateFromStrings(nvs_handle_t nvsHandle)
+{
+    static const char *keys[] = {"ip", "port", "usr", "pwd", "ns", "batch"};
+
+    memset(&config, 0, sizeof(config));
+    MQTT_Settings &s = config.settings;
+    strlcpy(s.batchMode, "off", sizeof(s.batchMode));
+
+    char *fields[] = {s.ip, s.port, s.username, s.password, s.ns, s.batchMode};
+    const size_t sizes[] = {sizeof(s.ip), sizeof(s.port), sizeof(s.username),
+                            sizeof(s.password), sizeof(s.ns), sizeof(s.batchMode)};
 
+    bool found = false;
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+    {
+        size_t size = sizes[i];
+        if (nvs_get_str(nvsHandle, keys[i], fields[i], &size) == ESP_OK)
+        {
+            found = true;
+            nvs_erase_key(nvsHandle, keys[i]); // Committed together with blob.
+        }
+    }
+
+    ESP_LOGI(TAG_MQTT, "%s", found ? "Migrated config from string keys" : "No config stored, using defaults");
+    ESP_ERROR_CHECK(saveConfig(nvsHandle, config));
+}
+
+static bool commitConfig()
+{
+    xSemaphoreTake(configWriteSemaphore, portMAX_DELAY);
+
+    bool reconnect = false;
+    if (memcmp(&staged, &config.settings, sizeof(staged)) != 0)
+    {
+        const MQTT_Settings &old = config.settings;
+        reconnect = strcmp(staged.ip, old.ip) || strcmp(staged.port, old.port) ||
+                    strcmp(staged.username, old.username) || strcmp(staged.password, old.password);
+
+        writeConfig(staged);
+    }
+
+    xSemaphoreGive(configWriteSemaphore);
+
+    return reconnect;
+}
+
+static void writeConfig(const MQTT_Settings &newSettings)
+{
+    Config newConfig = config;
+    newConfig.settings = newSettings;
+
+    nvs_handle_t nvsHandle;
+    ESP_ERROR_CHECK(nvs_open("mqtt", NVS_READWRITE, &nvsHandle));
+    ESP_ERROR_CHECK(saveConfig(nvsHandle, newConfig));
     nvs_close(nvsHandle);
 
-    MQTT_resourceRelease();
+    config = newConfig;
+    publishSettings(config.settings);
+    ESP_LOGI(TAG_MQTT, "Config saved");
+}
+
+static void publishSettings(const MQTT_Settings &newSettings)
+{
+    // All slots are taken only while readers hold old versions, they do so briefly.
+    while (!settings.publish(newSettings))
+        vTaskDelay(1);
+}
+
+static esp_err_t saveConfig(nvs_handle_t nvsHandle, Config &conf)
+{
+    conf.version = configVersion;
+    conf.size = sizeof(conf);
+    conf.crc = configCrc(conf);
+
+    esp_err_t err = nvs_set_blob(nvsHandle, "cfg", &conf, sizeof(conf));
+    if (err != ESP_OK)
+        return err;
+
+    return nvs_commit(nvsHandle);
+}
+
+static uint32_t configCrc(const Config &conf)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)&conf, offsetof(Config, crc));
+}
+
+static void stageField(char *field, size_t size, const char *value)
+{
+    xSemaphoreTake(configWriteSemaphore, portMAX_DELAY);
+    strncpy(field, value, size - 1); // Pads with zeros so unchanged value compares equal.
+    field[size - 1] = 0;
+    xSemaphoreGive(configWriteSemaphore);
 }
 
 static void eventHandler(void *handlerArgs, esp_event_base_t base, int32_t eventId, void *eventData)
 {
+    Session *session = (Session *)handlerArgs;
+    bool active = session == activeSession.load();
+
     switch ((esp_mqtt_event_id_t)eventId)
     {
     case MQTT_EVENT_CONNECTED:
-        ESP_LOGI(TAG_MQTT, "Connected to broker");
+        ESP_LOGI(TAG_MQTT, "Connected to broker%s", active ? "" : " (new session)");
+        session->connected = true;
+        connectCount++;
+
+        // Subscription is per connection, new session subscribes before it takes over.
+        subscribeCommands(*session, settings.acquire()->ns);
+        if (!active)
+            break;
+
         gpio_set_level(_led, 1);
-        connected = true;
+
+        // Start replaying samples stored while offline.
+        if (publisherTaskHandle)
+            xTaskNotifyGive(publisherTaskHandle);
         break;
     case MQTT_EVENT_DISCONNECTED:
-        ESP_LOGI(TAG_MQTT, "Disconnected from broker");
-        gpio_set_level(_led, 0);
-        connected = false;
+        ESP_LOGI(TAG_MQTT, "Disconnected from broker%s", active ? "" : " (new session)");
+        session->connected = false;
+        if (active)
+        {
+            disconnectCount++;
+            gpio_set_level(_led, 0);
+        }
+        break;
+    case MQTT_EVENT_PUBLISHED:
+    {
+        uint32_t inFlight = session->inFlight.load();
+        while (inFlight && !session->inFlight.compare_exchange_weak(inFlight, inFlight - 1))
+        {
+        }
+        break;
+    }
+    case MQTT_EVENT_DATA:
+        if (active)
+            handleCommand(*session, (esp_mqtt_event_handle_t)eventData);
         break;
     default:
         break;
     }
-}
\ No newline at end of file
+}
+
+static void subscribeCommands(Session &session, const char *ns)
+{
+    char topic[maxNamespaceSize + sizeof("/cmd")];
+    MQTT_formatTopic(topic, sizeof(topic), ns, "cmd");
+    esp_mqtt_client_subscribe(session.client, topic, 1);
+}
+
+static void handleCommand(Session &session, esp_mqtt_event_handle_t event)
+{
+    MQTT_CommandHandler handler = commandHandler;
+    char ns[maxNamespaceSize];
+    char topic[maxNamespaceSize + sizeof("/cmd/result")];
+    char reply[maxReplySize];
+
+    // Handler may change settings, don't hold them meanwhile.
+    strlcpy(ns, settings.acquire()->ns, sizeof(ns));
+    MQTT_formatTopic(topic, sizeof(topic), ns, "cmd");
+    if (!handler || event->topic_len != (int)strlen(topic) || strncmp(event->topic, topic, event->topic_len) != 0)
+        return;
+
+    // Commands are short, fragmented message is too long anyway. Reply once, to its first fragment.
+    if (event->current_data_offset != 0)
+        return;
+    if (event->data_len != event->total_data_len || event->data_len > (int)maxCommandSize)
+        strlcpy(reply, "error: command too long", sizeof(reply));
+    else
+        handler(event->data, event->data_len, reply, sizeof(reply));
+
+    ESP_LOGI(TAG_MQTT, "Command: %.*s -> %s", event->data_len, event->data, reply);
+
+    // QoS 0 so reply isn't counted among acknowledges of samples.
+    MQTT_formatTopic(topic, sizeof(topic), ns, "cmd", "result");
+    esp_mqtt_client_publish(session.client, topic, reply, 0, 0, false);
+}
@@ -0,0 +1,215 @@
+#include "../include/sample_log.hpp"
+#include <string.h>
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_log.h"
+
+static const char *TAG_LOG = "SAMPLE_LOG";
+
+static const char *partitionLabel = "samples";
+static const esp_partition_subtype_t partitionSubtype = (esp_partition_subtype_t)0x40;
+
+static const uint32_t recordMagic = 0x53504C33; //!< "SPL3", marks written record. Bumped with payload size or layout so older records are ignored.
+static const uint32_t notConsumed = 0xFFFFFFFF; //!< Erased flash.
+static const uint32_t consumed = 0;             //!< Written over notConsumed without erase.
+
+/**
+ * @brief Record as stored in flash.
+ */
+struct Record
+{
+    uint32_t consumed;                      //!< Cleared in place once record was replayed.
+    uint32_t magic;                         //!< recordMagic for written record.
+    uint32_t seq;                           //!< Monotonic sequence number, used to find head and tail on boot.
+    uint32_t crc;                           //!< CRC32 of seq and payload.
+    uint8_t payload[SAMPLE_LOG_PAYLOAD_SIZE]; //!< User data.
+};
+
+static const uint32_t recordsPerSector = SPI_FLASH_SEC_SIZE / sizeof(Record); //!< Records never span sectors.
+
+static const esp_partition_t *partition;
+static uint32_t slotCount;   //!< Number of record slots in partition.
+static uint32_t head;        //!< Next slot to write.
+static uint32_t tail;        //!< Oldest pending slot.
+static uint32_t pending;     //!< Number of pending records.
+static uint32_t nextSeq = 1; //!< Sequence number of next record.
+static uint32_t overwritten;
+
+// External functions.
+bool SampleLog_init();
+bool SampleLog_append(const void *data, size_t size);
+bool SampleLog_peek(void *data);
+void SampleLog_consume();
+SampleLog_Stats SampleLog_getStats();
+
+// Helper functions.
+/**
+ * @brief Get address of slot in partition.
+ * @param slot Slot index.
+ * @return Address.
+ */
+static size_t slotAddress(uint32_t slot);
+
+/**
+ * @brief Compute CRC of record.
+ * @param r Record.
+ * @return CRC.
+ */
+static uint32_t recordCrc(const Record &r);
+
+/**
+ * @brief Check whether record holds valid data.
+ * @param r Record.
+ * @return True if valid.
+ */
+static bool isValid(const Record &r);
+
+// Function definitions.
+bool SampleLog_init()
+{
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, partitionSubtype, partitionLabel);
+    if (partition == nullptr)
+    {
+        ESP_LOGE(TAG_LOG, "Partition \"%s\" not found, store and forward disabled", partitionLabel);
+        return false;
+    }
+
+    slotCount = (partition->size / SPI_FLASH_SEC_SIZE) * recordsPerSector;
+
+    // Find newest record and oldest pending record.
+    bool any = false, anyPending = false;
+    uint32_t maxSeq = 0, minPendingSeq = 0;
+    Record r;
+    for (uint32_t slot = 0; slot < slotCount; slot++)
+    {
+        if (esp_partition_read(partition, slotAddress(slot), &r, sizeof(r)) != ESP_OK || !isValid(r))
+            continue;
+
+        if (!any || r.seq > maxSeq)
+        {
+            maxSeq = r.seq;
+            head = (slot + 1) % slotCount;
+            any = true;
+        }
+
+        if (r.consumed == notConsumed)
+        {
+            if (!anyPending || r.seq < minPendingSeq)
+            {
+                minPendingSeq = r.seq;
+                tail = slot;
+                anyPending = true;
+            }
+            pending++;
+        }
+    }
+
+    if (any)
+        nextSeq = maxSeq + 1;
+    if (!anyPending)
+        tail = head;
+
+    ESP_LOGI(TAG_LOG, "%u of %u records pending", (unsigned)pending, (unsigned)slotCount);
+    return true;
+}
+
+bool SampleLog_append(const void *data, size_t size)
+{
+    if (partition == nullptr || size > SAMPLE_LOG_PAYLOAD_SIZE)
+        return false;
+
+    // Entering new sector, erase it first.
+    if (head % recordsPerSector == 0)
+    {
+        // Log is full, drop pending records that are still in this sector.
+        if (pending && tail / recordsPerSector == head / recordsPerSector)
+        {
+            uint32_t lost = recordsPerSector - tail % recordsPerSector;
+            if (lost > pending)
+                lost = pending;
+
+            pending -= lost;
+            overwritten += lost;
+            tail = (head + recordsPerSector) % slotCount;
+            if (pending == 0)
+                tail = head;
+        }
+
+        if (esp_partition_erase_range(partition, slotAddress(head), SPI_FLASH_SEC_SIZE) != ESP_OK)
+            return false;
+    }
+
+    Record r;
+    memset(&r, 0xFF, sizeof(r));
+    r.consumed = notConsumed;
+    r.magic = recordMagic;
+    r.seq = nextSeq;
+    memcpy(r.payload, data, size);
+    r.crc = recordCrc(r);
+
+    if (esp_partition_write(partition, slotAddress(head), &r, sizeof(r)) != ESP_OK)
+        return false;
+
+    if (pending == 0)
+        tail = head;
+
+    nextSeq++;
+    pending++;
+    head = (head + 1) % slotCount;
+
+    return true;
+}
+
+bool SampleLog_peek(void *data)
+{
+    Record r;
+    while (pending)
+    {
+        if (esp_partition_read(partition, slotAddress(tail), &r, sizeof(r)) == ESP_OK && isValid(r))
+        {
+            memcpy(data, r.payload, sizeof(r.payload));
+            return true;
+        }
+
+        // Skip corrupted record.
+        SampleLog_consume();
+    }
+
+    return false;
+}
+
+void SampleLog_consume()
+{
+    if (pending == 0)
+        return;
+
+    esp_partition_write(partition, slotAddress(tail), &consumed, sizeof(consumed));
+
+    tail = (tail + 1) % slotCount;
+    pending--;
+}
+
+SampleLog_Stats SampleLog_getStats()
+{
+    SampleLog_Stats stats;
+    stats.pending = pending;
+    stats.capacity = slotCount;
+    stats.overwritten = overwritten;
+    return stats;
+}
+
+static size_t slotAddress(uint32_t slot)
+{
+    return (slot / recordsPerSector) * SPI_FLASH_SEC_SIZE + (slot % recordsPerSector) * sizeof(Record);
+}
+
+static uint32_t recordCrc(const Record &r)
+{
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)&r.seq, sizeof(r.seq));
+    return esp_rom_crc32_le(crc, r.payload, sizeof(r.payload));
+}
+
+static bool isValid(const Record &r)
+{
+    return r.magic == recordMagic && r.crc == recordCrc(r);
+}
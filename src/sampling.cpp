@@ -0,0 +1,275 @@
+#include "../include/sampling.hpp"
+#include "../include/config.hpp"
+#include "../include/mqtt.hpp"
+#include "../include/form_parser.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "nvs.h"
+#include "esp_rom_crc.h"
+#include "esp_log.h"
+
+static const char *TAG_SAMPLING = "SAMPLING";
+
+static const uint16_t configVersion = 1; //!< Bump when layout of Config changes.
+
+static const uint32_t minIntervalMs = PRESSURE_SAMPLE_PERIOD_MS; //!< At least single pressure sample per publish.
+static const uint32_t maxIntervalMs = 24 * 60 * 60 * 1000;
+
+static const size_t maxCommandKeySize = 8;    //!< Longest key is "interval".
+static const size_t maxCommandValueSize = 15; //!< Longest value is "ultra_high_res".
+typedef FormParser<maxCommandKeySize, maxCommandValueSize> CommandParser;
+
+/**
+ * @brief Sampling config, stored in flash as single blob.
+ */
+struct Config
+{
+    uint16_t version;           //!< Layout version.
+    uint16_t size;              //!< Size of blob.
+    Sampling_Settings settings; //!< Settings.
+    uint32_t crc;               //!< CRC32 of all previous bytes.
+};
+
+/**
+ * @brief Command being parsed.
+ */
+struct Command
+{
+    Sampling_Settings settings; //!< Current settings with received fields applied.
+    char batchMode[sizeof(MQTT_Settings::batchMode)]; //!< Received batch mode, empty if not changed.
+    const char *error;          //!< First invalid field, nullptr if all are valid.
+};
+
+static Config config;                         //!< Cached copy of flash, accessed by writer only.
+static Snapshots<Sampling_Settings> settings; //!< Settings in use, read without locking.
+
+static const char *modeNames[] = {"low_power", "standard", "high_res", "ultra_high_res"}; //!< Indexed by BMP180::MeasurementType.
+
+// External functions.
+void Sampling_init();
+Sampling_SettingsRef Sampling_getSettings();
+void Sampling_handleCommand(const char *payload, size_t len, char *reply, size_t replySize);
+
+// Helper functions.
+/**
+ * @brief Store field of command.
+ * @param key Key.
+ * @param value Value.
+ * @param ctx Command.
+ */
+static void onCommandField(const char *key, const char *value, void *ctx);
+
+/**
+ * @brief Parse unsigned decimal number.
+ * @param str String.
+ * @param value Output.
+ * @return False if string is not a number.
+ */
+static bool parseUnsigned(const char *str, uint32_t &value);
+
+/**
+ * @brief Make settings current for readers.
+ * @param newSettings Settings.
+ */
+static void publishSettings(const Sampling_Settings &newSettings);
+
+/**
+ * @brief Write config to flash with single commit.
+ * @param conf Config to write, its checksum is updated.
+ * @return ESP_OK on success.
+ */
+static esp_err_t saveConfig(Config &conf);
+
+/**
+ * @brief Checksum of config.
+ * @param conf Config.
+ * @return CRC32 of everything before crc field.
+ */
+static uint32_t configCrc(const Config &conf);
+
+// Function definitions.
+void Sampling_init()
+{
+    nvs_handle_t nvsHandle;
+    esp_err_t err = nvs_open("sampling", NVS_READONLY, &nvsHandle);
+
+    size_t size = sizeof(config);
+    if (err == ESP_OK)
+    {
+        err = nvs_get_blob(nvsHandle, "cfg", &config, &size);
+        nvs_close(nvsHandle);
+    }
+
+    if (err == ESP_OK && size == sizeof(config) && config.version == configVersion &&
+        config.size == sizeof(config) && config.crc == configCrc(config))
+    {
+        ESP_LOGI(TAG_SAMPLING, "Loaded config: interval %u ms, mode %s, QoS %u",
+                 (unsigned)config.settings.intervalMs, modeNames[(size_t)config.settings.pressureMode],
+                 config.settings.qos);
+    }
+    else
+    {
+        if (err == ESP_OK)
+            ESP_LOGW(TAG_SAMPLING, "Stored config is corrupted");
+
+        memset(&config, 0, sizeof(config));
+        config.settings.intervalMs = MEASUREMENT_PERIOD_MS;
+#if DEEP_SLEEP_MODE
+        config.settings.pressureMode = BMP180::MeasurementType::ULTRA_HIGH_RES; // Single sample per wake, no filtering.
+#else
+        config.settings.pressureMode = PRESSURE_SAMPLE_MODE;
+#endif
+        config.settings.qos = SAMPLE_QOS;
+    }
+
+    publishSettings(config.settings);
+}
+
+Sampling_SettingsRef Sampling_getSettings()
+{
+    return settings.acquire();
+}
+
+void Sampling_handleCommand(const char *payload, size_t len, char *reply, size_t replySize)
+{
+    Command command;
+    command.settings = config.settings;
+    command.batchMode[0] = 0;
+    command.error = nullptr;
+
+    CommandParser parser(onCommandField, &command);
+    parser.feed(payload, len);
+    CommandParser::Status status = parser.finish();
+
+    if (status != CommandParser::Status::OK)
+    {
+        snprintf(reply, replySize, "error: %s", status == CommandParser::Status::TOO_LONG ? "field too long" : "malformed command");
+        return;
+    }
+    if (command.error)
+    {
+        snprintf(reply, replySize, "error: invalid %s", command.error);
+        return;
+    }
+
+    // Nothing is applied until whole command was validated.
+    if (memcmp(&command.settings, &config.settings, sizeof(command.settings)) != 0)
+    {
+        Config newConfig = config;
+        newConfig.settings = command.settings;
+        if (saveConfig(newConfig) != ESP_OK)
+        {
+            snprintf(reply, replySize, "error: flash write failed");
+            return;
+        }
+
+        config = newConfig;
+        publishSettings(config.settings);
+        ESP_LOGI(TAG_SAMPLING, "Config saved: interval %u ms, mode %s, QoS %u",
+                 (unsigned)config.settings.intervalMs, modeNames[(size_t)config.settings.pressureMode],
+                 config.settings.qos);
+    }
+
+    // Runs in MQTT client task, so never through MQTT_reInit(), which may replace this very client.
+    if (command.batchMode[0])
+        MQTT_setBatchMode(command.batchMode);
+
+    snprintf(reply, replySize, "ok");
+}
+
+static void onCommandField(const char *key, const char *value, void *ctx)
+{
+    Command *command = (Command *)ctx;
+    Sampling_Settings &s = command->settings;
+    uint32_t number;
+
+    if (command->error)
+        return;
+
+    if (strcmp(key, "interval") == 0)
+    {
+        if (parseUnsigned(value, number) && number >= minIntervalMs && number <= maxIntervalMs)
+            s.intervalMs = number;
+        else
+            command->error = "interval";
+    }
+    else if (strcmp(key, "mode") == 0)
+    {
+        command->error = "mode";
+        for (size_t i = 0; i < sizeof(modeNames) / sizeof(modeNames[0]); i++)
+        {
+            if (strcmp(value, modeNames[i]) == 0)
+            {
+                s.pressureMode = (BMP180::MeasurementType)i;
+                command->error = nullptr;
+            }
+        }
+    }
+    else if (strcmp(key, "qos") == 0)
+    {
+        if (parseUnsigned(value, number) && number <= 2)
+            s.qos = number;
+        else
+            command->error = "qos";
+    }
+    else if (strcmp(key, "batch") == 0)
+    {
+        if (strcmp(value, "off") == 0 || strcmp(value, "json") == 0 || strcmp(value, "cbor") == 0)
+            strlcpy(command->batchMode, value, sizeof(command->batchMode));
+        else
+            command->error = "batch";
+    }
+    else
+    {
+        command->error = "field";
+    }
+}
+
+static bool parseUnsigned(const char *str, uint32_t &value)
+{
+    if (*str < '0' || *str > '9')
+        return false;
+
+    char *end;
+    unsigned long parsed = strtoul(str, &end, 10);
+    if (*end || parsed > UINT32_MAX)
+        return false;
+
+    value = parsed;
+    return true;
+}
+
+static void publishSettings(const Sampling_Settings &newSettings)
+{
+    // All slots are taken only while readers hold old versions, they do so briefly.
+    while (!settings.publish(newSettings))
+        vTaskDelay(1);
+}
+
+static esp_err_t saveConfig(Config &conf)
+{
+    conf.version = configVersion;
+    conf.size = sizeof(conf);
+    conf.crc = configCrc(conf);
+
+    nvs_handle_t nvsHandle;
+    esp_err_t err = nvs_open("sampling", NVS_READWRITE, &nvsHandle);
+    if (err != ESP_OK)
+        return err;
+
+    err = nvs_set_blob(nvsHandle, "cfg", &conf, sizeof(conf));
+    if (err == ESP_OK)
+        err = nvs_commit(nvsHandle);
+
+    nvs_close(nvsHandle);
+    return err;
+}
+
+static uint32_t configCrc(const Config &conf)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)&conf, offsetof(Config, crc));
+}
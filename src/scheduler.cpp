@@ -0,0 +1,188 @@
+#include "../include/scheduler.hpp"
+#include "../include/trace.hpp"
+#include <atomic>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG_SCHEDULER = "SCHEDULER";
+
+static const size_t maxJobs = 8;
+static const uint32_t workerStackSize = 4096;
+static const UBaseType_t workerPriority = tskIDLE_PRIORITY + 2; //!< Above MQTT publisher so network work doesn't delay reads.
+
+/**
+ * @brief Run time state of job.
+ */
+struct JobState
+{
+    int64_t release; //!< Next release in esp_timer µs, accessed by worker only.
+    std::atomic<uint32_t> periodMs{0};
+    std::atomic<uint32_t> runs{0};
+    std::atomic<uint32_t> deadlineMisses{0};
+    std::atomic<uint32_t> skipped{0};
+    std::atomic<uint32_t> maxJitterUs{0};
+    std::atomic<uint32_t> maxRunUs{0};
+};
+
+static const Scheduler_Job *jobTable;
+static size_t jobCount;
+static JobState states[maxJobs];
+
+static TaskHandle_t workerTask;
+static esp_timer_handle_t wakeTimer;
+
+// External functions.
+bool Scheduler_start(const Scheduler_Job *jobs, size_t count);
+bool Scheduler_setPeriod(size_t index, uint32_t periodMs);
+bool Scheduler_getStats(size_t index, Scheduler_JobStats &stats);
+
+// Helper functions.
+/**
+ * @brief Run jobs at their releases.
+ * @param arg Unused.
+ */
+static void workerLoop(void *arg);
+
+/**
+ * @brief Sleep until given time.
+ * Other notifications of worker (i.e. from sensor drivers) may wake it earlier, so it sleeps again then.
+ * @param time Time in esp_timer µs.
+ * @return Current time.
+ */
+static int64_t sleepUntil(int64_t time);
+
+/**
+ * @brief Wake timer callback.
+ * @param arg Unused.
+ */
+static void wake(void *arg);
+
+/**
+ * @brief Raise atomic max.
+ * @param max Max to update.
+ * @param value New value.
+ */
+static void updateMax(std::atomic<uint32_t> &max, uint32_t value);
+
+// Function definitions.
+bool Scheduler_start(const Scheduler_Job *jobs, size_t count)
+{
+    if (workerTask || count > maxJobs)
+        return false;
+
+    jobTable = jobs;
+    jobCount = count;
+    for (size_t i = 0; i < count; i++)
+        states[i].periodMs = jobs[i].periodMs;
+
+    const esp_timer_create_args_t timerArgs = {
+        .callback = wake,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "scheduler"};
+    ESP_ERROR_CHECK(esp_timer_create(&timerArgs, &wakeTimer));
+
+    xTaskCreate(workerLoop, "scheduler", workerStackSize, NULL, workerPriority, &workerTask);
+    return true;
+}
+
+bool Scheduler_setPeriod(size_t index, uint32_t periodMs)
+{
+    if (index >= jobCount || periodMs == 0)
+        return false;
+
+    states[index].periodMs = periodMs;
+    return true;
+}
+
+bool Scheduler_getStats(size_t index, Scheduler_JobStats &stats)
+{
+    if (index >= jobCount)
+        return false;
+
+    const JobState &state = states[index];
+    stats.name = jobTable[index].name;
+    stats.runs = state.runs;
+    stats.deadlineMisses = state.deadlineMisses;
+    stats.skipped = state.skipped;
+    stats.maxJitterUs = state.maxJitterUs;
+    stats.maxRunUs = state.maxRunUs;
+    return true;
+}
+
+static void workerLoop(void *arg)
+{
+    int64_t start = esp_timer_get_time();
+    for (size_t i = 0; i < jobCount; i++)
+        states[i].release = start + (int64_t)jobTable[i].phaseMs * 1000;
+
+    while (true)
+    {
+        // Earliest release first, table order breaks ties.
+        size_t next = 0;
+        for (size_t i = 1; i < jobCount; i++)
+        {
+            if (states[i].release < states[next].release)
+                next = i;
+        }
+
+        const Scheduler_Job &job = jobTable[next];
+        JobState &state = states[next];
+
+        int64_t begin = sleepUntil(state.release);
+        uint32_t jitter = begin - state.release;
+        job.run(job.ctx);
+        int64_t end = esp_timer_get_time();
+
+        Trace_record(TracePoint::JOB_JITTER, jitter);
+        updateMax(state.maxJitterUs, jitter);
+        updateMax(state.maxRunUs, end - begin);
+        state.runs++;
+
+        if (end - state.release > (int64_t)job.deadlineMs * 1000)
+        {
+            state.deadlineMisses++;
+            ESP_LOGW(TAG_SCHEDULER, "%s missed deadline by %lld us", job.name,
+                     (long long)(end - state.release - (int64_t)job.deadlineMs * 1000));
+        }
+
+        // Next release follows previous one, not end of this run, so period doesn't drift.
+        int64_t period = (int64_t)state.periodMs * 1000;
+        state.release += period;
+        if (state.release < end)
+        {
+            // Release at the very end of run is still on time.
+            uint32_t missed = (end - state.release - 1) / period + 1;
+            state.release += missed * period;
+            state.skipped += missed;
+        }
+    }
+}
+
+static int64_t sleepUntil(int64_t time)
+{
+    int64_t now;
+    while ((now = esp_timer_get_time()) < time)
+    {
+        esp_timer_start_once(wakeTimer, time - now);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        esp_timer_stop(wakeTimer); // Not running if it woke us, that's fine.
+    }
+
+    return now;
+}
+
+static void wake(void *arg)
+{
+    xTaskNotifyGive(workerTask);
+}
+
+static void updateMax(std::atomic<uint32_t> &max, uint32_t value)
+{
+    uint32_t current = max.load();
+    while (value > current && !max.compare_exchange_weak(current, value))
+    {
+    }
+}
@@ -0,0 +1,58 @@
+#include "../include/time_sync.hpp"
+#include "../include/config.hpp"
+#include <sys/time.h>
+#include "esp_sntp.h"
+#include "esp_log.h"
+
+static const char *TAG_TIME = "TIME";
+
+static const time_t minValidTime = 1609459200; //!< 2021-01-01, earlier clock was never set.
+static bool started = false;
+
+// External functions.
+void TimeSync_start();
+bool TimeSync_isValid();
+int64_t TimeSync_nowUs();
+
+// Helper functions.
+/**
+ * @brief SNTP sync notification.
+ * @param tv Time set.
+ */
+static void onSync(struct timeval *tv);
+
+// Function definitions.
+void TimeSync_start()
+{
+    if (started)
+        return;
+    started = true;
+
+    ESP_LOGI(TAG_TIME, "Starting SNTP with %s", SNTP_SERVER);
+    sntp_setoperatingmode(SNTP_OPMODE_POLL);
+    sntp_setservername(0, SNTP_SERVER);
+    sntp_set_time_sync_notification_cb(onSync);
+    sntp_init();
+}
+
+bool TimeSync_isValid()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec >= minValidTime;
+}
+
+int64_t TimeSync_nowUs()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    if (tv.tv_sec < minValidTime)
+        return 0;
+
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void onSync(struct timeval *tv)
+{
+    ESP_LOGI(TAG_TIME, "Time synced: %lld", (long long)tv->tv_sec);
+}
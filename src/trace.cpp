@@ -0,0 +1,95 @@
+#include "../include/trace.hpp"
+#include "../include/histogram.hpp"
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+
+static const size_t pointCount = (size_t)TracePoint::COUNT;
+
+static const char *pointNames[pointCount] = {
+    "bmp180_read",
+    "dht11_read",
+    "mqtt_publish",
+    "http_get",
+    "http_post",
+    "wifi_connect",
+    "job_jitter"};
+
+static LatencyHistogram histograms[pointCount][portNUM_PROCESSORS]; //!< Every core records to its own histograms.
+
+// External functions.
+void Trace_record(TracePoint point, uint32_t us);
+const char *Trace_name(TracePoint point);
+Trace_Summary Trace_getSummary(TracePoint point);
+size_t Trace_formatWindowJSON(char *buf, size_t size);
+
+// Helper functions.
+/**
+ * @brief Merge histograms of all cores.
+ * @param point Trace point.
+ * @param out Merged snapshot.
+ * @param takeMax Whether to take and reset window max of each core instead of max since boot.
+ */
+static void mergedSnapshot(TracePoint point, LatencyHistogram::Snapshot &out, bool takeMax);
+
+// Function definitions.
+void Trace_record(TracePoint point, uint32_t us)
+{
+    histograms[(size_t)point][xPortGetCoreID()].record(us);
+}
+
+const char *Trace_name(TracePoint point)
+{
+    return pointNames[(size_t)point];
+}
+
+Trace_Summary Trace_getSummary(TracePoint point)
+{
+    LatencyHistogram::Snapshot snapshot;
+    mergedSnapshot(point, snapshot, false);
+
+    Trace_Summary summary;
+    summary.count = snapshot.count();
+    summary.p50 = snapshot.percentile(500);
+    summary.p99 = snapshot.percentile(990);
+    summary.max = snapshot.max;
+    summary.sum = snapshot.sum;
+    return summary;
+}
+
+size_t Trace_formatWindowJSON(char *buf, size_t size)
+{
+    static LatencyHistogram::Snapshot previous[pointCount];
+
+    int len = snprintf(buf, size, "{");
+    for (size_t i = 0; i < pointCount && len > 0 && (size_t)len < size; i++)
+    {
+        LatencyHistogram::Snapshot current;
+        mergedSnapshot((TracePoint)i, current, true);
+
+        LatencyHistogram::Snapshot window = current;
+        window.subtract(previous[i]);
+        previous[i] = current;
+
+        len += snprintf(buf + len, size - len, "%s\"%s\":{\"n\":%u,\"p50\":%u,\"p99\":%u,\"max\":%u}",
+                        i ? "," : "", pointNames[i], (unsigned)window.count(),
+                        (unsigned)window.percentile(500), (unsigned)window.percentile(990), (unsigned)window.max);
+    }
+    if (len > 0 && (size_t)len < size)
+        len += snprintf(buf + len, size - len, "}");
+
+    if (len <= 0 || (size_t)len >= size)
+        return 0;
+    return len;
+}
+
+static void mergedSnapshot(TracePoint point, LatencyHistogram::Snapshot &out, bool takeMax)
+{
+    for (LatencyHistogram &h : histograms[(size_t)point])
+    {
+        LatencyHistogram::Snapshot core;
+        h.snapshot(core);
+        if (takeMax)
+            core.max = h.takeMax();
+        out.add(core);
+    }
+}
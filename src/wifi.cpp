@@ -1,19 +1,71 @@
 #include "../include/wifi.hpp"
 #include <string.h>
+#include <atomic>
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
 #include "esp_wifi.h"
 #include "esp_smartconfig.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "nvs.h"
+#include "../include/trace.hpp"
+#include "../include/time_sync.hpp"
 
 static const char *TAG_WIFI = "WIFI";
 static const char *TAG_SC = "SC";
 
+ESP_EVENT_DEFINE_BASE(WIFI_RECONNECT_EVENT); //!< Expiry of reconnect timer, handled in event loop like the rest of connection state.
+
 static gpio_num_t _smartConfigLED;
 static gpio_num_t _WiFiLed;
+static int64_t connectStartedAt = 0; //!< esp_timer time of connect request or disconnect, 0 when connected.
+
+/**
+ * @brief Parameters of last successful connection.
+ * Kept in RTC memory and NVS so reconnect skips scan and DHCP.
+ */
+struct FastConnectCache
+{
+    uint32_t magic;           //!< fastConnectMagic if cache is valid.
+    uint8_t bssid[6];         //!< AP's MAC.
+    uint8_t channel;          //!< AP's primary channel.
+    esp_netif_ip_info_t ip;   //!< IP, netmask and gateway leased by DHCP.
+    esp_netif_dns_info_t dns; //!< Main DNS server.
+};
+
+static const uint32_t fastConnectMagic = 0x46435631; // "FCV1"
+
+static const char *fastConnectNvsNamespace = "wifi_fast";
+static const char *fastConnectNvsKey = "cache";
+
+static const uint32_t backoffBaseMs = 500;  //!< Delay after first failed full connect.
+static const uint32_t backoffMaxMs = 60000; //!< Delay cap, doubling stops here.
+
+RTC_DATA_ATTR static FastConnectCache fastConnectCache;
+static esp_netif_t *staNetif;
+static esp_timer_handle_t reconnectTimer;
+// Connection state, accessed from event loop task only (and by WiFi_init() before first connect).
+static wifi_config_t networkConfig;     //!< Config of current network without cached parameters.
+static bool fastConnectPending = false; //!< Current connection attempt uses cached parameters.
+static bool associated = false;         //!< Associated with AP, disconnect request will cause disconnect event.
+static bool ignoreDisconnect = false;   //!< Disconnect event was caused by connectToNetwork().
+static bool hasIP = false;
+static uint32_t fullAttempts = 0;       //!< Full connects since last connection, drives backoff.
+
+static std::atomic<uint32_t> connectCount{0};
+static std::atomic<uint32_t> fastConnectCount{0};
+static std::atomic<uint32_t> fastConnectFailCount{0};
+static std::atomic<uint32_t> disconnectCount{0};
+static std::atomic<uint32_t> fullAttemptCount{0};
+static std::atomic<uint32_t> bootToConnectUs{0};
+static std::atomic<uint32_t> lastConnectUs{0};
+static std::atomic<uint32_t> maxConnectUs{0};
 
 // External functions.
 void WiFi_init(gpio_num_t smartConfigBtnPin, gpio_num_t smartConfigLED, gpio_num_t WiFiLed);
+WiFi_Stats WiFi_getStats();
 
 // Helper functions.
 /**
@@ -57,6 +109,46 @@ static void stopSmartConfig();
  */
 static void connectToNetwork(wifi_config_t *conf);
 
+/**
+ * @brief Start single connection attempt to networkConfig.
+ * @param allowFast Whether fast connect cache may be used.
+ */
+static void startAttempt(bool allowFast);
+
+/**
+ * @brief Start next full connect after exponential backoff with jitter.
+ */
+static void scheduleReconnect();
+
+/**
+ * @brief Reconnect timer callback, hands expiry over to event loop.
+ * @param arg Unused.
+ */
+static void reconnectTimerCallback(void *arg);
+
+/**
+ * @brief Record time of finished connect.
+ */
+static void recordConnectTime();
+
+/**
+ * @brief Store parameters of current connection in fast connect cache and in NVS if they changed.
+ * @param ipInfo IP info from got IP event.
+ */
+static void saveFastConnect(const esp_netif_ip_info_t *ipInfo);
+
+/**
+ * @brief Load fast connect cache from NVS if RTC memory doesn't hold it.
+ */
+static void loadFastConnect();
+
+/**
+ * @brief Apply fast connect cache to config and switch to static IP.
+ * @param conf Config to apply cached AP to.
+ * @return False if cache is not valid.
+ */
+static bool applyFastConnect(wifi_config_t *conf);
+
 // Function definitions.
 void WiFi_init(gpio_num_t smartConfigBtnPin, gpio_num_t smartConfigLED, gpio_num_t WiFiLed)
 {
@@ -64,17 +156,27 @@ void WiFi_init(gpio_num_t smartConfigBtnPin, gpio_num_t smartConfigLED, gpio_num
 
     ESP_ERROR_CHECK(esp_netif_init()); // Initialize TCP/IP stack.
 
-    esp_netif_t *sta_netif = esp_netif_create_default_wifi_sta(); // Create wifi station.
-    assert(sta_netif);                                            // Check if wifi STA was initialized (no null pointer).
+    staNetif = esp_netif_create_default_wifi_sta(); // Create wifi station.
+    assert(staNetif);                               // Check if wifi STA was initialized (no null pointer).
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     cfg.nvs_enable = true;
 
     ESP_ERROR_CHECK(esp_wifi_init(&cfg)); // Allocate stuff for WiFi and start WiFi task.
 
+    const esp_timer_create_args_t timerArgs = {
+        .callback = reconnectTimerCallback,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "wifi_reconnect"};
+    ESP_ERROR_CHECK(esp_timer_create(&timerArgs, &reconnectTimer));
+
+    loadFastConnect();
+
     ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &networkEventHandler, NULL));
     ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &networkEventHandler, NULL));
     ESP_ERROR_CHECK(esp_event_handler_register(SC_EVENT, ESP_EVENT_ANY_ID, &networkEventHandler, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(WIFI_RECONNECT_EVENT, ESP_EVENT_ANY_ID, &networkEventHandler, NULL));
 
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
     ESP_ERROR_CHECK(esp_wifi_start());
@@ -91,18 +193,90 @@ void WiFi_init(gpio_num_t smartConfigBtnPin, gpio_num_t smartConfigLED, gpio_num
     }
 }
 
+WiFi_Stats WiFi_getStats()
+{
+    WiFi_Stats stats;
+    stats.connects = connectCount;
+    stats.fastConnects = fastConnectCount;
+    stats.fastConnectFailures = fastConnectFailCount;
+    stats.disconnects = disconnectCount;
+    stats.fullAttempts = fullAttemptCount;
+    stats.bootToConnectUs = bootToConnectUs;
+    stats.lastConnectUs = lastConnectUs;
+    stats.maxConnectUs = maxConnectUs;
+
+    wifi_ap_record_t ap;
+    stats.rssi = esp_wifi_sta_get_ap_info(&ap) == ESP_OK ? ap.rssi : 0;
+    return stats;
+}
+
 static void networkEventHandler(void *arg, esp_event_base_t eventBase,
                                 int32_t eventId, void *eventData)
 {
-    if (eventBase == WIFI_EVENT && eventId == WIFI_EVENT_STA_DISCONNECTED)
+    if (eventBase == WIFI_EVENT && eventId == WIFI_EVENT_STA_CONNECTED)
+    {
+        associated = true;
+    }
+    else if (eventBase == WIFI_EVENT && eventId == WIFI_EVENT_STA_DISCONNECTED)
     {
+        associated = false;
+        if (ignoreDisconnect)
+        {
+            ignoreDisconnect = false;
+            return;
+        }
+
         ESP_LOGI(TAG_WIFI, "Disconnected from network");
         gpio_set_level(_WiFiLed, 0);
-        ESP_ERROR_CHECK(esp_wifi_connect());
+        if (connectStartedAt == 0)
+            connectStartedAt = esp_timer_get_time();
+
+        if (hasIP)
+        {
+            // Lost connection, same AP is most likely still there.
+            hasIP = false;
+            disconnectCount++;
+            fullAttempts = 0;
+            startAttempt(true);
+        }
+        else if (fastConnectPending)
+        {
+            // Stale cache, scan right away.
+            fastConnectFailCount++;
+            startAttempt(false);
+        }
+        else
+        {
+            scheduleReconnect();
+        }
     }
     else if (eventBase == IP_EVENT && eventId == IP_EVENT_STA_GOT_IP)
     {
-        ESP_LOGI(TAG_WIFI, "Connected to network");
+        ip_event_got_ip_t *event = (ip_event_got_ip_t *)eventData;
+        if (hasIP)
+        {
+            // DHCP client restarted by fast connect got its lease, possibly a new address.
+            ESP_LOGI(TAG_WIFI, "Lease %s", event->ip_changed ? "changed address" : "renewed");
+            saveFastConnect(&event->ip_info);
+            return;
+        }
+
+        ESP_LOGI(TAG_WIFI, "Connected to network%s", fastConnectPending ? " (fast)" : "");
+        hasIP = true;
+        fullAttempts = 0;
+        connectCount++;
+        if (fastConnectPending)
+        {
+            // Cached address is used right away, DHCP client renews it or replaces it if the lease is gone.
+            fastConnectCount++;
+            esp_netif_dhcpc_start(staNetif);
+        }
+        fastConnectPending = false;
+
+        saveFastConnect(&event->ip_info);
+        recordConnectTime();
+        TimeSync_start();
+
         gpio_set_level(_WiFiLed, 1);
         gpio_set_level(_smartConfigLED, 0);
     }
@@ -119,6 +293,12 @@ static void networkEventHandler(void *arg, esp_event_base_t eventBase,
     {
         stopSmartConfig();
     }
+    else if (eventBase == WIFI_RECONNECT_EVENT)
+    {
+        // Expiry posted before connectToNetwork() stopped the timer or before connection came up is stale.
+        if (!hasIP)
+            startAttempt(false);
+    }
 }
 
 static void initGPIO(gpio_num_t smartConfigBtnPin, gpio_num_t smartConfigLED, gpio_num_t WiFiLed)
@@ -182,17 +362,155 @@ static void stopSmartConfig()
 static void connectToNetwork(wifi_config_t *conf)
 {
     ESP_LOGI(TAG_WIFI, "Connecting to network");
+    esp_timer_stop(reconnectTimer); // Might not be running, that's fine.
+    connectStartedAt = esp_timer_get_time();
+    fullAttempts = 0;
+    hasIP = false;
+
+    ignoreDisconnect = associated;
     ESP_ERROR_CHECK(esp_wifi_disconnect());
 
     // Use config from flash instead.
-    wifi_config_t confAlt;
     if (conf == nullptr)
     {
         ESP_LOGI(TAG_WIFI, "Using config from flash");
-        ESP_ERROR_CHECK(esp_wifi_get_config(WIFI_IF_STA, &confAlt));
-        conf = &confAlt;
+        ESP_ERROR_CHECK(esp_wifi_get_config(WIFI_IF_STA, &networkConfig));
     }
+    else
+    {
+        // Store new credentials, cached AP belongs to previous network.
+        networkConfig = *conf;
+        ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &networkConfig));
+        fastConnectCache.magic = 0;
+    }
+
+    startAttempt(true);
+}
+
+static void startAttempt(bool allowFast)
+{
+    wifi_config_t conf = networkConfig;
+    fastConnectPending = allowFast && applyFastConnect(&conf);
+    if (!fastConnectPending)
+    {
+        esp_netif_dhcpc_start(staNetif); // Fails if already running, that's fine.
+        fullAttempts++;
+        fullAttemptCount++;
+    }
+
+    // Per attempt config (cached AP) doesn't belong to flash.
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &conf));
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_FLASH));
+
+    esp_err_t err = esp_wifi_connect();
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_WIFI, "Failed to connect: %s", esp_err_to_name(err));
+        scheduleReconnect();
+    }
+}
+
+static void scheduleReconnect()
+{
+    // Doubling delay spreads retries of many nodes after AP outage, jitter keeps them from synchronizing.
+    uint32_t shift = fullAttempts > 0 ? fullAttempts - 1 : 0;
+    uint32_t delayMs = shift < 16 ? backoffBaseMs << shift : backoffMaxMs;
+    if (delayMs > backoffMaxMs)
+        delayMs = backoffMaxMs;
+    delayMs += esp_random() % (delayMs / 2 + 1);
+
+    ESP_LOGI(TAG_WIFI, "Reconnecting in %u ms", (unsigned)delayMs);
+    esp_timer_stop(reconnectTimer);
+    esp_timer_start_once(reconnectTimer, (uint64_t)delayMs * 1000);
+}
+
+static void reconnectTimerCallback(void *arg)
+{
+    esp_event_post(WIFI_RECONNECT_EVENT, 0, NULL, 0, portMAX_DELAY);
+}
+
+static void recordConnectTime()
+{
+    int64_t now = esp_timer_get_time();
+
+    if (bootToConnectUs == 0)
+        bootToConnectUs = now;
 
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, conf));
-    ESP_ERROR_CHECK(esp_wifi_connect());
-}
\ No newline at end of file
+    if (connectStartedAt)
+    {
+        uint32_t us = now - connectStartedAt;
+        Trace_record(TracePoint::WIFI_CONNECT, us);
+        lastConnectUs = us;
+        if (us > maxConnectUs)
+            maxConnectUs = us;
+        connectStartedAt = 0;
+    }
+}
+
+static void saveFastConnect(const esp_netif_ip_info_t *ipInfo)
+{
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK)
+        return;
+
+    FastConnectCache cache;
+    memset(&cache, 0, sizeof(cache)); // Padding is compared too.
+    memcpy(cache.bssid, ap.bssid, sizeof(cache.bssid));
+    cache.channel = ap.primary;
+    cache.ip = *ipInfo;
+    esp_netif_get_dns_info(staNetif, ESP_NETIF_DNS_MAIN, &cache.dns);
+    cache.magic = fastConnectMagic;
+
+    if (memcmp(&cache, &fastConnectCache, sizeof(cache)) == 0)
+        return;
+    fastConnectCache = cache;
+
+    // Flash is written only when AP or lease changes.
+    nvs_handle_t nvsHandle;
+    if (nvs_open(fastConnectNvsNamespace, NVS_READWRITE, &nvsHandle) != ESP_OK)
+        return;
+    if (nvs_set_blob(nvsHandle, fastConnectNvsKey, &cache, sizeof(cache)) == ESP_OK)
+        nvs_commit(nvsHandle);
+    nvs_close(nvsHandle);
+}
+
+static void loadFastConnect()
+{
+    if (fastConnectCache.magic == fastConnectMagic)
+        return;
+
+    nvs_handle_t nvsHandle;
+    if (nvs_open(fastConnectNvsNamespace, NVS_READONLY, &nvsHandle) != ESP_OK)
+        return;
+
+    FastConnectCache cache;
+    size_t size = sizeof(cache);
+    if (nvs_get_blob(nvsHandle, fastConnectNvsKey, &cache, &size) == ESP_OK &&
+        size == sizeof(cache) && cache.magic == fastConnectMagic)
+    {
+        fastConnectCache = cache;
+        ESP_LOGI(TAG_WIFI, "Loaded cached AP");
+    }
+    nvs_close(nvsHandle);
+}
+
+static bool applyFastConnect(wifi_config_t *conf)
+{
+    if (fastConnectCache.magic != fastConnectMagic)
+        return false;
+
+    ESP_LOGI(TAG_WIFI, "Using cached AP on channel %u", fastConnectCache.channel);
+
+    // Connect straight to known AP without scanning all channels.
+    conf->sta.bssid_set = true;
+    memcpy(conf->sta.bssid, fastConnectCache.bssid, sizeof(conf->sta.bssid));
+    conf->sta.channel = fastConnectCache.channel;
+
+    // Reuse previous lease instead of waiting for DHCP, client is started again once connected.
+    esp_netif_dhcpc_stop(staNetif);
+    esp_netif_set_ip_info(staNetif, &fastConnectCache.ip);
+    esp_netif_set_dns_info(staNetif, ESP_NETIF_DNS_MAIN, &fastConnectCache.dns);
+
+    return true;
+}
@@ -0,0 +1,96 @@
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include "../../../include/bmp180_compensation.hpp"
+#include "../../../include/dht11_frame.hpp"
+#include "../../../include/mqtt_format.hpp"
+
+/**
+ * Same cases as Benchmark_run() on the device, run with Google Benchmark:
+ * ./bench_host --benchmark_out=baseline.json --benchmark_out_format=json
+ */
+
+namespace
+{
+    // Example calibration and readings from BMP180 datasheet (T = 15.0 °C, p = 69964 Pa).
+    const BMP180Calibration datasheetCalibration = {408, -72, -14383, 32741, 32757, 23153, 6190, 4, -32768, -8711, 2868};
+    const int32_t datasheetUT = 27898;
+    const int32_t datasheetUP = 23843 << 8;
+}
+
+static void BM_TemperatureCompensation(benchmark::State &state)
+{
+    // Calibration is read from sensor on the device, don't let compiler fold it.
+    BMP180Calibration cal = datasheetCalibration;
+    benchmark::DoNotOptimize(cal);
+    int32_t B5, UT = datasheetUT;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(UT);
+        benchmark::DoNotOptimize(BMP180_compensateTemperature(cal, UT, B5));
+    }
+}
+BENCHMARK(BM_TemperatureCompensation);
+
+static void BM_PressureCompensation(benchmark::State &state)
+{
+    BMP180Calibration cal = datasheetCalibration;
+    benchmark::DoNotOptimize(cal);
+    int32_t B5, UP = datasheetUP;
+    BMP180_compensateTemperature(cal, datasheetUT, B5);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(UP);
+        benchmark::DoNotOptimize(BMP180_compensatePressure(cal, UP, 0, B5));
+    }
+}
+BENCHMARK(BM_PressureCompensation);
+
+static void BM_DHT11Decode(benchmark::State &state)
+{
+    // 45 %, 22 °C, valid checksum.
+    const uint64_t frame = ((uint64_t)45 << 32) | ((uint64_t)22 << 16) | (45 + 22);
+    uint64_t input = frame;
+    uint8_t humidity = 0, temperature = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(input);
+        benchmark::DoNotOptimize(DHT11_decodeFrame(input, humidity, temperature));
+        benchmark::DoNotOptimize(humidity);
+    }
+}
+BENCHMARK(BM_DHT11Decode);
+
+static void BM_FloatPayload(benchmark::State &state)
+{
+    char buf[128];
+    uint32_t i = 0;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(snprintf(buf, sizeof(buf), "%f", 1013.25f + i++));
+}
+BENCHMARK(BM_FloatPayload);
+
+static void BM_FixedPayload(benchmark::State &state)
+{
+    char value[16];
+    char buf[68];
+    uint32_t i = 0;
+    for (auto _ : state)
+    {
+        MQTT_formatFixed(value, sizeof(value), 101325 + (i & 1), 2);
+        MQTT_formatPayload(buf, sizeof(buf), value, 1700000000123000, "bmp180", i, i);
+        i++;
+        benchmark::DoNotOptimize(buf);
+    }
+}
+BENCHMARK(BM_FixedPayload);
+
+static void BM_TopicConstruction(benchmark::State &state)
+{
+    char buf[64];
+    uint32_t i = 0;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(MQTT_formatTopic(buf, sizeof(buf), "weather/station1", (i++ & 1) ? "pressure" : "humidity"));
+}
+BENCHMARK(BM_TopicConstruction);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include "driver/gpio.h"
+#include "driver/rmt.h"
+
+/**
+ * @brief DHT11 sensor on GPIO pin captured by RMT channel.
+ * Sensor answers only if firmware held the line low for at least 18 ms and had capture
+ * running when it released the line. Answer is pushed into the channel's ring buffer the way
+ * RMT receiver does it once line stays idle.
+ */
+namespace fake
+{
+    class Dht11
+    {
+    public:
+        enum class Mode
+        {
+            OK,
+            NO_RESPONSE,
+            BAD_CHECKSUM
+        };
+
+        Dht11(gpio_num_t pin, rmt_channel_t channel);
+        ~Dht11();
+
+        void set(uint8_t humidity, uint8_t temperature);
+        void setMode(Mode mode);
+
+        /**
+         * @brief Get number of frames sent.
+         */
+        uint32_t responses() const;
+
+        /**
+         * @brief Get number of start signals ignored for being shorter than 18 ms or sent without capture running.
+         */
+        uint32_t badStartSignals() const;
+
+    private:
+        void lineWritten(int level);
+    };
+}
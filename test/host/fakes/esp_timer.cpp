@@ -0,0 +1,171 @@
+#include "host.hpp"
+#include <set>
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// All callbacks run one at a time on single dispatcher thread, like ESP_TIMER_TASK dispatch.
+
+struct esp_timer
+{
+    esp_timer_cb_t callback;
+    void *arg;
+    std::string name;
+    int64_t alarm = 0;  //!< Time of next expiry, valid if armed.
+    uint64_t period = 0; //!< 0 for one-shot timer.
+    bool armed = false;
+    uint64_t sequence = 0; //!< Orders timers expiring at the same time by arming order.
+};
+
+namespace
+{
+    const size_t timerSize = 48; //!< sizeof(struct esp_timer) on ESP32.
+
+    struct ByAlarm
+    {
+        bool operator()(const esp_timer *a, const esp_timer *b) const
+        {
+            return a->alarm != b->alarm ? a->alarm < b->alarm : a->sequence < b->sequence;
+        }
+    };
+
+    class Dispatcher
+    {
+    public:
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::set<esp_timer *, ByAlarm> armed;
+        uint64_t sequence = 0;
+
+        Dispatcher()
+        {
+            std::thread(&Dispatcher::run, this).detach();
+        }
+
+        void arm(esp_timer *timer, int64_t alarm)
+        {
+            timer->alarm = alarm;
+            timer->sequence = sequence++;
+            timer->armed = true;
+            armed.insert(timer);
+            cv.notify_all();
+        }
+
+        void disarm(esp_timer *timer)
+        {
+            armed.erase(timer);
+            timer->armed = false;
+        }
+
+    private:
+        void run()
+        {
+            xTaskGetCurrentTaskHandle();
+
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true)
+            {
+                if (armed.empty())
+                {
+                    cv.wait(lock);
+                    continue;
+                }
+
+                esp_timer *timer = *armed.begin();
+                int64_t now = fake::nowUs();
+                if (timer->alarm > now)
+                {
+                    cv.wait_for(lock, std::chrono::microseconds(timer->alarm - now));
+                    continue;
+                }
+
+                disarm(timer);
+                if (timer->period)
+                    arm(timer, timer->alarm + timer->period);
+
+                // Callback may restart or stop timers.
+                esp_timer_cb_t callback = timer->callback;
+                void *arg = timer->arg;
+                lock.unlock();
+                callback(arg);
+                lock.lock();
+            }
+        }
+    };
+
+    Dispatcher &dispatcher()
+    {
+        // Never destroyed, timers may fire while process exits.
+        static Dispatcher *d = new Dispatcher;
+        return *d;
+    }
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle)
+{
+    if (create_args == nullptr || create_args->callback == nullptr || out_handle == nullptr)
+        return ESP_ERR_INVALID_ARG;
+
+    esp_timer *timer = new esp_timer;
+    timer->callback = create_args->callback;
+    timer->arg = create_args->arg;
+    timer->name = create_args->name ? create_args->name : "";
+    fake::heap::charge(timerSize);
+
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    Dispatcher &d = dispatcher();
+    std::lock_guard<std::mutex> lock(d.mutex);
+    if (timer->armed)
+        return ESP_ERR_INVALID_STATE;
+
+    timer->period = 0;
+    d.arm(timer, fake::nowUs() + timeout_us);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+    Dispatcher &d = dispatcher();
+    std::lock_guard<std::mutex> lock(d.mutex);
+    if (timer->armed)
+        return ESP_ERR_INVALID_STATE;
+
+    timer->period = period;
+    d.arm(timer, fake::nowUs() + period);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    Dispatcher &d = dispatcher();
+    std::lock_guard<std::mutex> lock(d.mutex);
+    if (!timer->armed)
+        return ESP_ERR_INVALID_STATE;
+
+    d.disarm(timer);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    Dispatcher &d = dispatcher();
+    {
+        std::lock_guard<std::mutex> lock(d.mutex);
+        if (timer->armed)
+            return ESP_ERR_INVALID_STATE;
+    }
+
+    fake::heap::release(timerSize);
+    delete timer;
+    return ESP_OK;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return fake::nowUs();
+}
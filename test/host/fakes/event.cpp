@@ -0,0 +1,117 @@
+#include "event.hpp"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "host.hpp"
+#include "esp_event.h"
+
+namespace
+{
+    struct Handler
+    {
+        esp_event_base_t base;
+        int32_t id;
+        esp_event_handler_t fn;
+        void *arg;
+    };
+
+    std::mutex mutex;
+    std::vector<Handler> handlers;
+    fake::Worker *loop = nullptr; //!< Leaked like the loop task, handlers may run while process exits.
+    std::atomic<uint32_t> inFlight{0};
+    std::map<std::pair<esp_event_base_t, int32_t>, uint32_t> postCounts;
+
+    bool matches(const Handler &h, esp_event_base_t base, int32_t id)
+    {
+        return (h.base == ESP_EVENT_ANY_BASE || h.base == base) && (h.id == ESP_EVENT_ANY_ID || h.id == id);
+    }
+
+    void dispatch(esp_event_base_t base, int32_t id, void *data)
+    {
+        std::vector<Handler> matching;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const Handler &h : handlers)
+            {
+                if (matches(h, base, id))
+                    matching.push_back(h);
+            }
+        }
+
+        for (const Handler &h : matching)
+            h.fn(h.arg, base, id, data);
+    }
+}
+
+bool fake::event::drain(uint32_t timeoutMs)
+{
+    return waitUntil([] { return inFlight == 0; }, timeoutMs);
+}
+
+uint32_t fake::event::posted(const char *base, int32_t id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = postCounts.find(std::make_pair(base, id));
+    return it == postCounts.end() ? 0 : it->second;
+}
+
+esp_err_t esp_event_loop_create_default(void)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (loop)
+        return ESP_ERR_INVALID_STATE;
+    loop = new fake::Worker("sys_evt");
+    return ESP_OK;
+}
+
+esp_err_t esp_event_loop_delete_default(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t event_base, int32_t event_id, esp_event_handler_t event_handler, void *event_handler_arg)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!loop)
+        return ESP_ERR_INVALID_STATE;
+    handlers.push_back({event_base, event_id, event_handler, event_handler_arg});
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_unregister(esp_event_base_t event_base, int32_t event_id, esp_event_handler_t event_handler)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = handlers.begin(); it != handlers.end(); ++it)
+    {
+        if (it->base == event_base && it->id == event_id && it->fn == event_handler)
+        {
+            handlers.erase(it);
+            return ESP_OK;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id, const void *event_data, size_t event_data_size, TickType_t ticks_to_wait)
+{
+    std::shared_ptr<std::vector<uint8_t>> data;
+    if (event_data && event_data_size)
+    {
+        const uint8_t *bytes = (const uint8_t *)event_data;
+        data = std::make_shared<std::vector<uint8_t>>(bytes, bytes + event_data_size);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!loop)
+        return ESP_ERR_INVALID_STATE;
+
+    postCounts[std::make_pair(event_base, event_id)]++;
+    inFlight++;
+    loop->after(0, [event_base, event_id, data] {
+        dispatch(event_base, event_id, data ? data->data() : nullptr);
+        inFlight--;
+    });
+    return ESP_OK;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+
+/**
+ * @brief Default event loop.
+ */
+namespace fake
+{
+    namespace event
+    {
+        /**
+         * @brief Wait until all posted events were handled.
+         * @param timeoutMs Max time to wait.
+         * @return False on timeout.
+         */
+        bool drain(uint32_t timeoutMs = 1000);
+
+        /**
+         * @brief Get number of events posted with given base and id so far.
+         */
+        uint32_t posted(const char *base, int32_t id);
+    }
+}
@@ -0,0 +1,84 @@
+#include "flash.hpp"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#include "esp_partition.h"
+
+namespace
+{
+    const uint32_t samplesSize = 0x40000; //!< Same as partitions.csv.
+
+    const esp_partition_t samples = {nullptr, ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)0x40, 0x190000, samplesSize, "samples", false};
+
+    std::mutex mutex;
+    std::vector<uint8_t> content(samplesSize, 0xFF);
+    uint32_t eraseCount = 0;
+
+    bool inRange(size_t offset, size_t size)
+    {
+        return offset <= samplesSize && size <= samplesSize - offset;
+    }
+}
+
+void fake::flash::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::fill(content.begin(), content.end(), 0xFF);
+    eraseCount = 0;
+}
+
+uint32_t fake::flash::erases()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return eraseCount;
+}
+
+const uint8_t *fake::flash::data()
+{
+    return content.data();
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label)
+{
+    if (type != samples.type || (subtype != ESP_PARTITION_SUBTYPE_ANY && subtype != samples.subtype))
+        return nullptr;
+    if (label && strcmp(label, samples.label) != 0)
+        return nullptr;
+    return &samples;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    if (partition != &samples || !inRange(src_offset, size))
+        return ESP_ERR_INVALID_ARG;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    memcpy(dst, content.data() + src_offset, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    if (partition != &samples || !inRange(dst_offset, size))
+        return ESP_ERR_INVALID_ARG;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    const uint8_t *bytes = (const uint8_t *)src;
+    for (size_t i = 0; i < size; i++)
+        content[dst_offset + i] &= bytes[i]; // Programming only clears bits.
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    if (partition != &samples || !inRange(offset, size))
+        return ESP_ERR_INVALID_ARG;
+    if (offset % SPI_FLASH_SEC_SIZE || size % SPI_FLASH_SEC_SIZE)
+        return ESP_ERR_INVALID_SIZE;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::fill(content.begin() + offset, content.begin() + offset + size, 0xFF);
+    eraseCount += size / SPI_FLASH_SEC_SIZE;
+    return ESP_OK;
+}
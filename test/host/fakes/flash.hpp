@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief RAM backed "samples" partition behaving like NOR flash:
+ * writes can only clear bits and erase works on whole sectors.
+ */
+namespace fake
+{
+    namespace flash
+    {
+        /**
+         * @brief Erase whole partition, like a freshly flashed device.
+         */
+        void reset();
+
+        /**
+         * @brief Get number of erased sectors since reset().
+         */
+        uint32_t erases();
+
+        /**
+         * @brief Get raw partition content.
+         */
+        const uint8_t *data();
+    }
+}
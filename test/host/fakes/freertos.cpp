@@ -0,0 +1,435 @@
+#include "host.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <vector>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/ringbuf.h"
+
+// Every task is a detached host thread. Scheduling is left to the host,
+// so priorities are only recorded and tasks on "both cores" really run in parallel.
+
+struct tskTaskControlBlock
+{
+    std::string name;
+    uint32_t stackDepth = 0;
+    bool created = false; //!< Created by xTaskCreate(), not adopted host thread.
+    std::mutex mutex;
+    std::condition_variable cv;
+    uint32_t value = 0;   //!< Notification value.
+    bool pending = false; //!< Notification received and not taken yet.
+};
+
+struct QueueDefinition
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    UBaseType_t count;
+    UBaseType_t max;
+};
+
+struct Ringbuffer
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t capacity;
+    size_t used = 0;                        //!< Includes items received but not returned yet.
+    std::deque<std::vector<uint8_t>> items; //!< Waiting to be received.
+};
+
+namespace
+{
+    const size_t tcbSize = 360;       //!< sizeof(TCB_t) on ESP32.
+    const size_t semaphoreSize = 88;  //!< sizeof(StaticQueue_t) on ESP32.
+    const size_t ringbufHeader = 8;   //!< Header of every no-split item.
+
+    struct TaskDeleted
+    {
+    };
+
+    thread_local TaskHandle_t currentTask = nullptr;
+
+    std::mutex &registryMutex()
+    {
+        static std::mutex *m = new std::mutex;
+        return *m;
+    }
+
+    std::vector<TaskHandle_t> &registry()
+    {
+        static std::vector<TaskHandle_t> *tasks = new std::vector<TaskHandle_t>;
+        return *tasks;
+    }
+
+    std::chrono::microseconds ticksToDuration(TickType_t ticks)
+    {
+        return std::chrono::microseconds((uint64_t)ticks * portTICK_PERIOD_MS * 1000);
+    }
+
+    template <typename Pred>
+    bool waitFor(std::unique_lock<std::mutex> &lock, std::condition_variable &cv, TickType_t ticks, Pred pred)
+    {
+        if (ticks == portMAX_DELAY)
+        {
+            cv.wait(lock, pred);
+            return true;
+        }
+        return cv.wait_for(lock, ticksToDuration(ticks), pred);
+    }
+
+    void notify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+    {
+        if (task == nullptr)
+        {
+            fprintf(stderr, "FreeRTOS: notify of NULL task\n");
+            abort();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(task->mutex);
+            switch (action)
+            {
+            case eSetBits:
+                task->value |= value;
+                break;
+            case eIncrement:
+                task->value++;
+                break;
+            case eSetValueWithOverwrite:
+                task->value = value;
+                break;
+            case eSetValueWithoutOverwrite:
+                if (!task->pending)
+                    task->value = value;
+                break;
+            default:
+                break;
+            }
+            task->pending = true;
+        }
+        task->cv.notify_all();
+    }
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+    return 0;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pvTaskCode, const char *pcName, uint32_t usStackDepth, void *pvParameters,
+                       UBaseType_t uxPriority, TaskHandle_t *pxCreatedTask)
+{
+    TaskHandle_t task = new tskTaskControlBlock;
+    task->name = pcName ? pcName : "";
+    task->stackDepth = usStackDepth;
+    task->created = true;
+    fake::heap::charge(tcbSize + usStackDepth);
+
+    {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        registry().push_back(task);
+    }
+
+    // Handle is visible before the task runs, creator may use it right away.
+    if (pxCreatedTask)
+        *pxCreatedTask = task;
+
+    std::thread([task, pvTaskCode, pvParameters]() {
+        currentTask = task;
+        try
+        {
+            pvTaskCode(pvParameters);
+        }
+        catch (const TaskDeleted &)
+        {
+            return;
+        }
+        fprintf(stderr, "FreeRTOS: task %s returned without deleting itself\n", task->name.c_str());
+        abort();
+    }).detach();
+
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pvTaskCode, const char *pcName, uint32_t usStackDepth, void *pvParameters,
+                                   UBaseType_t uxPriority, TaskHandle_t *pxCreatedTask, BaseType_t xCoreID)
+{
+    return xTaskCreate(pvTaskCode, pcName, usStackDepth, pvParameters, uxPriority, pxCreatedTask);
+}
+
+void vTaskDelete(TaskHandle_t xTaskToDelete)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    if (xTaskToDelete != nullptr && xTaskToDelete != self)
+    {
+        fprintf(stderr, "FreeRTOS: host supports only tasks deleting themselves\n");
+        abort();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        std::vector<TaskHandle_t> &tasks = registry();
+        for (size_t i = 0; i < tasks.size(); i++)
+        {
+            if (tasks[i] == self)
+            {
+                tasks.erase(tasks.begin() + i);
+                break;
+            }
+        }
+    }
+
+    if (self->created)
+        fake::heap::release(tcbSize + self->stackDepth);
+
+    // Handle stays allocated, other tasks may still hold it.
+    throw TaskDeleted();
+}
+
+void vTaskDelay(TickType_t xTicksToDelay)
+{
+    if (xTicksToDelay == 0)
+        std::this_thread::yield();
+    else
+        std::this_thread::sleep_for(ticksToDuration(xTicksToDelay));
+}
+
+void vTaskDelayUntil(TickType_t *pxPreviousWakeTime, TickType_t xTimeIncrement)
+{
+    *pxPreviousWakeTime += xTimeIncrement;
+    TickType_t now = xTaskGetTickCount();
+    TickType_t remaining = *pxPreviousWakeTime - now;
+    if ((int32_t)remaining > 0)
+        vTaskDelay(remaining);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(fake::nowUs() / (portTICK_PERIOD_MS * 1000));
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    if (currentTask == nullptr)
+    {
+        // Host thread (test, fake peripheral) acting as task.
+        TaskHandle_t task = new tskTaskControlBlock;
+        task->name = "host";
+        currentTask = task;
+    }
+    return currentTask;
+}
+
+TaskHandle_t xTaskGetHandle(const char *pcNameToQuery)
+{
+    std::lock_guard<std::mutex> lock(registryMutex());
+    for (TaskHandle_t task : registry())
+    {
+        if (task->name == pcNameToQuery)
+            return task;
+    }
+    return nullptr;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t xTask)
+{
+    // Stack usage of host thread says nothing about the device, report depth given at creation.
+    TaskHandle_t task = xTask ? xTask : xTaskGetCurrentTaskHandle();
+    return task->stackDepth;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t xTaskToNotify, uint32_t ulValue, eNotifyAction eAction)
+{
+    notify(xTaskToNotify, ulValue, eAction);
+    return pdPASS;
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t xTaskToNotify, uint32_t ulValue, eNotifyAction eAction, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    notify(xTaskToNotify, ulValue, eAction);
+    if (pxHigherPriorityTaskWoken)
+        *pxHigherPriorityTaskWoken = pdFALSE;
+    return pdPASS;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t ulBitsToClearOnEntry, uint32_t ulBitsToClearOnExit, uint32_t *pulNotificationValue, TickType_t xTicksToWait)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> lock(self->mutex);
+
+    if (!self->pending)
+        self->value &= ~ulBitsToClearOnEntry;
+
+    bool received = waitFor(lock, self->cv, xTicksToWait, [self]() { return self->pending; });
+    if (pulNotificationValue)
+        *pulNotificationValue = self->value;
+    if (!received)
+        return pdFALSE;
+
+    self->value &= ~ulBitsToClearOnExit;
+    self->pending = false;
+    return pdTRUE;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify)
+{
+    notify(xTaskToNotify, 0, eIncrement);
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    notify(xTaskToNotify, 0, eIncrement);
+    if (pxHigherPriorityTaskWoken)
+        *pxHigherPriorityTaskWoken = pdFALSE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> lock(self->mutex);
+
+    waitFor(lock, self->cv, xTicksToWait, [self]() { return self->value != 0; });
+
+    uint32_t value = self->value;
+    if (value)
+        self->value = xClearCountOnExit ? 0 : value - 1;
+    self->pending = false;
+    return value;
+}
+
+static SemaphoreHandle_t createSemaphore(UBaseType_t max, UBaseType_t initial)
+{
+    SemaphoreHandle_t sem = new QueueDefinition;
+    sem->count = initial;
+    sem->max = max;
+    fake::heap::charge(semaphoreSize);
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return createSemaphore(1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return createSemaphore(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t uxMaxCount, UBaseType_t uxInitialCount)
+{
+    return createSemaphore(uxMaxCount, uxInitialCount);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t xSemaphore)
+{
+    fake::heap::release(semaphoreSize);
+    delete xSemaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xBlockTime)
+{
+    std::unique_lock<std::mutex> lock(xSemaphore->mutex);
+    if (!waitFor(lock, xSemaphore->cv, xBlockTime, [xSemaphore]() { return xSemaphore->count > 0; }))
+        return pdFALSE;
+
+    xSemaphore->count--;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore)
+{
+    {
+        std::lock_guard<std::mutex> lock(xSemaphore->mutex);
+        if (xSemaphore->count >= xSemaphore->max)
+            return pdFALSE;
+        xSemaphore->count++;
+    }
+    xSemaphore->cv.notify_one();
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t xSemaphore, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    if (pxHigherPriorityTaskWoken)
+        *pxHigherPriorityTaskWoken = pdFALSE;
+    return xSemaphoreGive(xSemaphore);
+}
+
+RingbufHandle_t xRingbufferCreate(size_t xBufferSize, RingbufferType_t xBufferType)
+{
+    if (xBufferType != RINGBUF_TYPE_NOSPLIT)
+    {
+        fprintf(stderr, "FreeRTOS: host ring buffer supports only RINGBUF_TYPE_NOSPLIT\n");
+        abort();
+    }
+
+    RingbufHandle_t buf = new Ringbuffer;
+    buf->capacity = xBufferSize;
+    fake::heap::charge(xBufferSize);
+    return buf;
+}
+
+void vRingbufferDelete(RingbufHandle_t xRingbuffer)
+{
+    fake::heap::release(xRingbuffer->capacity);
+    delete xRingbuffer;
+}
+
+static size_t itemFootprint(size_t size)
+{
+    return ringbufHeader + ((size + 3) & ~(size_t)3);
+}
+
+UBaseType_t xRingbufferSend(RingbufHandle_t xRingbuffer, const void *pvItem, size_t xItemSize, TickType_t xTicksToWait)
+{
+    size_t footprint = itemFootprint(xItemSize);
+    std::unique_lock<std::mutex> lock(xRingbuffer->mutex);
+    if (!waitFor(lock, xRingbuffer->cv, xTicksToWait,
+                 [&]() { return xRingbuffer->used + footprint <= xRingbuffer->capacity; }))
+        return pdFALSE;
+
+    const uint8_t *bytes = (const uint8_t *)pvItem;
+    xRingbuffer->items.emplace_back(bytes, bytes + xItemSize);
+    xRingbuffer->used += footprint;
+    lock.unlock();
+    xRingbuffer->cv.notify_all();
+    return pdTRUE;
+}
+
+void *xRingbufferReceive(RingbufHandle_t xRingbuffer, size_t *pxItemSize, TickType_t xTicksToWait)
+{
+    std::unique_lock<std::mutex> lock(xRingbuffer->mutex);
+    if (!waitFor(lock, xRingbuffer->cv, xTicksToWait, [xRingbuffer]() { return !xRingbuffer->items.empty(); }))
+        return nullptr;
+
+    // Item keeps its space until it's returned, like in the real buffer.
+    std::vector<uint8_t> &item = xRingbuffer->items.front();
+    size_t size = item.size();
+    uint8_t *copy = (uint8_t *)malloc(sizeof(size_t) + size);
+    memcpy(copy, &size, sizeof(size_t));
+    memcpy(copy + sizeof(size_t), item.data(), size);
+    xRingbuffer->items.pop_front();
+
+    if (pxItemSize)
+        *pxItemSize = size;
+    return copy + sizeof(size_t);
+}
+
+void vRingbufferReturnItem(RingbufHandle_t xRingbuffer, void *pvItem)
+{
+    uint8_t *copy = (uint8_t *)pvItem - sizeof(size_t);
+    size_t size;
+    memcpy(&size, copy, sizeof(size_t));
+    free(copy);
+
+    {
+        std::lock_guard<std::mutex> lock(xRingbuffer->mutex);
+        xRingbuffer->used -= itemFootprint(size);
+    }
+    xRingbuffer->cv.notify_all();
+}
@@ -0,0 +1,167 @@
+#include "gpio.hpp"
+#include <mutex>
+
+namespace
+{
+    struct Pin
+    {
+        gpio_mode_t mode = GPIO_MODE_DISABLE;
+        int output = 1;
+        int external = -1;
+        uint32_t writes = 0;
+        gpio_isr_t isr = nullptr;
+        void *isrArg = nullptr;
+        std::function<void(int)> onWrite;
+    };
+
+    std::mutex mutex;
+    Pin pins[GPIO_NUM_MAX];
+    bool isrServiceInstalled = false;
+
+    bool valid(gpio_num_t pin)
+    {
+        return pin >= 0 && pin < GPIO_NUM_MAX;
+    }
+
+    bool drivesOutput(gpio_mode_t mode)
+    {
+        return mode & GPIO_MODE_OUTPUT;
+    }
+}
+
+namespace fake
+{
+    namespace gpio
+    {
+        void drive(gpio_num_t pin, int level)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pins[pin].external = level;
+        }
+
+        int output(gpio_num_t pin)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return drivesOutput(pins[pin].mode) ? pins[pin].output : 1;
+        }
+
+        int line(gpio_num_t pin)
+        {
+            return gpio_get_level(pin);
+        }
+
+        gpio_mode_t mode(gpio_num_t pin)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return pins[pin].mode;
+        }
+
+        void onWrite(gpio_num_t pin, std::function<void(int)> fn)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pins[pin].onWrite = fn;
+        }
+
+        uint32_t writes(gpio_num_t pin)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return pins[pin].writes;
+        }
+
+        bool press(gpio_num_t pin)
+        {
+            gpio_isr_t isr;
+            void *arg;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                isr = pins[pin].isr;
+                arg = pins[pin].isrArg;
+                pins[pin].external = 0;
+            }
+            if (isr)
+                isr(arg);
+            drive(pin, -1);
+            return isr != nullptr;
+        }
+
+        void reset()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (Pin &p : pins)
+                p = Pin();
+            isrServiceInstalled = false;
+        }
+    }
+}
+
+esp_err_t gpio_config(const gpio_config_t *pGPIOConfig)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (pGPIOConfig->pin_bit_mask >> GPIO_NUM_MAX)
+        return ESP_ERR_INVALID_ARG;
+
+    for (int i = 0; i < GPIO_NUM_MAX; i++)
+    {
+        if (pGPIOConfig->pin_bit_mask & (1ULL << i))
+            pins[i].mode = pGPIOConfig->mode;
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+    if (!valid(gpio_num))
+        return ESP_ERR_INVALID_ARG;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    pins[gpio_num].mode = mode;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    if (!valid(gpio_num))
+        return ESP_ERR_INVALID_ARG;
+
+    std::function<void(int)> fn;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Pin &p = pins[gpio_num];
+        p.output = level ? 1 : 0;
+        p.writes++;
+        fn = p.onWrite;
+    }
+    if (fn)
+        fn(level ? 1 : 0);
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    if (!valid(gpio_num))
+        return 0;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    const Pin &p = pins[gpio_num];
+    bool pulledByFirmware = drivesOutput(p.mode) && p.output == 0;
+    return p.external == 0 || pulledByFirmware ? 0 : 1;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (isrServiceInstalled)
+        return ESP_ERR_INVALID_STATE;
+    isrServiceInstalled = true;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!isrServiceInstalled)
+        return ESP_ERR_INVALID_STATE;
+    pins[gpio_num].isr = isr_handler;
+    pins[gpio_num].isrArg = args;
+    return ESP_OK;
+}
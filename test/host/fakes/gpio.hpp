@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include "driver/gpio.h"
+
+/**
+ * @brief Pins of modelled board.
+ * Level seen by firmware is wired AND of what firmware drives and what outside world drives,
+ * floating pins read high as every pin the firmware uses has a pull up.
+ */
+namespace fake
+{
+    namespace gpio
+    {
+        /**
+         * @brief Drive pin from outside, e.g. slave holding SDA or pressed button.
+         * @param pin Pin.
+         * @param level 0 pulls low, 1 or -1 releases it.
+         */
+        void drive(gpio_num_t pin, int level);
+
+        /**
+         * @brief Get level firmware drives, 1 if it doesn't drive the pin.
+         */
+        int output(gpio_num_t pin);
+
+        /**
+         * @brief Get level on the wire.
+         */
+        int line(gpio_num_t pin);
+
+        /**
+         * @brief Get mode last configured by firmware.
+         */
+        gpio_mode_t mode(gpio_num_t pin);
+
+        /**
+         * @brief Call function whenever firmware sets level of pin.
+         * @param pin Pin.
+         * @param fn Function getting new level, empty function removes it. Runs on firmware's thread.
+         */
+        void onWrite(gpio_num_t pin, std::function<void(int level)> fn);
+
+        /**
+         * @brief Get number of gpio_set_level() calls on pin.
+         */
+        uint32_t writes(gpio_num_t pin);
+
+        /**
+         * @brief Pull pin low and call its ISR as on falling edge, pin is released afterwards.
+         * @param pin Pin.
+         * @return False if firmware has no ISR on the pin.
+         */
+        bool press(gpio_num_t pin);
+
+        /**
+         * @brief Release all pins and forget their configuration and handlers.
+         */
+        void reset();
+    }
+}
@@ -0,0 +1,147 @@
+#include "host.hpp"
+#include <atomic>
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+namespace
+{
+    std::atomic<size_t> usedBytes{0};
+    std::atomic<size_t> minFreeBytes{fake::heap::size};
+    std::atomic<bool> clockHeld{false};
+    std::atomic<int64_t> heldUs{0};
+
+    int64_t realUs()
+    {
+        static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int64_t fake::nowUs()
+{
+    return clockHeld ? heldUs.load() : realUs();
+}
+
+void fake::holdClock()
+{
+    heldUs = realUs();
+    clockHeld = true;
+}
+
+void fake::advanceClock(int64_t us)
+{
+    heldUs += us;
+}
+
+void fake::heap::charge(size_t bytes)
+{
+    size_t used = usedBytes += bytes;
+    size_t free = used < size ? size - used : 0;
+    size_t prevMin = minFreeBytes.load();
+    while (free < prevMin && !minFreeBytes.compare_exchange_weak(prevMin, free))
+    {
+    }
+}
+
+void fake::heap::release(size_t bytes)
+{
+    usedBytes -= bytes;
+}
+
+size_t fake::heap::used()
+{
+    return usedBytes;
+}
+
+size_t fake::heap::minFree()
+{
+    return minFreeBytes;
+}
+
+bool fake::waitUntil(const std::function<bool()> &pred, uint32_t timeoutMs)
+{
+    int64_t deadline = realUs() + (int64_t)timeoutMs * 1000;
+    while (!pred())
+    {
+        if (realUs() >= deadline)
+            return pred();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+fake::Worker::Worker(const char *name) : name(name), thread(&Worker::run, this)
+{
+}
+
+fake::Worker::~Worker()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    thread.join();
+}
+
+void fake::Worker::after(int64_t delayUs, std::function<void()> fn)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.emplace(nowUs() + delayUs, std::move(fn));
+    }
+    cv.notify_all();
+}
+
+void fake::Worker::cancelAll()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.clear();
+}
+
+bool fake::Worker::isCurrent() const
+{
+    return std::this_thread::get_id() == thread.get_id();
+}
+
+void fake::Worker::run()
+{
+    // Callbacks may call FreeRTOS functions, give the thread its task handle and name.
+    xTaskGetCurrentTaskHandle();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping)
+    {
+        if (pending.empty())
+        {
+            cv.wait(lock);
+            continue;
+        }
+
+        int64_t due = pending.begin()->first;
+        int64_t now = nowUs();
+        if (due > now)
+        {
+            cv.wait_for(lock, std::chrono::microseconds(due - now));
+            continue;
+        }
+
+        std::function<void()> fn = std::move(pending.begin()->second);
+        pending.erase(pending.begin());
+        lock.unlock();
+        fn();
+        lock.lock();
+    }
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    size_t used = fake::heap::used();
+    return used < fake::heap::size ? fake::heap::size - used : 0;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    return fake::heap::minFree();
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ * @brief Host runtime shared by all fakes: clock, heap accounting and delayed work.
+ */
+namespace fake
+{
+    /**
+     * @brief Microseconds since start of process, esp_timer and tick count are derived from it.
+     */
+    int64_t nowUs();
+
+    /**
+     * @brief Stop clock, from now on it moves only by advanceClock().
+     * Lets tests place events exactly on the same microsecond, waitUntil() keeps real time.
+     */
+    void holdClock();
+
+    /**
+     * @brief Move held clock forward.
+     */
+    void advanceClock(int64_t us);
+
+    /**
+     * @brief Heap of modelled device.
+     * Firmware never allocates by itself, so everything charged here belongs to ESP-IDF objects
+     * (tasks, clients, servers, ...) and leak of such object shows as growth of used bytes.
+     */
+    namespace heap
+    {
+        const size_t size = 300 * 1024; //!< Free heap of ESP32 after boot, roughly.
+
+        void charge(size_t bytes);
+        void release(size_t bytes);
+        size_t used();
+        size_t minFree();
+    }
+
+    /**
+     * @brief Wait until predicate holds, polling every millisecond.
+     * @param pred Predicate.
+     * @param timeoutMs Max time to wait.
+     * @return Last value of predicate.
+     */
+    bool waitUntil(const std::function<bool()> &pred, uint32_t timeoutMs);
+
+    /**
+     * @brief Thread running callbacks at given times, used by fakes to model latency of peripherals.
+     */
+    class Worker
+    {
+    public:
+        explicit Worker(const char *name);
+        ~Worker();
+
+        /**
+         * @brief Run function after delay, functions due at the same time run in order of calls.
+         * @param delayUs Delay.
+         * @param fn Function, runs on worker's thread.
+         */
+        void after(int64_t delayUs, std::function<void()> fn);
+
+        /**
+         * @brief Drop all pending functions.
+         */
+        void cancelAll();
+
+        /**
+         * @brief Check whether caller runs on worker's thread.
+         */
+        bool isCurrent() const;
+
+    private:
+        void run();
+
+        std::string name;
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::multimap<int64_t, std::function<void()>> pending;
+        bool stopping = false;
+        std::thread thread;
+    };
+}
@@ -0,0 +1,532 @@
+#include "httpd.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <set>
+#include "host.hpp"
+#include "esp_http_server.h"
+#include "lwip/sockets.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+namespace
+{
+    struct Session
+    {
+        bool open = true;
+        std::string unread;          //!< Written by firmware straight to socket, not read by client yet.
+        size_t capacity = SIZE_MAX; //!< Max unread bytes.
+    };
+
+    struct Server
+    {
+        httpd_config_t config;
+        std::vector<httpd_uri_t> handlers;
+        std::vector<std::string> uris; //!< Copies of handler URIs.
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<std::function<void()>> queue;
+        bool busy = false;
+        bool stopping = false;
+        bool exited = false;
+        std::map<int, Session> sessions;
+    };
+
+    /**
+     * @brief State of request kept in httpd_req_t::aux.
+     */
+    struct RequestState
+    {
+        Server *server;
+        int fd;
+        fake::httpd::Request request;
+        size_t received = 0;
+        fake::httpd::Response *response;
+        bool sent = false;
+    };
+
+    struct RequestImpl
+    {
+        httpd_req_t req;
+        RequestState state;
+        fake::httpd::Response response; //!< Outlives caller that gave up waiting.
+    };
+
+    const size_t serverSize = 1024; //!< Server struct, session table and receive buffer.
+
+    std::mutex mutex;
+    std::set<Server *> servers;
+    std::set<int> closedFds;
+    int nextFd = 54;
+
+    const char *statusOf(httpd_err_code_t code)
+    {
+        switch (code)
+        {
+        case HTTPD_400_BAD_REQUEST:
+            return HTTPD_400;
+        case HTTPD_404_NOT_FOUND:
+            return HTTPD_404;
+        case HTTPD_405_METHOD_NOT_ALLOWED:
+            return "405 Method Not Allowed";
+        case HTTPD_408_REQ_TIMEOUT:
+            return HTTPD_408;
+        default:
+            return HTTPD_500;
+        }
+    }
+
+    RequestState &stateOf(httpd_req_t *r)
+    {
+        return *(RequestState *)r->aux;
+    }
+
+    /**
+     * @brief Find session, caller holds server mutex.
+     */
+    Session *findSession(Server *server, int fd)
+    {
+        auto it = server->sessions.find(fd);
+        return it == server->sessions.end() || !it->second.open ? nullptr : &it->second;
+    }
+
+    void closeSession(Server *server, int fd)
+    {
+        {
+            std::lock_guard<std::mutex> lock(server->mutex);
+            Session *session = findSession(server, fd);
+            if (!session)
+                return;
+            session->open = false;
+        }
+        if (server->config.close_fn)
+            server->config.close_fn(server, fd);
+        else
+            lwip_close(fd);
+    }
+
+    bool pathMatches(const std::string &handlerUri, const std::string &uri)
+    {
+        return handlerUri == uri.substr(0, uri.find('?'));
+    }
+
+    void handle(Server *server, RequestImpl *impl)
+    {
+        RequestState &state = impl->state;
+        const httpd_uri_t *match = nullptr;
+        bool uriKnown = false;
+        for (size_t i = 0; i < server->handlers.size(); i++)
+        {
+            if (!pathMatches(server->uris[i], state.request.uri))
+                continue;
+            uriKnown = true;
+            if (server->handlers[i].method == state.request.method)
+                match = &server->handlers[i];
+        }
+
+        if (!match)
+        {
+            httpd_resp_send_err(&impl->req, uriKnown ? HTTPD_405_METHOD_NOT_ALLOWED : HTTPD_404_NOT_FOUND, nullptr);
+            return;
+        }
+
+        impl->req.user_ctx = match->user_ctx;
+        if (match->handler(&impl->req) != ESP_OK)
+        {
+            // Failing handler makes server close the session.
+            if (!state.sent && state.response->status == 0)
+                state.response->status = -1;
+            closeSession(server, state.fd);
+        }
+    }
+
+    void serverTask(void *arg)
+    {
+        Server *server = (Server *)arg;
+        std::unique_lock<std::mutex> lock(server->mutex);
+        while (true)
+        {
+            server->cv.wait(lock, [server] { return server->stopping || !server->queue.empty(); });
+            if (server->stopping)
+                break;
+
+            std::function<void()> fn = std::move(server->queue.front());
+            server->queue.pop_front();
+            server->busy = true;
+            lock.unlock();
+            fn();
+            lock.lock();
+            server->busy = false;
+            server->cv.notify_all();
+        }
+
+        server->exited = true;
+        server->cv.notify_all();
+        lock.unlock();
+        vTaskDelete(NULL);
+    }
+
+    bool queue(Server *server, std::function<void()> fn)
+    {
+        {
+            std::lock_guard<std::mutex> lock(server->mutex);
+            if (server->stopping)
+                return false;
+            server->queue.push_back(std::move(fn));
+        }
+        server->cv.notify_all();
+        return true;
+    }
+
+    Server *current()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return servers.empty() ? nullptr : *servers.begin();
+    }
+
+    /**
+     * @brief Run function with session of fd on any running server.
+     */
+    template <typename Fn>
+    bool withSession(int fd, Fn fn)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (Server *server : servers)
+        {
+            std::lock_guard<std::mutex> serverLock(server->mutex);
+            Session *session = findSession(server, fd);
+            if (session)
+            {
+                fn(*session);
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+fake::httpd::Response fake::httpd::request(const Request &req, uint32_t timeoutMs)
+{
+    Server *server = current();
+    if (!server)
+        return Response();
+
+    auto impl = std::make_shared<RequestImpl>();
+    auto done = std::make_shared<std::atomic<bool>>(false);
+    impl->req = {};
+    impl->req.handle = server;
+    impl->req.method = req.method;
+    strncpy(impl->req.uri, req.uri.c_str(), HTTPD_MAX_URI_LEN);
+    impl->req.content_len = req.contentLength < 0 ? req.body.size() : req.contentLength;
+    impl->req.aux = &impl->state;
+    impl->state.server = server;
+    impl->state.request = req;
+    impl->state.response = &impl->response;
+
+    {
+        std::lock_guard<std::mutex> lock(server->mutex);
+        impl->state.fd = nextFd++;
+        server->sessions[impl->state.fd];
+    }
+    impl->response.fd = impl->state.fd;
+
+    bool queued = queue(server, [server, impl, done] {
+        handle(server, impl.get());
+        *done = true;
+    });
+    if (!queued || !waitUntil([done] { return done->load(); }, timeoutMs))
+    {
+        Response none;
+        none.fd = impl->state.fd;
+        return none;
+    }
+    return impl->response;
+}
+
+fake::httpd::Response fake::httpd::get(const std::string &uri)
+{
+    Request req;
+    req.uri = uri;
+    return request(req);
+}
+
+fake::httpd::Response fake::httpd::post(const std::string &uri, const std::string &body)
+{
+    Request req;
+    req.method = HTTP_POST;
+    req.uri = uri;
+    req.body = body;
+    return request(req);
+}
+
+bool fake::httpd::running()
+{
+    return current() != nullptr;
+}
+
+std::string fake::httpd::read(int fd)
+{
+    std::string data;
+    withSession(fd, [&](Session &s) {
+        data.swap(s.unread);
+    });
+    return data;
+}
+
+void fake::httpd::setCapacity(int fd, size_t bytes)
+{
+    withSession(fd, [&](Session &s) { s.capacity = bytes; });
+}
+
+// Parenthesized name keeps close() macro of lwip/sockets.h away.
+void (fake::httpd::close)(int fd)
+{
+    Server *server = current();
+    if (server)
+        queue(server, [server, fd] { closeSession(server, fd); });
+}
+
+bool fake::httpd::isOpen(int fd)
+{
+    return withSession(fd, [](Session &) {});
+}
+
+bool fake::httpd::closedByFirmware(int fd)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return closedFds.count(fd);
+}
+
+bool fake::httpd::drain(uint32_t timeoutMs)
+{
+    return waitUntil([] {
+        Server *server = current();
+        if (!server)
+            return true;
+        std::lock_guard<std::mutex> lock(server->mutex);
+        return server->queue.empty() && !server->busy;
+    }, timeoutMs);
+}
+
+int lwip_close(int s)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    closedFds.insert(s);
+    return 0;
+}
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config)
+{
+    Server *server = new Server;
+    server->config = *config;
+    fake::heap::charge(serverSize);
+
+    if (xTaskCreate(serverTask, "httpd", config->stack_size, server, config->task_priority, NULL) != pdPASS)
+    {
+        fake::heap::release(serverSize);
+        delete server;
+        return ESP_ERR_HTTPD_TASK;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    servers.insert(server);
+    *handle = server;
+    return ESP_OK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle)
+{
+    Server *server = (Server *)handle;
+    if (!server)
+        return ESP_ERR_INVALID_ARG;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        servers.erase(server);
+    }
+
+    std::vector<int> open;
+    {
+        std::unique_lock<std::mutex> lock(server->mutex);
+        server->stopping = true;
+        server->queue.clear(); // Work that didn't run is dropped.
+        server->cv.notify_all();
+        server->cv.wait(lock, [server] { return server->exited; });
+        for (auto &s : server->sessions)
+        {
+            if (s.second.open)
+                open.push_back(s.first);
+        }
+    }
+
+    for (int fd : open)
+        closeSession(server, fd);
+
+    fake::heap::release(serverSize);
+    delete server;
+    return ESP_OK;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri_handler)
+{
+    Server *server = (Server *)handle;
+    std::lock_guard<std::mutex> lock(server->mutex);
+    for (size_t i = 0; i < server->handlers.size(); i++)
+    {
+        if (server->uris[i] == uri_handler->uri && server->handlers[i].method == uri_handler->method)
+            return ESP_ERR_HTTPD_HANDLER_EXISTS;
+    }
+    if (server->handlers.size() >= server->config.max_uri_handlers)
+        return ESP_ERR_HTTPD_HANDLERS_FULL;
+
+    server->handlers.push_back(*uri_handler);
+    server->uris.push_back(uri_handler->uri);
+    return ESP_OK;
+}
+
+esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void *arg)
+{
+    Server *server = (Server *)handle;
+    if (!server || !work)
+        return ESP_ERR_INVALID_ARG;
+    return queue(server, [work, arg] { work(arg); }) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t httpd_sess_trigger_close(httpd_handle_t handle, int sockfd)
+{
+    Server *server = (Server *)handle;
+    {
+        std::lock_guard<std::mutex> lock(server->mutex);
+        if (!findSession(server, sockfd))
+            return ESP_ERR_NOT_FOUND;
+    }
+    return queue(server, [server, sockfd] { closeSession(server, sockfd); }) ? ESP_OK : ESP_FAIL;
+}
+
+int httpd_req_recv(httpd_req_t *r, char *buf, size_t buf_len)
+{
+    RequestState &state = stateOf(r);
+    const std::string &body = state.request.body;
+    if (state.received >= r->content_len)
+        return 0;
+    if (state.received >= body.size())
+        return HTTPD_SOCK_ERR_TIMEOUT; // Client declared more than it sent.
+
+    size_t n = std::min(buf_len, body.size() - state.received);
+    if (state.request.recvChunk)
+        n = std::min(n, state.request.recvChunk);
+    memcpy(buf, body.data() + state.received, n);
+    state.received += n;
+    return n;
+}
+
+int httpd_req_to_sockfd(httpd_req_t *r)
+{
+    return stateOf(r).fd;
+}
+
+int httpd_send(httpd_req_t *r, const char *buf, size_t buf_len)
+{
+    return httpd_socket_send(r->handle, stateOf(r).fd, buf, buf_len, 0);
+}
+
+int httpd_socket_send(httpd_handle_t hd, int sockfd, const char *buf, size_t buf_len, int flags)
+{
+    Server *server = (Server *)hd;
+    std::lock_guard<std::mutex> lock(server->mutex);
+    Session *session = findSession(server, sockfd);
+    if (!session)
+        return HTTPD_SOCK_ERR_INVALID;
+
+    size_t room = session->capacity > session->unread.size() ? session->capacity - session->unread.size() : 0;
+    size_t n = std::min(room, buf_len);
+    if (n == 0 && buf_len)
+        return HTTPD_SOCK_ERR_TIMEOUT;
+    session->unread.append(buf, n);
+    return n;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len)
+{
+    RequestState &state = stateOf(r);
+    if (state.sent)
+        return ESP_ERR_HTTPD_RESP_SEND;
+
+    if (buf_len == HTTPD_RESP_USE_STRLEN)
+        buf_len = buf ? strlen(buf) : 0;
+    fake::httpd::Response &response = *state.response;
+    if (response.status == 0)
+        response.status = 200;
+    if (buf)
+        response.body.assign(buf, buf_len);
+    state.sent = true;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t buf_len)
+{
+    RequestState &state = stateOf(r);
+    if (state.sent)
+        return ESP_ERR_HTTPD_RESP_SEND;
+
+    if (buf_len == HTTPD_RESP_USE_STRLEN)
+        buf_len = buf ? strlen(buf) : 0;
+    fake::httpd::Response &response = *state.response;
+    if (response.status == 0)
+        response.status = 200;
+    response.chunked = true;
+    if (buf == nullptr || buf_len == 0)
+    {
+        state.sent = true;
+        return ESP_OK;
+    }
+
+    // Chunk goes out right away, failing if session was closed meanwhile.
+    {
+        std::lock_guard<std::mutex> lock(state.server->mutex);
+        if (!findSession(state.server, state.fd))
+            return ESP_ERR_HTTPD_RESP_SEND;
+    }
+    response.body.append(buf, buf_len);
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_sendstr_chunk(httpd_req_t *r, const char *str)
+{
+    return httpd_resp_send_chunk(r, str, str ? strlen(str) : 0);
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status)
+{
+    stateOf(r).response->status = atoi(status);
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type)
+{
+    stateOf(r).response->headers["Content-Type"] = type;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *r, const char *field, const char *value)
+{
+    stateOf(r).response->headers[field] = value;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t *req, httpd_err_code_t error, const char *msg)
+{
+    const char *status = statusOf(error);
+    httpd_resp_set_status(req, status);
+    httpd_resp_set_type(req, "text/html");
+    return httpd_resp_send(req, msg ? msg : status, HTTPD_RESP_USE_STRLEN);
+}
+
+esp_err_t httpd_resp_send_408(httpd_req_t *r)
+{
+    return httpd_resp_send_err(r, HTTPD_408_REQ_TIMEOUT, nullptr);
+}
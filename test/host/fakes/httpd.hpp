@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Clients of esp_http_server.
+ * Server handles requests and queued work on its own "httpd" task, one at a time like the real one.
+ * Sessions stay open after response until client closes them or firmware triggers close.
+ */
+namespace fake
+{
+    namespace httpd
+    {
+        struct Request
+        {
+            int method = 1; //!< HTTP_GET.
+            std::string uri;
+            std::string body;
+            long contentLength = -1; //!< Declared length, longer than body makes recv time out.
+            size_t recvChunk = 0;    //!< Max bytes per httpd_req_recv(), 0 for no limit.
+        };
+
+        struct Response
+        {
+            int status = 0; //!< 0 if server was stopped before responding.
+            std::map<std::string, std::string> headers;
+            std::string body;
+            bool chunked = false;
+            int fd = -1; //!< Session socket.
+        };
+
+        Response request(const Request &req, uint32_t timeoutMs = 5000);
+        Response get(const std::string &uri);
+        Response post(const std::string &uri, const std::string &body);
+
+        /**
+         * @brief Check whether some server runs.
+         */
+        bool running();
+
+        /**
+         * @brief Read and consume bytes firmware wrote straight to session socket.
+         */
+        std::string read(int fd);
+
+        /**
+         * @brief Limit unread bytes session socket takes, models slow client.
+         */
+        void setCapacity(int fd, size_t bytes);
+
+        /**
+         * @brief Close session from client side.
+         */
+        void close(int fd);
+
+        /**
+         * @brief Check whether session socket is still open.
+         */
+        bool isOpen(int fd);
+
+        /**
+         * @brief Check whether firmware closed the socket with close().
+         */
+        bool closedByFirmware(int fd);
+
+        /**
+         * @brief Wait until server task is idle.
+         */
+        bool drain(uint32_t timeoutMs = 1000);
+    }
+}
@@ -0,0 +1,390 @@
+#include "i2c.hpp"
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "host.hpp"
+#include "gpio.hpp"
+#include "driver/i2c.h"
+
+namespace
+{
+    struct Command
+    {
+        enum Type
+        {
+            START,
+            WRITE,
+            READ,
+            STOP
+        } type;
+        std::vector<uint8_t> bytes; //!< WRITE payload.
+        uint8_t *dest;              //!< READ destination.
+        size_t len;
+    };
+
+    struct Link
+    {
+        std::vector<Command> commands;
+        size_t capacity;
+        size_t used;
+        bool isStatic;
+    };
+
+    const size_t linkCost = I2C_INTERNAL_STRUCT_SIZE; //!< Bytes of link storage taken by link itself and by each command.
+
+    std::mutex mutex;
+    std::map<uint8_t, fake::i2c::Device *> devices;
+    std::map<uint8_t, uint32_t> clocks;
+    bool installed = false;
+    i2c_config_t busConfig;
+    uint32_t configCount = 0;
+    uint32_t transactionCount = 0;
+    esp_err_t injectedError = ESP_OK;
+    int injectedCount = 0;
+    std::atomic<int> sdaHeldPulses{0};
+    std::atomic<int> staticLinks{0};
+    std::atomic<uint32_t> overlapCount{0};
+    int lastScl = 1;
+
+    esp_err_t add(i2c_cmd_handle_t handle, Command cmd)
+    {
+        Link *link = (Link *)handle;
+        if (link->used + linkCost > link->capacity)
+            return ESP_ERR_NO_MEM;
+        link->used += linkCost;
+        link->commands.push_back(std::move(cmd));
+        return ESP_OK;
+    }
+
+    /**
+     * @brief Run link against attached slaves, caller holds mutex.
+     */
+    esp_err_t execute(const Link &link)
+    {
+        fake::i2c::Device *dev = nullptr;
+        bool expectAddress = false;
+        bool reading = false;
+        std::vector<uint8_t> written;
+
+        auto flush = [&]() -> bool {
+            bool ack = true;
+            if (dev && !reading && !written.empty())
+                ack = dev->write(written.data(), written.size());
+            written.clear();
+            return ack;
+        };
+
+        for (const Command &cmd : link.commands)
+        {
+            switch (cmd.type)
+            {
+            case Command::START:
+                if (!flush())
+                    return ESP_FAIL;
+                expectAddress = true;
+                break;
+            case Command::WRITE:
+            {
+                size_t i = 0;
+                if (expectAddress)
+                {
+                    uint8_t addr = cmd.bytes[0];
+                    auto it = devices.find(addr & 0xFE);
+                    if (it == devices.end())
+                        return ESP_FAIL;
+                    dev = it->second;
+                    clocks[addr & 0xFE] = busConfig.master.clk_speed;
+                    reading = addr & 1;
+                    expectAddress = false;
+                    i = 1;
+                }
+                if (reading && i < cmd.bytes.size())
+                    return ESP_ERR_INVALID_STATE; // Master writes while slave transmits.
+                written.insert(written.end(), cmd.bytes.begin() + i, cmd.bytes.end());
+                break;
+            }
+            case Command::READ:
+                if (!dev || !reading)
+                    return ESP_ERR_INVALID_STATE;
+                dev->read(cmd.dest, cmd.len);
+                break;
+            case Command::STOP:
+                if (!flush())
+                    return ESP_FAIL;
+                dev = nullptr;
+                break;
+            }
+        }
+        return ESP_OK;
+    }
+
+    void sclWritten(int level)
+    {
+        if (level && !lastScl && sdaHeldPulses > 0 && --sdaHeldPulses == 0)
+            fake::gpio::drive((gpio_num_t)busConfig.sda_io_num, -1);
+        lastScl = level;
+    }
+}
+
+void fake::i2c::attach(uint8_t addr, Device *dev)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    devices[addr] = dev;
+}
+
+void fake::i2c::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    devices.clear();
+    clocks.clear();
+    injectedError = ESP_OK;
+    injectedCount = 0;
+    transactionCount = 0;
+    configCount = 0;
+    sdaHeldPulses = 0;
+    overlapCount = 0;
+}
+
+void fake::i2c::failNext(esp_err_t err, int count)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    injectedError = err;
+    injectedCount = count;
+}
+
+void fake::i2c::holdSda(int pulses)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    sdaHeldPulses = pulses;
+    lastScl = 1;
+    fake::gpio::drive((gpio_num_t)busConfig.sda_io_num, 0);
+    fake::gpio::onWrite((gpio_num_t)busConfig.scl_io_num, sclWritten);
+}
+
+uint32_t fake::i2c::transactions()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return transactionCount;
+}
+
+uint32_t fake::i2c::lastClock(uint8_t addr)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = clocks.find(addr);
+    return it == clocks.end() ? 0 : it->second;
+}
+
+uint32_t fake::i2c::configs()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return configCount;
+}
+
+uint32_t fake::i2c::overlaps()
+{
+    return overlapCount;
+}
+
+esp_err_t i2c_driver_install(i2c_port_t i2c_num, i2c_mode_t mode, size_t slv_rx_buf_len, size_t slv_tx_buf_len, int intr_alloc_flags)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (installed)
+        return ESP_FAIL;
+    installed = true;
+    return ESP_OK;
+}
+
+esp_err_t i2c_driver_delete(i2c_port_t i2c_num)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    installed = false;
+    return ESP_OK;
+}
+
+esp_err_t i2c_param_config(i2c_port_t i2c_num, const i2c_config_t *i2c_conf)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    busConfig = *i2c_conf;
+    configCount++;
+    return ESP_OK;
+}
+
+i2c_cmd_handle_t i2c_cmd_link_create(void)
+{
+    return new Link{{}, SIZE_MAX, 0, false};
+}
+
+i2c_cmd_handle_t i2c_cmd_link_create_static(uint8_t *buffer, uint32_t size)
+{
+    // Real link lives in the buffer, here the buffer only limits its size.
+    if (buffer == nullptr || size < linkCost)
+        return nullptr;
+    if (staticLinks++ > 0)
+        overlapCount++;
+    return new Link{{}, size, linkCost, true};
+}
+
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd_handle)
+{
+    delete (Link *)cmd_handle;
+}
+
+void i2c_cmd_link_delete_static(i2c_cmd_handle_t cmd_handle)
+{
+    staticLinks--;
+    delete (Link *)cmd_handle;
+}
+
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd_handle)
+{
+    return add(cmd_handle, {Command::START, {}, nullptr, 0});
+}
+
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd_handle, uint8_t data, bool ack_en)
+{
+    return add(cmd_handle, {Command::WRITE, {data}, nullptr, 1});
+}
+
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd_handle, const uint8_t *data, size_t data_len, bool ack_en)
+{
+    return add(cmd_handle, {Command::WRITE, std::vector<uint8_t>(data, data + data_len), nullptr, data_len});
+}
+
+esp_err_t i2c_master_read_byte(i2c_cmd_handle_t cmd_handle, uint8_t *data, i2c_ack_type_t ack)
+{
+    return add(cmd_handle, {Command::READ, {}, data, 1});
+}
+
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd_handle, uint8_t *data, size_t data_len, i2c_ack_type_t ack)
+{
+    if (data_len == 0)
+        return ESP_ERR_INVALID_ARG;
+    return add(cmd_handle, {Command::READ, {}, data, data_len});
+}
+
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd_handle)
+{
+    return add(cmd_handle, {Command::STOP, {}, nullptr, 0});
+}
+
+esp_err_t i2c_master_cmd_begin(i2c_port_t i2c_num, i2c_cmd_handle_t cmd_handle, TickType_t ticks_to_wait)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!installed)
+        return ESP_ERR_INVALID_STATE;
+
+    transactionCount++;
+    if (injectedCount > 0)
+    {
+        injectedCount--;
+        return injectedError;
+    }
+
+    // Master can't even generate start condition while slave holds SDA.
+    if (sdaHeldPulses > 0)
+        return ESP_ERR_TIMEOUT;
+
+    return execute(*(Link *)cmd_handle);
+}
+
+namespace
+{
+    const uint8_t CALIBRATION = 0xAA;
+    const uint8_t ID = 0xD0;
+    const uint8_t SOFT_RESET = 0xE0;
+    const uint8_t CTRL_MEAS = 0xF4;
+    const uint8_t OUT_MSB = 0xF6;
+
+    // Datasheet example calibration.
+    const int32_t exampleCalibration[] = {408, -72, -14383, 32741, 32757, 23153, 6190, 4, -32768, -8711, 2868};
+}
+
+fake::i2c::Bmp180::Bmp180()
+{
+    for (size_t i = 0; i < sizeof(exampleCalibration) / sizeof(exampleCalibration[0]); i++)
+    {
+        uint16_t w = (uint16_t)exampleCalibration[i];
+        regs[CALIBRATION + 2 * i] = w >> 8;
+        regs[CALIBRATION + 2 * i + 1] = w & 0xFF;
+    }
+    regs[ID] = 0x55;
+}
+
+bool fake::i2c::Bmp180::write(const uint8_t *data, size_t len)
+{
+    pointer = data[0];
+    for (size_t i = 1; i < len; i++)
+    {
+        uint8_t reg = pointer++;
+        if (reg == CTRL_MEAS)
+            startConversion(data[i]);
+        else if (reg == SOFT_RESET && data[i] == 0xB6)
+            readyAt = 0;
+    }
+    return true;
+}
+
+void fake::i2c::Bmp180::read(uint8_t *data, size_t len)
+{
+    if (pointer >= OUT_MSB && pointer <= OUT_MSB + 2)
+    {
+        if (nowUs() < readyAt)
+            early++;
+        else
+            latchResult();
+    }
+
+    for (size_t i = 0; i < len; i++)
+        data[i] = regs[(uint8_t)(pointer + i)];
+}
+
+void fake::i2c::Bmp180::setRaw(int32_t ut, int32_t up)
+{
+    this->ut = ut;
+    this->up = up;
+}
+
+uint32_t fake::i2c::Bmp180::earlyReads() const
+{
+    return early;
+}
+
+uint32_t fake::i2c::Bmp180::conversions() const
+{
+    return started;
+}
+
+void fake::i2c::Bmp180::startConversion(uint8_t ctrl)
+{
+    static const int64_t pressureUs[] = {4500, 7500, 13500, 25500};
+
+    latchResult(); // Previous conversion, if done, stays readable until this one ends.
+    regs[CTRL_MEAS] = ctrl;
+    started++;
+
+    if (ctrl == 0x2E)
+    {
+        readyAt = nowUs() + 4500;
+        pendingMsb = ut >> 8;
+        pendingLsb = ut & 0xFF;
+        pendingXlsb = 0;
+        return;
+    }
+
+    uint8_t oss = ctrl >> 6;
+    readyAt = nowUs() + pressureUs[oss];
+    int32_t raw = up << (8 - oss);
+    pendingMsb = raw >> 16;
+    pendingLsb = (raw >> 8) & 0xFF;
+    pendingXlsb = raw & 0xFF;
+}
+
+void fake::i2c::Bmp180::latchResult()
+{
+    if (readyAt == 0 || nowUs() < readyAt)
+        return;
+    regs[OUT_MSB] = pendingMsb;
+    regs[OUT_MSB + 1] = pendingLsb;
+    regs[OUT_MSB + 2] = pendingXlsb;
+}
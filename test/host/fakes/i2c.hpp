@@ -0,0 +1,126 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "esp_err.h"
+
+/**
+ * @brief I2C bus with register model slaves.
+ * Command links are recorded and executed on i2c_master_cmd_begin() against attached devices.
+ */
+namespace fake
+{
+    namespace i2c
+    {
+        /**
+         * @brief Slave with register pointer, the usual layout of sensors.
+         */
+        class Device
+        {
+        public:
+            virtual ~Device() {}
+
+            /**
+             * @brief Master wrote bytes, first one is register pointer.
+             * @return False to NACK.
+             */
+            virtual bool write(const uint8_t *data, size_t len) = 0;
+
+            /**
+             * @brief Master reads bytes from current register pointer.
+             */
+            virtual void read(uint8_t *data, size_t len) = 0;
+        };
+
+        /**
+         * @brief Attach slave to bus.
+         * @param addr 8 bit address with R/W bit clear.
+         * @param dev Slave, not owned.
+         */
+        void attach(uint8_t addr, Device *dev);
+
+        /**
+         * @brief Detach all slaves and clear faults and counters.
+         */
+        void reset();
+
+        /**
+         * @brief Fail next transactions without touching slaves.
+         * @param err ESP_FAIL for NACK or ESP_ERR_TIMEOUT for stuck bus.
+         * @param count Number of transactions to fail.
+         */
+        void failNext(esp_err_t err, int count = 1);
+
+        /**
+         * @brief Make slave hold SDA low until it gets given number of SCL pulses.
+         * Transactions time out meanwhile, like when slave was reset in middle of byte.
+         * @param pulses Rising edges of SCL driven by firmware while SDA is held.
+         */
+        void holdSda(int pulses);
+
+        /**
+         * @brief Get number of executed transactions.
+         */
+        uint32_t transactions();
+
+        /**
+         * @brief Get clock of each transaction to given slave, 0 if none.
+         */
+        uint32_t lastClock(uint8_t addr);
+
+        /**
+         * @brief Get number of i2c_param_config() calls.
+         */
+        uint32_t configs();
+
+        /**
+         * @brief Get number of static command links created while another one was still alive,
+         * i.e. two tasks building transactions in the same link storage at once.
+         */
+        uint32_t overlaps();
+
+        /**
+         * @brief Datasheet model of BMP180.
+         * Conversion started by CTRL_MEAS takes its datasheet time,
+         * result registers hold previous result until then.
+         */
+        class Bmp180 : public Device
+        {
+        public:
+            static const uint8_t address = 0xEE;
+
+            Bmp180();
+
+            bool write(const uint8_t *data, size_t len) override;
+            void read(uint8_t *data, size_t len) override;
+
+            /**
+             * @brief Set raw values the next conversions produce.
+             * Defaults are the datasheet example (UT 27898, UP 23843 at oss 0),
+             * which compensate to 15.0 °C and 69965 Pa (datasheet rounds to 69964).
+             */
+            void setRaw(int32_t ut, int32_t up);
+
+            /**
+             * @brief Get number of result reads made before conversion was done.
+             */
+            uint32_t earlyReads() const;
+
+            /**
+             * @brief Get number of conversions started.
+             */
+            uint32_t conversions() const;
+
+        private:
+            uint8_t regs[256] = {};
+            uint8_t pointer = 0;
+            int64_t readyAt = 0;
+            uint8_t pendingMsb = 0, pendingLsb = 0, pendingXlsb = 0;
+            int32_t ut = 27898, up = 23843;
+            uint32_t early = 0;
+            uint32_t started = 0;
+
+            void startConversion(uint8_t ctrl);
+            void latchResult();
+        };
+    }
+}
@@ -0,0 +1,385 @@
+#include "mqtt.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <set>
+#include "host.hpp"
+#include "mqtt_client.h"
+
+ESP_EVENT_DEFINE_BASE(MQTT_EVENTS);
+
+struct esp_mqtt_client
+{
+    std::string host;
+    uint32_t port;
+    std::string username;
+    std::string password;
+    esp_event_handler_t handler = nullptr;
+    void *handlerArg = nullptr;
+    std::unique_ptr<fake::Worker> task;
+    bool started = false;
+    bool connected = false;
+    int nextMsgId = 1;
+    std::set<std::string> subscriptions;
+};
+
+namespace
+{
+    const size_t clientHeap = 8 * 1024; //!< Client struct, task stack and buffers.
+    const int64_t reconnectUs = 100000;
+    const int64_t latencyUs = 500;
+
+    std::mutex mutex;
+    std::set<esp_mqtt_client_handle_t> clients;
+    std::vector<fake::broker::Message> published;
+    bool online = true;
+    int failPublishes = 0;
+    bool acksHeld = false;
+    std::vector<std::pair<esp_mqtt_client_handle_t, int>> heldAcks;
+    std::string lastHost, lastUsername;
+    uint32_t lastPort = 0;
+
+    bool topicMatches(const std::string &filter, const std::string &topic)
+    {
+        size_t f = 0, t = 0;
+        while (f < filter.size())
+        {
+            if (filter[f] == '#')
+                return true;
+            if (filter[f] == '+')
+            {
+                while (t < topic.size() && topic[t] != '/')
+                    t++;
+                f++;
+                continue;
+            }
+            if (t >= topic.size() || filter[f] != topic[t])
+                return false;
+            f++;
+            t++;
+        }
+        return t == topic.size();
+    }
+
+    /**
+     * @brief Deliver event on client's task, caller holds mutex.
+     */
+    void post(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t id, int msgId = 0,
+              std::shared_ptr<std::string> topic = nullptr, std::shared_ptr<std::string> data = nullptr,
+              int offset = 0, int len = 0)
+    {
+        client->task->after(latencyUs, [=]() {
+            esp_mqtt_event_t event = {};
+            event.event_id = id;
+            event.client = client;
+            event.msg_id = msgId;
+            if (data)
+            {
+                event.topic = offset == 0 ? &(*topic)[0] : nullptr;
+                event.topic_len = offset == 0 ? topic->size() : 0;
+                event.data = &(*data)[offset];
+                event.data_len = len;
+                event.total_data_len = data->size();
+                event.current_data_offset = offset;
+            }
+            if (client->handler)
+                client->handler(client->handlerArg, MQTT_EVENTS, id, &event);
+        });
+    }
+
+    void tryConnect(esp_mqtt_client_handle_t client)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!client->started || client->connected)
+            return;
+
+        if (!online)
+        {
+            client->task->after(reconnectUs, [client] { tryConnect(client); });
+            return;
+        }
+
+        client->connected = true;
+        client->subscriptions.clear();
+        post(client, MQTT_EVENT_CONNECTED);
+    }
+
+    void drop(esp_mqtt_client_handle_t client)
+    {
+        if (!client->connected)
+            return;
+        client->connected = false;
+        post(client, MQTT_EVENT_DISCONNECTED);
+        client->task->after(reconnectUs, [client] { tryConnect(client); });
+    }
+}
+
+void fake::broker::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    online = true;
+    published.clear();
+    failPublishes = 0;
+    acksHeld = false;
+    heldAcks.clear();
+}
+
+void fake::broker::setOnline(bool up)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    online = up;
+    if (!up)
+    {
+        for (esp_mqtt_client_handle_t client : clients)
+            drop(client);
+    }
+}
+
+std::vector<fake::broker::Message> fake::broker::messages()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return published;
+}
+
+std::vector<fake::broker::Message> fake::broker::messages(const std::string &topic)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Message> result;
+    for (const Message &m : published)
+    {
+        if (m.topic == topic)
+            result.push_back(m);
+    }
+    return result;
+}
+
+void fake::broker::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    published.clear();
+}
+
+std::vector<fake::broker::Message> fake::broker::waitFor(const std::string &topic, size_t count, uint32_t timeoutMs)
+{
+    waitUntil([&] { return messages(topic).size() >= count; }, timeoutMs);
+    return messages(topic);
+}
+
+void fake::broker::inject(const std::string &topic, const std::string &payload, size_t fragment)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto topicCopy = std::make_shared<std::string>(topic);
+    auto data = std::make_shared<std::string>(payload);
+    if (fragment == 0 || fragment > payload.size())
+        fragment = payload.size();
+
+    for (esp_mqtt_client_handle_t client : clients)
+    {
+        if (!client->connected)
+            continue;
+        for (const std::string &filter : client->subscriptions)
+        {
+            if (!topicMatches(filter, topic))
+                continue;
+            size_t offset = 0;
+            do
+            {
+                size_t len = std::min(fragment, payload.size() - offset);
+                post(client, MQTT_EVENT_DATA, 0, topicCopy, data, offset, len);
+                offset += len;
+            } while (offset < payload.size());
+            break;
+        }
+    }
+}
+
+void fake::broker::failNextPublishes(int count)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    failPublishes = count;
+}
+
+void fake::broker::holdAcks(bool hold)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    acksHeld = hold;
+    if (hold)
+        return;
+
+    for (auto &ack : heldAcks)
+    {
+        if (clients.count(ack.first) && ack.first->connected)
+            post(ack.first, MQTT_EVENT_PUBLISHED, ack.second);
+    }
+    heldAcks.clear();
+}
+
+int fake::broker::connectedClients()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    int count = 0;
+    for (esp_mqtt_client_handle_t client : clients)
+        count += client->connected;
+    return count;
+}
+
+int fake::broker::liveClients()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return clients.size();
+}
+
+std::string fake::broker::lastHost()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return ::lastHost;
+}
+
+uint32_t fake::broker::lastPort()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return ::lastPort;
+}
+
+std::string fake::broker::lastUsername()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return ::lastUsername;
+}
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config)
+{
+    esp_mqtt_client_handle_t client = new esp_mqtt_client;
+    client->host = config->host ? config->host : "";
+    client->port = config->port ? config->port : 1883;
+    client->username = config->username ? config->username : "";
+    client->password = config->password ? config->password : "";
+    client->task.reset(new fake::Worker("mqtt_task"));
+    fake::heap::charge(clientHeap);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    clients.insert(client);
+    lastHost = client->host;
+    lastPort = client->port;
+    lastUsername = client->username;
+    return client;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event, esp_event_handler_t event_handler, void *event_handler_arg)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    client->handler = event_handler;
+    client->handlerArg = event_handler_arg;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (client->started)
+            return ESP_FAIL;
+        client->started = true;
+    }
+    client->task->after(latencyUs, [client] { tryConnect(client); });
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client)
+{
+    if (client->task->isCurrent())
+    {
+        fprintf(stderr, "esp_mqtt_client_stop() called from client's own task\n");
+        abort();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    client->started = false;
+    client->connected = false;
+    client->task->cancelAll();
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_disconnect(esp_mqtt_client_handle_t client)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    client->started = false;
+    client->connected = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t client)
+{
+    if (client == nullptr)
+        return ESP_ERR_INVALID_ARG;
+
+    // Real client waits for its task to exit, which never happens if the task itself waits.
+    if (client->task->isCurrent())
+    {
+        fprintf(stderr, "esp_mqtt_client_destroy() called from client's own task, deadlock on device\n");
+        abort();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        clients.erase(client);
+        client->started = false;
+        client->connected = false;
+    }
+
+    delete client; // Joins client task.
+    fake::heap::release(clientHeap);
+    return ESP_OK;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos, int retain)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!client->connected)
+        return -1;
+    if (failPublishes > 0)
+    {
+        failPublishes--;
+        return -1;
+    }
+
+    if (len == 0 && data)
+        len = strlen(data);
+    published.push_back({topic, std::string(data ? data : "", len), qos});
+
+    if (qos == 0)
+        return 0;
+
+    int msgId = client->nextMsgId++;
+    if (acksHeld)
+        heldAcks.push_back({client, msgId});
+    else
+        post(client, MQTT_EVENT_PUBLISHED, msgId);
+    return msgId;
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!client->connected)
+        return -1;
+
+    client->subscriptions.insert(topic);
+    int msgId = client->nextMsgId++;
+    post(client, MQTT_EVENT_SUBSCRIBED, msgId);
+    return msgId;
+}
+
+int esp_mqtt_client_unsubscribe(esp_mqtt_client_handle_t client, const char *topic)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!client->connected)
+        return -1;
+
+    client->subscriptions.erase(topic);
+    int msgId = client->nextMsgId++;
+    post(client, MQTT_EVENT_UNSUBSCRIBED, msgId);
+    return msgId;
+}
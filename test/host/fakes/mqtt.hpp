@@ -0,0 +1,83 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Loopback broker for esp_mqtt clients.
+ * Each client has own thread delivering its events like the client task does,
+ * so firmware handlers run concurrently with firmware tasks as on the device.
+ */
+namespace fake
+{
+    namespace broker
+    {
+        struct Message
+        {
+            std::string topic;
+            std::string payload;
+            int qos;
+        };
+
+        /**
+         * @brief Disconnect all clients and forget messages, broker comes back online.
+         */
+        void reset();
+
+        /**
+         * @brief Take broker down or bring it up, clients reconnect every 100 ms while it's down.
+         */
+        void setOnline(bool online);
+
+        /**
+         * @brief Get messages published by clients so far.
+         */
+        std::vector<Message> messages();
+
+        /**
+         * @brief Get messages published to topic so far.
+         */
+        std::vector<Message> messages(const std::string &topic);
+
+        void clear();
+
+        /**
+         * @brief Wait until at least count messages were published to topic.
+         * @return Messages on the topic.
+         */
+        std::vector<Message> waitFor(const std::string &topic, size_t count = 1, uint32_t timeoutMs = 2000);
+
+        /**
+         * @brief Publish message to subscribed clients.
+         * @param fragment Max bytes delivered per DATA event, 0 delivers whole message at once.
+         */
+        void inject(const std::string &topic, const std::string &payload, size_t fragment = 0);
+
+        /**
+         * @brief Reject next publishes of clients, esp_mqtt_client_publish() returns -1.
+         */
+        void failNextPublishes(int count);
+
+        /**
+         * @brief Hold back acknowledges (PUBLISHED events) of QoS 1 messages.
+         */
+        void holdAcks(bool hold);
+
+        /**
+         * @brief Get number of clients connected right now.
+         */
+        int connectedClients();
+
+        /**
+         * @brief Get number of clients created and not yet destroyed.
+         */
+        int liveClients();
+
+        /**
+         * @brief Get host and port the last created client connects to.
+         */
+        std::string lastHost();
+        uint32_t lastPort();
+        std::string lastUsername();
+    }
+}
@@ -0,0 +1,265 @@
+#include "nvs.hpp"
+#include <cstring>
+#include <map>
+#include <mutex>
+#include "nvs_flash.h"
+
+namespace
+{
+    enum class Type
+    {
+        U8,
+        U32,
+        STR,
+        BLOB
+    };
+
+    struct Entry
+    {
+        Type type;
+        std::vector<uint8_t> bytes;
+    };
+
+    struct Handle
+    {
+        std::string ns;
+        bool writable;
+    };
+
+    const size_t maxKeyLength = 15;
+    const size_t maxNameLength = 15;
+
+    std::mutex mutex;
+    std::map<std::string, std::map<std::string, Entry>> storage;
+    std::map<nvs_handle_t, Handle> handles;
+    nvs_handle_t nextHandle = 1;
+    bool initialized = false;
+    uint32_t writeCount = 0;
+
+    esp_err_t set(nvs_handle_t handle, const char *key, Type type, const void *value, size_t length)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = handles.find(handle);
+        if (it == handles.end())
+            return ESP_ERR_NVS_INVALID_HANDLE;
+        if (!it->second.writable)
+            return ESP_ERR_NVS_READ_ONLY;
+        if (strlen(key) > maxKeyLength)
+            return ESP_ERR_NVS_KEY_TOO_LONG;
+
+        const uint8_t *bytes = (const uint8_t *)value;
+        storage[it->second.ns][key] = {type, std::vector<uint8_t>(bytes, bytes + length)};
+        writeCount++;
+        return ESP_OK;
+    }
+
+    esp_err_t get(nvs_handle_t handle, const char *key, Type type, Entry &out)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = handles.find(handle);
+        if (it == handles.end())
+            return ESP_ERR_NVS_INVALID_HANDLE;
+        if (strlen(key) > maxKeyLength)
+            return ESP_ERR_NVS_KEY_TOO_LONG;
+
+        auto &entries = storage[it->second.ns];
+        auto entry = entries.find(key);
+        if (entry == entries.end() || entry->second.type != type)
+            return ESP_ERR_NVS_NOT_FOUND;
+        out = entry->second;
+        return ESP_OK;
+    }
+
+    /**
+     * @brief Variable length get, copies value or only reports its length if out is null.
+     */
+    esp_err_t getVariable(nvs_handle_t handle, const char *key, Type type, void *out, size_t *length)
+    {
+        Entry entry;
+        esp_err_t err = get(handle, key, type, entry);
+        if (err != ESP_OK)
+            return err;
+
+        if (out == nullptr)
+        {
+            *length = entry.bytes.size();
+            return ESP_OK;
+        }
+        if (*length < entry.bytes.size())
+        {
+            *length = entry.bytes.size();
+            return ESP_ERR_NVS_INVALID_LENGTH;
+        }
+        memcpy(out, entry.bytes.data(), entry.bytes.size());
+        *length = entry.bytes.size();
+        return ESP_OK;
+    }
+}
+
+void fake::nvs::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    storage.clear();
+    writeCount = 0;
+}
+
+void fake::nvs::setStr(const std::string &ns, const std::string &key, const std::string &value)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    const char *s = value.c_str();
+    storage[ns][key] = {Type::STR, std::vector<uint8_t>(s, s + value.size() + 1)};
+}
+
+void fake::nvs::setU8(const std::string &ns, const std::string &key, uint8_t value)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    storage[ns][key] = {Type::U8, {value}};
+}
+
+void fake::nvs::setBlob(const std::string &ns, const std::string &key, const std::vector<uint8_t> &value)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    storage[ns][key] = {Type::BLOB, value};
+}
+
+std::vector<uint8_t> fake::nvs::getBlob(const std::string &ns, const std::string &key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto n = storage.find(ns);
+    if (n == storage.end())
+        return {};
+    auto e = n->second.find(key);
+    return e == n->second.end() ? std::vector<uint8_t>() : e->second.bytes;
+}
+
+bool fake::nvs::has(const std::string &ns, const std::string &key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto n = storage.find(ns);
+    return n != storage.end() && n->second.count(key);
+}
+
+uint32_t fake::nvs::writes()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return writeCount;
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    initialized = true;
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    storage.clear();
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!initialized)
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    if (strlen(name) > maxNameLength)
+        return ESP_ERR_NVS_INVALID_NAME;
+
+    // Read only open doesn't create namespace.
+    if (open_mode == NVS_READONLY && !storage.count(name))
+        return ESP_ERR_NVS_NOT_FOUND;
+
+    storage[name];
+    handles[nextHandle] = {name, open_mode == NVS_READWRITE};
+    *out_handle = nextHandle++;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    handles.erase(handle);
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return handles.count(handle) ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = handles.find(handle);
+    if (it == handles.end())
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!it->second.writable)
+        return ESP_ERR_NVS_READ_ONLY;
+    if (!storage[it->second.ns].erase(key))
+        return ESP_ERR_NVS_NOT_FOUND;
+    writeCount++;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = handles.find(handle);
+    if (it == handles.end())
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    if (!it->second.writable)
+        return ESP_ERR_NVS_READ_ONLY;
+    storage[it->second.ns].clear();
+    writeCount++;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char *key, uint8_t value)
+{
+    return set(handle, key, Type::U8, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char *key, uint8_t *out_value)
+{
+    Entry entry;
+    esp_err_t err = get(handle, key, Type::U8, entry);
+    if (err == ESP_OK)
+        *out_value = entry.bytes[0];
+    return err;
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+    return set(handle, key, Type::U32, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value)
+{
+    Entry entry;
+    esp_err_t err = get(handle, key, Type::U32, entry);
+    if (err == ESP_OK)
+        memcpy(out_value, entry.bytes.data(), sizeof(*out_value));
+    return err;
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value)
+{
+    return set(handle, key, Type::STR, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out_value, size_t *length)
+{
+    return getVariable(handle, key, Type::STR, out_value, length);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    return set(handle, key, Type::BLOB, value, length);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    return getVariable(handle, key, Type::BLOB, out_value, length);
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief In memory NVS, content survives "reboots" of modules within one test process.
+ */
+namespace fake
+{
+    namespace nvs
+    {
+        /**
+         * @brief Erase everything, NVS stays initialized.
+         */
+        void reset();
+
+        void setStr(const std::string &ns, const std::string &key, const std::string &value);
+        void setU8(const std::string &ns, const std::string &key, uint8_t value);
+        void setBlob(const std::string &ns, const std::string &key, const std::vector<uint8_t> &value);
+
+        /**
+         * @brief Get stored blob, empty if key is missing.
+         */
+        std::vector<uint8_t> getBlob(const std::string &ns, const std::string &key);
+
+        bool has(const std::string &ns, const std::string &key);
+
+        /**
+         * @brief Get number of successful set and erase calls made by firmware.
+         */
+        uint32_t writes();
+    }
+}
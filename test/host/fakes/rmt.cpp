@@ -0,0 +1,217 @@
+#include "dht11.hpp"
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "host.hpp"
+#include "gpio.hpp"
+
+namespace
+{
+    struct Channel
+    {
+        gpio_num_t pin = GPIO_NUM_NC;
+        uint16_t idleThreshold = 0;
+        RingbufHandle_t rxBuffer = nullptr;
+        bool receiving = false;
+    };
+
+    std::mutex mutex;
+    Channel channels[RMT_CHANNEL_MAX];
+
+    // State of the single modelled sensor.
+    gpio_num_t sensorPin = GPIO_NUM_NC;
+    rmt_channel_t sensorChannel = RMT_CHANNEL_0;
+    uint8_t sensorHumidity = 45;
+    uint8_t sensorTemperature = 21;
+    fake::Dht11::Mode sensorMode = fake::Dht11::Mode::OK;
+    int64_t lowSince = -1;
+    std::atomic<uint32_t> responseCount{0};
+    std::atomic<uint32_t> badStartCount{0};
+    fake::Worker *sensorWorker = nullptr;
+
+    const int64_t minStartSignalUs = 18000;
+    const int64_t frameUs = 4500; //!< Response + 40 bits, the receiver reports frame after it.
+
+    /**
+     * @brief Build RMT items of sensor answer, starting at release of the line.
+     */
+    std::vector<rmt_item32_t> waveform(uint8_t humidity, uint8_t temperature, bool badChecksum)
+    {
+        uint8_t checksum = humidity + temperature + (badChecksum ? 1 : 0);
+        uint64_t frame = ((uint64_t)humidity << 32) | ((uint64_t)temperature << 16) | checksum;
+
+        // Line levels in order, pull up keeps it high 30 us before sensor answers.
+        std::vector<std::pair<int, int>> pulses = {{1, 30}, {0, 80}, {1, 80}};
+        for (int bit = 39; bit >= 0; bit--)
+        {
+            pulses.push_back({0, 50});
+            pulses.push_back({1, (frame >> bit) & 1 ? 70 : 26});
+        }
+        pulses.push_back({0, 50});
+
+        std::vector<rmt_item32_t> items;
+        for (size_t i = 0; i < pulses.size(); i += 2)
+        {
+            rmt_item32_t item;
+            item.val = 0;
+            item.level0 = pulses[i].first;
+            item.duration0 = pulses[i].second;
+            if (i + 1 < pulses.size())
+            {
+                item.level1 = pulses[i + 1].first;
+                item.duration1 = pulses[i + 1].second;
+            }
+            else
+            {
+                item.level1 = 1; // Zero length end marker.
+            }
+            items.push_back(item);
+        }
+        return items;
+    }
+
+    void respond()
+    {
+        std::vector<rmt_item32_t> items;
+        RingbufHandle_t rxBuffer;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (sensorMode == fake::Dht11::Mode::NO_RESPONSE)
+                return;
+            items = waveform(sensorHumidity, sensorTemperature, sensorMode == fake::Dht11::Mode::BAD_CHECKSUM);
+            Channel &ch = channels[sensorChannel];
+            if (!ch.receiving)
+                return;
+            rxBuffer = ch.rxBuffer;
+        }
+        responseCount++;
+        xRingbufferSend(rxBuffer, items.data(), items.size() * sizeof(rmt_item32_t), 0);
+    }
+}
+
+fake::Dht11::Dht11(gpio_num_t pin, rmt_channel_t channel)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        sensorPin = pin;
+        sensorChannel = channel;
+        sensorMode = Mode::OK;
+        lowSince = -1;
+    }
+    responseCount = 0;
+    badStartCount = 0;
+    if (!sensorWorker)
+        sensorWorker = new Worker("dht11"); // Leaked, firmware timers may still run at exit.
+    fake::gpio::onWrite(pin, [this](int level) { lineWritten(level); });
+}
+
+fake::Dht11::~Dht11()
+{
+    fake::gpio::onWrite(sensorPin, nullptr);
+    sensorWorker->cancelAll();
+}
+
+void fake::Dht11::set(uint8_t humidity, uint8_t temperature)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    sensorHumidity = humidity;
+    sensorTemperature = temperature;
+}
+
+void fake::Dht11::setMode(Mode mode)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    sensorMode = mode;
+}
+
+uint32_t fake::Dht11::responses() const
+{
+    return responseCount;
+}
+
+uint32_t fake::Dht11::badStartSignals() const
+{
+    return badStartCount;
+}
+
+void fake::Dht11::lineWritten(int level)
+{
+    // Writes to a pin that doesn't drive the line (e.g. left as input by rmt_config()) don't count.
+    if (level == 0)
+    {
+        if (fake::gpio::line(sensorPin) == 0)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (lowSince < 0)
+                lowSince = nowUs();
+        }
+        return;
+    }
+
+    bool valid;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (lowSince < 0)
+            return;
+        valid = nowUs() - lowSince >= minStartSignalUs && channels[sensorChannel].receiving;
+        lowSince = -1;
+    }
+
+    if (!valid)
+    {
+        badStartCount++;
+        return;
+    }
+    sensorWorker->after(frameUs, respond);
+}
+
+esp_err_t rmt_config(const rmt_config_t *rmt_param)
+{
+    if (rmt_param->channel >= RMT_CHANNEL_MAX || rmt_param->rmt_mode != RMT_MODE_RX)
+        return ESP_ERR_INVALID_ARG;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Channel &ch = channels[rmt_param->channel];
+        ch.pin = rmt_param->gpio_num;
+        ch.idleThreshold = rmt_param->rx_config.idle_threshold;
+    }
+
+    // Like the real driver, routing the pin to the receiver leaves it input only.
+    gpio_set_direction(rmt_param->gpio_num, GPIO_MODE_INPUT);
+    return ESP_OK;
+}
+
+esp_err_t rmt_driver_install(rmt_channel_t channel, size_t rx_buf_size, int intr_alloc_flags)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Channel &ch = channels[channel];
+    if (ch.rxBuffer)
+        return ESP_ERR_INVALID_STATE;
+    if (rx_buf_size)
+        ch.rxBuffer = xRingbufferCreate(rx_buf_size, RINGBUF_TYPE_NOSPLIT);
+    return ESP_OK;
+}
+
+esp_err_t rmt_get_ringbuf_handle(rmt_channel_t channel, RingbufHandle_t *buf_handle)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!channels[channel].rxBuffer)
+        return ESP_ERR_INVALID_STATE;
+    *buf_handle = channels[channel].rxBuffer;
+    return ESP_OK;
+}
+
+esp_err_t rmt_rx_start(rmt_channel_t channel, bool rx_idx_rst)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    channels[channel].receiving = true;
+    return ESP_OK;
+}
+
+esp_err_t rmt_rx_stop(rmt_channel_t channel)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    channels[channel].receiving = false;
+    return ESP_OK;
+}
@@ -0,0 +1,202 @@
+#include "host.hpp"
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_rom_crc.h"
+#include "esp_rom_sys.h"
+#include "esp_sleep.h"
+#include "esp_sntp.h"
+#include "newlib_compat.h"
+
+namespace
+{
+    struct ErrorName
+    {
+        esp_err_t code;
+        const char *name;
+    };
+
+    const ErrorName errorNames[] = {
+        {ESP_OK, "ESP_OK"},
+        {ESP_FAIL, "ESP_FAIL"},
+        {ESP_ERR_NO_MEM, "ESP_ERR_NO_MEM"},
+        {ESP_ERR_INVALID_ARG, "ESP_ERR_INVALID_ARG"},
+        {ESP_ERR_INVALID_STATE, "ESP_ERR_INVALID_STATE"},
+        {ESP_ERR_INVALID_SIZE, "ESP_ERR_INVALID_SIZE"},
+        {ESP_ERR_NOT_FOUND, "ESP_ERR_NOT_FOUND"},
+        {ESP_ERR_NOT_SUPPORTED, "ESP_ERR_NOT_SUPPORTED"},
+        {ESP_ERR_TIMEOUT, "ESP_ERR_TIMEOUT"},
+        {ESP_ERR_INVALID_RESPONSE, "ESP_ERR_INVALID_RESPONSE"},
+        {ESP_ERR_INVALID_CRC, "ESP_ERR_INVALID_CRC"},
+        {0x1102, "ESP_ERR_NVS_NOT_FOUND"},
+        {0x110c, "ESP_ERR_NVS_INVALID_LENGTH"},
+    };
+
+    std::mutex logMutex;
+    esp_log_level_t logLevel = ESP_LOG_WARN;
+
+    std::mutex randomMutex;
+    std::mt19937 randomGenerator(1); //!< Fixed seed keeps runs reproducible.
+
+    uint32_t crcTable[256];
+    bool crcTableReady = false;
+
+    void buildCrcTable()
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            crcTable[i] = c;
+        }
+        crcTableReady = true;
+    }
+
+    const char levelLetter[] = {'N', 'E', 'W', 'I', 'D', 'V'};
+
+    struct LogLevelFromEnv
+    {
+        LogLevelFromEnv()
+        {
+            // HOST_LOG=info shows the firmware's log while debugging a test.
+            const char *env = getenv("HOST_LOG");
+            if (!env)
+                return;
+            if (strcmp(env, "error") == 0)
+                logLevel = ESP_LOG_ERROR;
+            else if (strcmp(env, "info") == 0)
+                logLevel = ESP_LOG_INFO;
+            else if (strcmp(env, "debug") == 0)
+                logLevel = ESP_LOG_DEBUG;
+        }
+    } logLevelFromEnv;
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    for (const ErrorName &e : errorNames)
+    {
+        if (e.code == code)
+            return e.name;
+    }
+    return "UNKNOWN ERROR";
+}
+
+void _esp_error_check_failed(esp_err_t rc, const char *file, int line, const char *function, const char *expression)
+{
+    fprintf(stderr, "ESP_ERROR_CHECK failed: esp_err_t 0x%x (%s) at %s:%d\nfunc: %s\nexpression: %s\n",
+            rc, esp_err_to_name(rc), file, line, function, expression);
+    abort();
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    std::lock_guard<std::mutex> lock(logMutex);
+    logLevel = level;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    std::lock_guard<std::mutex> lock(logMutex);
+    if (level > logLevel)
+        return;
+
+    fprintf(stderr, "%c (%lld) %s: ", levelLetter[level], (long long)(fake::nowUs() / 1000), tag);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+uint32_t esp_random(void)
+{
+    std::lock_guard<std::mutex> lock(randomMutex);
+    return randomGenerator();
+}
+
+void esp_restart(void)
+{
+    fprintf(stderr, "esp_restart() called\n");
+    abort();
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len)
+{
+    static std::once_flag once;
+    std::call_once(once, buildCrcTable);
+
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++)
+        crc = crcTable[(crc ^ buf[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+void esp_rom_delay_us(uint32_t us)
+{
+    // Busy wait like the ROM function, sleeping would give up far more than us.
+    int64_t end = fake::nowUs() + us;
+    while (fake::nowUs() < end)
+    {
+    }
+}
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us)
+{
+    return ESP_OK;
+}
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause(void)
+{
+    return ESP_SLEEP_WAKEUP_UNDEFINED;
+}
+
+void esp_deep_sleep_start(void)
+{
+    fprintf(stderr, "esp_deep_sleep_start() called\n");
+    abort();
+}
+
+void sntp_setoperatingmode(uint8_t operating_mode)
+{
+}
+
+void sntp_setservername(uint8_t idx, const char *server)
+{
+}
+
+void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t callback)
+{
+}
+
+void sntp_init(void)
+{
+}
+
+#ifdef HOST_NEEDS_STRLCPY
+size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+    if (size)
+    {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = 0;
+    }
+    return len;
+}
+
+size_t strlcat(char *dst, const char *src, size_t size)
+{
+    size_t dstLen = strnlen(dst, size);
+    if (dstLen == size)
+        return size + strlen(src);
+    return dstLen + strlcpy(dst + dstLen, src, size - dstLen);
+}
+#endif
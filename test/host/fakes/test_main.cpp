@@ -0,0 +1,14 @@
+#include <cstdio>
+#include <unistd.h>
+#include <gtest/gtest.h>
+
+// Firmware tasks are detached threads that never return, like on the device.
+// Leave without running static destructors they might still be using.
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    int result = RUN_ALL_TESTS();
+    fflush(stdout);
+    fflush(stderr);
+    _exit(result);
+}
@@ -0,0 +1,449 @@
+#include "wifi.hpp"
+#include <cstring>
+#include "host.hpp"
+#include "esp_wifi.h"
+#include "esp_smartconfig.h"
+
+ESP_EVENT_DEFINE_BASE(WIFI_EVENT);
+ESP_EVENT_DEFINE_BASE(IP_EVENT);
+ESP_EVENT_DEFINE_BASE(SC_EVENT);
+
+struct esp_netif_obj
+{
+    bool dhcpcRunning = false;
+    esp_netif_ip_info_t ip = {};
+    esp_netif_dns_info_t dns = {};
+};
+
+namespace
+{
+    const int64_t scanUs = 30000;      //!< Full scan of all channels.
+    const int64_t associateUs = 5000;  //!< Association with known BSSID on known channel.
+    const int64_t dhcpUs = 20000;      //!< Discover, offer, request, ack.
+    const int64_t disconnectUs = 1000;
+    const uint8_t reasonAssocLeave = 8;
+    const uint8_t reasonNoApFound = 201;
+    const uint8_t reasonAuthFail = 202;
+    const uint8_t reasonBeaconTimeout = 200;
+
+    const esp_err_t netifDhcpNotStopped = ESP_ERR_ESP_NETIF_BASE + 0x06;
+
+    struct AccessPoint
+    {
+        std::string ssid = "home";
+        std::string password = "secret";
+        uint8_t bssid[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+        uint8_t channel = 6;
+        bool present = true;
+        int8_t rssi = -55;
+        uint32_t leaseIp = ESP_IP4TOADDR(192, 168, 1, 100);
+        uint32_t gateway = ESP_IP4TOADDR(192, 168, 1, 1);
+    };
+
+    std::mutex mutex;
+    AccessPoint ap;
+    wifi_config_t flashConfig = {};
+    wifi_config_t currentConfig = {};
+    wifi_storage_t storage = WIFI_STORAGE_FLASH;
+    bool initialized = false;
+    bool started = false;
+    bool smartConfigRunning = false;
+    bool isAssociated = false;
+    uint32_t generation = 0; //!< Bumped by disconnect, stale connect steps check it.
+    esp_netif_obj sta;
+    bool netifCreated = false;
+    uint32_t leasedTo = 0; //!< Address DHCP server leased to station, 0 if none.
+    uint32_t dhcpCount = 0;
+    uint32_t reportedIp = 0; //!< Address of last got IP event.
+    uint32_t attemptCount = 0;
+    fake::Worker *radio = nullptr; //!< Leaked, may run while process exits.
+
+    bool configMatchesAp(const wifi_config_t &conf)
+    {
+        return strncmp((const char *)conf.sta.ssid, ap.ssid.c_str(), sizeof(conf.sta.ssid)) == 0 &&
+               strncmp((const char *)conf.sta.password, ap.password.c_str(), sizeof(conf.sta.password)) == 0;
+    }
+
+    void postDisconnected(uint8_t reason)
+    {
+        wifi_event_sta_disconnected_t event = {};
+        memcpy(event.ssid, ap.ssid.c_str(), ap.ssid.size());
+        event.ssid_len = ap.ssid.size();
+        memcpy(event.bssid, ap.bssid, sizeof(event.bssid));
+        event.reason = reason;
+        esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &event, sizeof(event), 0);
+    }
+
+    void postGotIp()
+    {
+        ip_event_got_ip_t event = {};
+        event.esp_netif = &sta;
+        event.ip_info = sta.ip;
+        event.ip_changed = sta.ip.ip.addr != reportedIp;
+        reportedIp = sta.ip.ip.addr;
+        esp_event_post(IP_EVENT, IP_EVENT_STA_GOT_IP, &event, sizeof(event), 0);
+    }
+
+    /**
+     * @brief DHCP exchange, caller holds mutex.
+     */
+    void startDhcp(uint32_t gen)
+    {
+        radio->after(dhcpUs, [gen] {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (gen != generation || !isAssociated || !sta.dhcpcRunning)
+                return;
+            dhcpCount++;
+            leasedTo = ap.leaseIp;
+            sta.ip.ip.addr = ap.leaseIp;
+            sta.ip.netmask.addr = ESP_IP4TOADDR(255, 255, 255, 0);
+            sta.ip.gw.addr = ap.gateway;
+            sta.dns.ip.u_addr.ip4.addr = ap.gateway;
+            postGotIp();
+        });
+    }
+
+    void associate(uint32_t gen, wifi_config_t conf)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (gen != generation)
+            return;
+
+        bool wrongBssid = conf.sta.bssid_set && memcmp(conf.sta.bssid, ap.bssid, sizeof(ap.bssid)) != 0;
+        bool wrongChannel = conf.sta.channel && conf.sta.channel != ap.channel;
+        if (!ap.present || wrongBssid || wrongChannel)
+        {
+            postDisconnected(reasonNoApFound);
+            return;
+        }
+        if (!configMatchesAp(conf))
+        {
+            postDisconnected(reasonAuthFail);
+            return;
+        }
+
+        isAssociated = true;
+        wifi_event_sta_connected_t event = {};
+        memcpy(event.ssid, ap.ssid.c_str(), ap.ssid.size());
+        event.ssid_len = ap.ssid.size();
+        memcpy(event.bssid, ap.bssid, sizeof(event.bssid));
+        event.channel = ap.channel;
+        esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, &event, sizeof(event), 0);
+
+        // Static address is usable right after association, as far as station knows.
+        if (sta.dhcpcRunning)
+            startDhcp(gen);
+        else if (sta.ip.ip.addr)
+            postGotIp();
+    }
+
+    void loseAssociation(uint8_t reason)
+    {
+        generation++;
+        if (!isAssociated)
+            return;
+        isAssociated = false;
+        postDisconnected(reason);
+    }
+}
+
+void fake::wifi::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    ap = AccessPoint();
+    generation++;
+    isAssociated = false;
+    started = false;
+    initialized = false;
+    smartConfigRunning = false;
+    sta = esp_netif_obj();
+    netifCreated = false;
+    leasedTo = 0;
+    reportedIp = 0;
+    dhcpCount = 0;
+    attemptCount = 0;
+    if (radio)
+        radio->cancelAll();
+}
+
+void fake::wifi::setStoredCredentials(const std::string &ssid, const std::string &password)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    flashConfig = {};
+    strncpy((char *)flashConfig.sta.ssid, ssid.c_str(), sizeof(flashConfig.sta.ssid));
+    strncpy((char *)flashConfig.sta.password, password.c_str(), sizeof(flashConfig.sta.password));
+}
+
+void fake::wifi::setApPresent(bool present)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    ap.present = present;
+    if (!present)
+        loseAssociation(reasonBeaconTimeout);
+}
+
+void fake::wifi::setApChannel(uint8_t channel)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    ap.channel = channel;
+}
+
+void fake::wifi::renumber(uint32_t ip)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    ap.leaseIp = ip;
+    leasedTo = 0;
+}
+
+void fake::wifi::dropConnection()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    loseAssociation(reasonBeaconTimeout);
+}
+
+void fake::wifi::smartConfigDeliver(const std::string &ssid, const std::string &password)
+{
+    smartconfig_event_got_ssid_pswd_t event = {};
+    strncpy((char *)event.ssid, ssid.c_str(), sizeof(event.ssid));
+    strncpy((char *)event.password, password.c_str(), sizeof(event.password));
+    esp_event_post(SC_EVENT, SC_EVENT_GOT_SSID_PSWD, &event, sizeof(event), 0);
+}
+
+uint32_t fake::wifi::dhcpExchanges()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return dhcpCount;
+}
+
+uint32_t fake::wifi::connectAttempts()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return attemptCount;
+}
+
+bool fake::wifi::addressLeased()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return sta.ip.ip.addr && sta.ip.ip.addr == leasedTo;
+}
+
+bool fake::wifi::dhcpcRunning()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return sta.dhcpcRunning;
+}
+
+bool fake::wifi::associated()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return isAssociated;
+}
+
+esp_ip4_addr_t fake::wifi::address()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return sta.ip.ip;
+}
+
+esp_err_t esp_netif_init(void)
+{
+    return ESP_OK;
+}
+
+esp_netif_t *esp_netif_create_default_wifi_sta(void)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (netifCreated)
+        return nullptr;
+    netifCreated = true;
+    sta = esp_netif_obj();
+    sta.dhcpcRunning = true; // Default station interface starts with DHCP client enabled.
+    return &sta;
+}
+
+esp_err_t esp_netif_dhcpc_start(esp_netif_t *esp_netif)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (esp_netif->dhcpcRunning)
+        return ESP_ERR_ESP_NETIF_DHCP_ALREADY_STARTED;
+
+    esp_netif->dhcpcRunning = true;
+    if (isAssociated)
+        startDhcp(generation);
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_dhcpc_stop(esp_netif_t *esp_netif)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!esp_netif->dhcpcRunning)
+        return ESP_ERR_ESP_NETIF_DHCP_ALREADY_STOPPED;
+    esp_netif->dhcpcRunning = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_set_ip_info(esp_netif_t *esp_netif, const esp_netif_ip_info_t *ip_info)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (esp_netif->dhcpcRunning)
+        return netifDhcpNotStopped;
+    esp_netif->ip = *ip_info;
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_get_ip_info(esp_netif_t *esp_netif, esp_netif_ip_info_t *ip_info)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    *ip_info = esp_netif->ip;
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_set_dns_info(esp_netif_t *esp_netif, esp_netif_dns_type_t type, esp_netif_dns_info_t *dns)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (type == ESP_NETIF_DNS_MAIN)
+        esp_netif->dns = *dns;
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_get_dns_info(esp_netif_t *esp_netif, esp_netif_dns_type_t type, esp_netif_dns_info_t *dns)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    *dns = type == ESP_NETIF_DNS_MAIN ? esp_netif->dns : esp_netif_dns_info_t();
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!radio)
+        radio = new fake::Worker("wifi");
+    initialized = true;
+    currentConfig = flashConfig;
+    storage = WIFI_STORAGE_FLASH;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return initialized ? ESP_OK : ESP_ERR_WIFI_NOT_INIT;
+}
+
+esp_err_t esp_wifi_set_storage(wifi_storage_t s)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!initialized)
+        return ESP_ERR_WIFI_NOT_INIT;
+    storage = s;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!initialized)
+        return ESP_ERR_WIFI_NOT_INIT;
+    started = true;
+    esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_START, nullptr, 0, 0);
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_stop(void)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    loseAssociation(reasonAssocLeave);
+    started = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_connect(void)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!started)
+        return ESP_ERR_WIFI_NOT_STARTED;
+    if (isAssociated)
+        return ESP_ERR_WIFI_CONN;
+
+    attemptCount++;
+    uint32_t gen = ++generation;
+    wifi_config_t conf = currentConfig;
+
+    // Known BSSID and channel skip the scan.
+    bool direct = conf.sta.bssid_set && conf.sta.channel;
+    radio->after(direct ? associateUs : scanUs, [gen, conf] { associate(gen, conf); });
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_disconnect(void)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!started)
+        return ESP_ERR_WIFI_NOT_STARTED;
+
+    generation++;
+    if (isAssociated)
+    {
+        isAssociated = false;
+        radio->after(disconnectUs, [] {
+            std::lock_guard<std::mutex> lock(mutex);
+            postDisconnected(reasonAssocLeave);
+        });
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_config(wifi_interface_t interface, wifi_config_t *conf)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!initialized)
+        return ESP_ERR_WIFI_NOT_INIT;
+    *conf = currentConfig;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t *conf)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!initialized)
+        return ESP_ERR_WIFI_NOT_INIT;
+    currentConfig = *conf;
+    if (storage == WIFI_STORAGE_FLASH)
+        flashConfig = *conf;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap_info)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!isAssociated)
+        return ESP_ERR_WIFI_CONN;
+
+    memset(ap_info, 0, sizeof(*ap_info));
+    memcpy(ap_info->bssid, ap.bssid, sizeof(ap.bssid));
+    memcpy(ap_info->ssid, ap.ssid.c_str(), ap.ssid.size());
+    ap_info->primary = ap.channel;
+    ap_info->rssi = ap.rssi;
+    return ESP_OK;
+}
+
+esp_err_t esp_smartconfig_set_type(smartconfig_type_t type)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_smartconfig_start(const smartconfig_start_config_t *config)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (smartConfigRunning)
+        return ESP_ERR_INVALID_STATE;
+    smartConfigRunning = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_smartconfig_stop(void)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    smartConfigRunning = false;
+    return ESP_OK;
+}
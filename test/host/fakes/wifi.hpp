@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "esp_netif.h"
+
+/**
+ * @brief Radio, single access point and its DHCP server.
+ * Connect and DHCP exchange complete asynchronously and report through the default event loop.
+ */
+namespace fake
+{
+    namespace wifi
+    {
+        /**
+         * @brief Bring access point and DHCP server to default state and forget station's state.
+         * Access point "home" with password "secret" on channel 6 leases 192.168.1.100.
+         */
+        void reset();
+
+        /**
+         * @brief Set credentials stored in flash, used by esp_wifi_init().
+         */
+        void setStoredCredentials(const std::string &ssid, const std::string &password);
+
+        /**
+         * @brief Switch access point on or off, station is disconnected when it goes off.
+         */
+        void setApPresent(bool present);
+
+        /**
+         * @brief Move access point to another channel, e.g. after its reboot.
+         */
+        void setApChannel(uint8_t channel);
+
+        /**
+         * @brief Make DHCP server hand out another address, previous lease is no longer valid.
+         */
+        void renumber(uint32_t ip);
+
+        /**
+         * @brief Drop association, like when signal is lost.
+         */
+        void dropConnection();
+
+        /**
+         * @brief Deliver credentials from phone while smart config runs.
+         */
+        void smartConfigDeliver(const std::string &ssid, const std::string &password);
+
+        /**
+         * @brief Get number of DHCP exchanges (discover or renewal) done by station.
+         */
+        uint32_t dhcpExchanges();
+
+        /**
+         * @brief Get number of association attempts.
+         */
+        uint32_t connectAttempts();
+
+        /**
+         * @brief Check whether address configured on station's interface is currently leased to it.
+         */
+        bool addressLeased();
+
+        /**
+         * @brief Check whether DHCP client runs.
+         */
+        bool dhcpcRunning();
+
+        /**
+         * @brief Check whether station is associated.
+         */
+        bool associated();
+
+        /**
+         * @brief Get address configured on station's interface.
+         */
+        esp_ip4_addr_t address();
+    }
+}
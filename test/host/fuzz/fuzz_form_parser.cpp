@@ -0,0 +1,161 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "../../../include/form_parser.hpp"
+
+/**
+ * Feeds body split into random chunks to FormParser and compares fields and status
+ * with reference decoder that sees whole body at once.
+ * First byte of input selects limits and seeds chunk sizes, rest is the body.
+ */
+
+namespace
+{
+    typedef std::pair<std::string, std::string> Field;
+
+    struct Result
+    {
+        std::vector<Field> fields;
+        int status; //!< FormParser::Status as int.
+    };
+
+    const int OK = 0, TOO_LONG = 1, BAD_ESCAPE = 2;
+
+    int hexValue(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    /**
+     * @brief Decode part of field left to right.
+     * @return Status of first problem in the part.
+     */
+    int decodePart(const std::string &part, size_t limit, std::string &out)
+    {
+        for (size_t i = 0; i < part.size(); i++)
+        {
+            char c = part[i];
+            if (c == '%')
+            {
+                if (i + 2 >= part.size())
+                    return BAD_ESCAPE; // Cut by end of field.
+                int high = hexValue(part[i + 1]);
+                if (high < 0)
+                    return BAD_ESCAPE;
+                int low = hexValue(part[i + 2]);
+                if (low < 0)
+                    return BAD_ESCAPE;
+                c = (char)(high << 4 | low);
+                i += 2;
+            }
+            else if (c == '+')
+            {
+                c = ' ';
+            }
+
+            if (c == 0)
+                return BAD_ESCAPE;
+            if (out.size() == limit)
+                return TOO_LONG;
+            out += c;
+        }
+        return OK;
+    }
+
+    /**
+     * @brief Reference decoder: split whole body on '&', then each field on its first '='.
+     */
+    Result reference(const std::string &body, size_t maxKey, size_t maxValue)
+    {
+        Result result;
+        result.status = OK;
+
+        size_t start = 0;
+        while (start <= body.size())
+        {
+            size_t end = body.find('&', start);
+            if (end == std::string::npos)
+                end = body.size();
+            std::string field = body.substr(start, end - start);
+            start = end + 1;
+            if (field.empty())
+                continue;
+
+            size_t eq = field.find('=');
+            std::string key, value;
+            result.status = decodePart(field.substr(0, eq), maxKey, key);
+            if (result.status == OK && eq != std::string::npos)
+                result.status = decodePart(field.substr(eq + 1), maxValue, value);
+            if (result.status != OK)
+                return result;
+
+            result.fields.push_back(Field(key, value));
+        }
+        return result;
+    }
+
+    void collect(const char *key, const char *value, void *ctx)
+    {
+        ((std::vector<Field> *)ctx)->push_back(Field(key, value));
+    }
+
+    template <size_t MaxKey, size_t MaxValue>
+    Result parseChunked(const std::string &body, uint32_t seed)
+    {
+        typedef FormParser<MaxKey, MaxValue> Parser;
+
+        Result result;
+        Parser parser(collect, &result.fields);
+        size_t pos = 0;
+        while (pos < body.size())
+        {
+            // Chunks of 0 - 16 bytes, empty ones included.
+            seed = seed * 1103515245 + 12345;
+            size_t len = (seed >> 16) % 17;
+            if (len > body.size() - pos)
+                len = body.size() - pos;
+            parser.feed(body.data() + pos, len);
+            pos += len;
+        }
+        result.status = (int)parser.finish();
+        return result;
+    }
+
+    template <size_t MaxKey, size_t MaxValue>
+    void check(const std::string &body, uint32_t seed)
+    {
+        Result expected = reference(body, MaxKey, MaxValue);
+        Result actual = parseChunked<MaxKey, MaxValue>(body, seed);
+        if (actual.status == expected.status && actual.fields == expected.fields)
+            return;
+
+        fprintf(stderr, "FormParser<%u, %u> mismatch for body of %u bytes (seed %u): status %d, expected %d, %u fields, expected %u\n",
+                (unsigned)MaxKey, (unsigned)MaxValue, (unsigned)body.size(), (unsigned)seed,
+                actual.status, expected.status, (unsigned)actual.fields.size(), (unsigned)expected.fields.size());
+        abort();
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    if (size == 0)
+        return 0;
+
+    uint8_t selector = data[0];
+    std::string body((const char *)data + 1, size - 1);
+
+    // Limits of ConfigFormParser in src/http.cpp, and tiny ones that make limits easy to hit.
+    if (selector & 1)
+        check<15, 32>(body, selector >> 1);
+    else
+        check<3, 4>(body, selector >> 1);
+    return 0;
+}
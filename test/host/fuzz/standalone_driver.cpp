@@ -0,0 +1,85 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+#include <dirent.h>
+
+/**
+ * Stand-in for libFuzzer's main() when compiler has no -fsanitize=fuzzer (i.e. GCC).
+ * Runs given files and directories as corpus, then -runs=N random inputs
+ * built mostly of characters that matter to the target, without coverage feedback.
+ * Same command line works with both, i.e. fuzz_form_parser -runs=100000 corpus/form_parser.
+ */
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+namespace
+{
+    void runFile(const std::string &path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+    }
+
+    /**
+     * @brief Run file or every regular file of directory.
+     * @return Number of inputs run.
+     */
+    unsigned runPath(const std::string &path)
+    {
+        DIR *dir = opendir(path.c_str());
+        if (!dir)
+        {
+            runFile(path);
+            return 1;
+        }
+
+        unsigned count = 0;
+        while (dirent *entry = readdir(dir))
+        {
+            if (entry->d_name[0] == '.')
+                continue;
+            runFile(path + "/" + entry->d_name);
+            count++;
+        }
+        closedir(dir);
+        return count;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long runs = 10000;
+    unsigned long seed = 1;
+    unsigned corpus = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "-runs=", 6) == 0)
+            runs = strtoul(argv[i] + 6, nullptr, 10);
+        else if (strncmp(argv[i], "-seed=", 6) == 0)
+            seed = strtoul(argv[i] + 6, nullptr, 10);
+        else if (argv[i][0] != '-')
+            corpus += runPath(argv[i]);
+    }
+
+    // Structure characters are drawn often, any other byte sometimes.
+    static const char interesting[] = "%%%&&==++0123456789abcdefABCDEFgG";
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> input;
+    for (unsigned long run = 0; run < runs; run++)
+    {
+        input.resize(rng() % 128);
+        for (uint8_t &b : input)
+            b = rng() % 4 ? interesting[rng() % (sizeof(interesting) - 1)] : rng();
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+
+    printf("Done %u corpus inputs and %lu random inputs (seed %lu)\n", corpus, runs, seed);
+    return 0;
+}
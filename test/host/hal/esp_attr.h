@@ -0,0 +1,5 @@
+#pragma once
+// Host has no IRAM or RTC memory, attributes only mark the code.
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
@@ -0,0 +1,12 @@
+#pragma once
+#include "esp_err.h"
+
+uint32_t esp_random(void);
+
+/**
+ * @brief Heap is modelled by fake::Heap, see fakes/heap.hpp.
+ */
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
+
+void esp_restart(void) __attribute__((noreturn));
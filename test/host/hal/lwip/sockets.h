@@ -0,0 +1,7 @@
+#pragma once
+
+// Sockets belong to fake::Httpd, see fakes/httpd.hpp. lwIP maps POSIX names the same way.
+#define MSG_DONTWAIT 0x08
+
+int lwip_close(int s);
+#define close(s) lwip_close(s)
@@ -0,0 +1,17 @@
+#pragma once
+// Forced into every host translation unit, provides what ESP-IDF's newlib has and glibc may lack.
+#include <string.h>
+#include <stddef.h>
+
+#if !defined(__GLIBC__) || __GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38)
+#define HOST_NEEDS_STRLCPY 1
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+    size_t strlcpy(char *dst, const char *src, size_t size);
+    size_t strlcat(char *dst, const char *src, size_t size);
+#ifdef __cplusplus
+}
+#endif
+#endif
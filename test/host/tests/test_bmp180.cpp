@@ -0,0 +1,237 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <thread>
+#include "../../../include/bmp180.hpp"
+#include "../../../include/bmp180_compensation.hpp"
+#include "../../../include/config.hpp"
+#include "../../../include/i2c.hpp"
+#include "../fakes/host.hpp"
+#include "../fakes/i2c.hpp"
+
+namespace
+{
+    // Datasheet example (BMP180 datasheet, chapter 3.5).
+    const uint8_t exampleCalibrationBlock[22] = {
+        0x01, 0x98, 0xFF, 0xB8, 0xC7, 0xD1, 0x7F, 0xE5, 0x7F, 0xF5, 0x5A, 0x71,
+        0x18, 0x2E, 0x00, 0x04, 0x80, 0x00, 0xDD, 0xF9, 0x0B, 0x34};
+    const int32_t exampleUT = 27898;
+    const int32_t exampleUP = 23843;
+
+    typedef BMP180StaticCompensation<408, -72, -14383, 32741, 32757, 23153, 6190, 4, -32768, -8711, 2868> ExampleCompensation;
+
+    class BMP180Test : public testing::Test
+    {
+    protected:
+        static fake::i2c::Bmp180 *sensor;
+
+        static void SetUpTestSuite()
+        {
+            I2C_init(I2C_PORT, I2C_SDA, I2C_SCL, I2C_FREQ);
+        }
+
+        void SetUp() override
+        {
+            // Fresh register model for every test, driver keeps its calibration.
+            fake::i2c::reset();
+            delete sensor;
+            sensor = new fake::i2c::Bmp180;
+            fake::i2c::attach(fake::i2c::Bmp180::address, sensor);
+        }
+    };
+
+    fake::i2c::Bmp180 *BMP180Test::sensor = nullptr;
+
+    /**
+     * @brief Sensor that NACKs start of pressure conversion.
+     */
+    class NackingPressureBmp180 : public fake::i2c::Bmp180
+    {
+    public:
+        bool write(const uint8_t *data, size_t len) override
+        {
+            const uint8_t CTRL_MEAS = 0xF4, TEMPERATURE = 0x2E;
+            if (len > 1 && data[0] == CTRL_MEAS && data[1] != TEMPERATURE)
+                return false;
+            return Bmp180::write(data, len);
+        }
+    };
+}
+
+TEST(BMP180Compensation, ParsesBigEndianCalibrationBlock)
+{
+    BMP180Calibration cal = BMP180_parseCalibration(exampleCalibrationBlock);
+    EXPECT_EQ(408, cal.AC1);
+    EXPECT_EQ(-72, cal.AC2);
+    EXPECT_EQ(-14383, cal.AC3);
+    EXPECT_EQ(32741, cal.AC4);
+    EXPECT_EQ(32757, cal.AC5);
+    EXPECT_EQ(23153, cal.AC6);
+    EXPECT_EQ(6190, cal.B1);
+    EXPECT_EQ(4, cal.B2);
+    EXPECT_EQ(-32768, cal.MB);
+    EXPECT_EQ(-8711, cal.MC);
+    EXPECT_EQ(2868, cal.MD);
+}
+
+TEST(BMP180Compensation, MatchesDatasheetExample)
+{
+    BMP180Calibration cal = BMP180_parseCalibration(exampleCalibrationBlock);
+    int32_t B5 = 0;
+    EXPECT_EQ(150, BMP180_compensateTemperature(cal, exampleUT, B5));
+    EXPECT_EQ(2400, B5);
+    // Datasheet shifts negative X2 right (rounding down) where compensation divides, so it gives 1 Pa more.
+    EXPECT_EQ(69965, BMP180_compensatePressure(cal, exampleUP << 8, 0, B5));
+}
+
+TEST(BMP180Compensation, OversampledReadingGivesSamePressureForSameUncompensatedValue)
+{
+    BMP180Calibration cal = BMP180_parseCalibration(exampleCalibrationBlock);
+    int32_t B5 = 0;
+    BMP180_compensateTemperature(cal, exampleUT, B5);
+
+    // Same physical pressure read with more samples is roughly oss times finer.
+    for (uint8_t oss = 0; oss <= 3; oss++)
+    {
+        int32_t p = BMP180_compensatePressure(cal, (exampleUP << oss) << (8 - oss), oss, B5);
+        EXPECT_NEAR(69965, p, 2) << "oss " << (int)oss;
+    }
+}
+
+TEST(BMP180Compensation, StaticCalibrationMatchesRuntimeCalibration)
+{
+    BMP180Calibration cal = BMP180_parseCalibration(exampleCalibrationBlock);
+    // Raw temperatures of the -40 - 85 °C operating range.
+    for (int32_t UT = 23500; UT <= 37500; UT += 997)
+    {
+        int32_t B5 = 0, staticB5 = 0;
+        ASSERT_EQ(BMP180_compensateTemperature(cal, UT, B5), ExampleCompensation::temperature(UT, staticB5));
+        ASSERT_EQ(B5, staticB5);
+        for (int32_t UP = 20000 << 8; UP <= 42000 << 8; UP += 1013 << 8)
+            ASSERT_EQ(BMP180_compensatePressure(cal, UP, 1, B5), ExampleCompensation::pressure(UP, 1, B5));
+    }
+}
+
+TEST_F(BMP180Test, ReadsCalibrationAndCompensatesBlockingReads)
+{
+    BMP180 bmp;
+    EXPECT_FLOAT_EQ(15.0f, bmp.read(BMP180::MeasurementType::TEMPERATURE));
+    EXPECT_FLOAT_EQ(699.65f, bmp.read(BMP180::MeasurementType::LOW_POWER));
+    EXPECT_EQ(150, bmp.getTemperatureDeci());
+    EXPECT_EQ(69965, bmp.getPressurePa());
+    EXPECT_EQ(0u, sensor->earlyReads());
+}
+
+TEST_F(BMP180Test, FollowsRawValuesOfSensor)
+{
+    BMP180 bmp;
+    sensor->setRaw(30000, 24500);
+    bmp.read(BMP180::MeasurementType::LOW_POWER);
+
+    BMP180Calibration cal = BMP180_parseCalibration(exampleCalibrationBlock);
+    int32_t B5 = 0;
+    EXPECT_EQ(BMP180_compensateTemperature(cal, 30000, B5), bmp.getTemperatureDeci());
+    EXPECT_EQ(BMP180_compensatePressure(cal, 24500 << 8, 0, B5), bmp.getPressurePa());
+}
+
+TEST_F(BMP180Test, CycleConvertsTemperatureThenPressureWithSameB5)
+{
+    BMP180 bmp;
+    uint32_t transactionsBefore = fake::i2c::transactions();
+
+    ASSERT_TRUE(bmp.start(BMP180::MeasurementType::STANDARD));
+    EXPECT_FALSE(bmp.start(BMP180::MeasurementType::STANDARD)); // Previous cycle still runs.
+    EXPECT_EQ(BMP180::Status::BUSY, bmp.poll());
+    EXPECT_EQ(1u, sensor->conversions());
+
+    // Temperature result starts pressure conversion right away.
+    ASSERT_TRUE(fake::waitUntil([&] { return bmp.poll() != BMP180::Status::BUSY || sensor->conversions() == 2; }, 100));
+    EXPECT_EQ(2u, sensor->conversions());
+    EXPECT_EQ(BMP180::Status::BUSY, bmp.poll());
+
+    EXPECT_EQ(BMP180::Status::READY, bmp.wait());
+    EXPECT_EQ(BMP180::Status::READY, bmp.poll()); // Idle.
+
+    // Two conversions and two result reads, none of them before conversion was done.
+    EXPECT_EQ(4u, fake::i2c::transactions() - transactionsBefore);
+    EXPECT_EQ(2u, sensor->conversions());
+    EXPECT_EQ(0u, sensor->earlyReads());
+
+    BMP180Calibration cal = BMP180_parseCalibration(exampleCalibrationBlock);
+    int32_t B5 = 0;
+    EXPECT_EQ(BMP180_compensateTemperature(cal, exampleUT, B5), bmp.getTemperatureDeci());
+    EXPECT_EQ(BMP180_compensatePressure(cal, exampleUP << 7, 1, B5), bmp.getPressurePa());
+}
+
+TEST_F(BMP180Test, TemperatureCycleSkipsPressure)
+{
+    BMP180 bmp;
+    ASSERT_TRUE(bmp.start(BMP180::MeasurementType::TEMPERATURE));
+    EXPECT_EQ(BMP180::Status::READY, bmp.wait());
+    EXPECT_EQ(1u, sensor->conversions());
+    EXPECT_EQ(150, bmp.getTemperatureDeci());
+}
+
+TEST_F(BMP180Test, NackOfResultReadEndsCycleWithError)
+{
+    BMP180 bmp;
+    ASSERT_TRUE(bmp.start(BMP180::MeasurementType::HIGH_RES));
+    fake::i2c::failNext(ESP_FAIL);
+    EXPECT_EQ(BMP180::Status::ERROR, bmp.wait());
+    EXPECT_EQ(1u, sensor->conversions()); // Pressure was never started.
+
+    // Cycle is over, next one starts normally.
+    ASSERT_TRUE(bmp.start(BMP180::MeasurementType::TEMPERATURE));
+    EXPECT_EQ(BMP180::Status::READY, bmp.wait());
+}
+
+TEST_F(BMP180Test, NackOfPressureConversionEndsCycleWithError)
+{
+    NackingPressureBmp180 nacking;
+    fake::i2c::attach(fake::i2c::Bmp180::address, &nacking);
+
+    BMP180 bmp;
+    ASSERT_TRUE(bmp.start(BMP180::MeasurementType::STANDARD));
+    EXPECT_EQ(BMP180::Status::ERROR, bmp.wait());
+    EXPECT_EQ(1u, nacking.conversions()); // Only temperature.
+    EXPECT_EQ(150, bmp.getTemperatureDeci());
+}
+
+TEST_F(BMP180Test, FailedBlockingReadGivesNanNotPreviousValue)
+{
+    BMP180 bmp;
+    ASSERT_FLOAT_EQ(699.65f, bmp.read(BMP180::MeasurementType::LOW_POWER));
+
+    fake::i2c::failNext(ESP_FAIL);
+    EXPECT_TRUE(std::isnan(bmp.read(BMP180::MeasurementType::LOW_POWER)));
+
+    NackingPressureBmp180 nacking;
+    fake::i2c::attach(fake::i2c::Bmp180::address, &nacking);
+    EXPECT_TRUE(std::isnan(bmp.read(BMP180::MeasurementType::STANDARD)));
+    EXPECT_FLOAT_EQ(15.0f, bmp.read(BMP180::MeasurementType::TEMPERATURE));
+}
+
+TEST_F(BMP180Test, NackOfStartFailsStart)
+{
+    BMP180 bmp;
+    fake::i2c::failNext(ESP_FAIL);
+    EXPECT_FALSE(bmp.start(BMP180::MeasurementType::STANDARD));
+    EXPECT_EQ(0u, sensor->conversions());
+    EXPECT_EQ(BMP180::Status::READY, bmp.poll()); // Nothing in progress.
+}
+
+TEST_F(BMP180Test, WaitWithoutNotificationEndsAfterTimeout)
+{
+    BMP180 bmp;
+
+    // Conversion timer notifies task that started the cycle, waiting from another one relies on wait timeout.
+    std::thread starter([&] { ASSERT_TRUE(bmp.start(BMP180::MeasurementType::LOW_POWER)); });
+    starter.join();
+
+    int64_t start = fake::nowUs();
+    EXPECT_EQ(BMP180::Status::READY, bmp.wait());
+    int64_t elapsedUs = fake::nowUs() - start;
+
+    EXPECT_GE(elapsedUs, 100000); // At least one timed out sleep.
+    EXPECT_LT(elapsedUs, 500000);
+    EXPECT_EQ(69965, bmp.getPressurePa());
+}
@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "../../../include/dht11.hpp"
+#include "../../../include/dht11_frame.hpp"
+#include "../../../include/config.hpp"
+#include "../fakes/dht11.hpp"
+
+namespace
+{
+    /**
+     * @brief Build HIGH pulse widths the sensor sends for frame, preceded by 80us response.
+     */
+    std::vector<uint16_t> pulsesOf(uint8_t humidity, uint8_t temperature, uint8_t checksum)
+    {
+        uint64_t frame = ((uint64_t)humidity << 32) | ((uint64_t)temperature << 16) | checksum;
+        std::vector<uint16_t> widths = {80};
+        for (int bit = 39; bit >= 0; bit--)
+            widths.push_back((frame >> bit) & 1 ? 70 : 26);
+        return widths;
+    }
+
+    class DHT11Test : public testing::Test
+    {
+    protected:
+        static DHT11 *dht;
+
+        static void SetUpTestSuite()
+        {
+            dht = new DHT11; // Never deleted like on the device, RMT keeps its channel.
+            dht->init(DHT11_DATA_PIN, DHT11_RMT_CHANNEL);
+        }
+    };
+
+    DHT11 *DHT11Test::dht = nullptr;
+}
+
+TEST(DHT11Frame, DecodesPulsesAfterResponse)
+{
+    std::vector<uint16_t> widths = pulsesOf(45, 21, 66);
+    uint64_t frame = 0;
+    ASSERT_TRUE(DHT11_decodePulses(widths.data(), widths.size(), frame));
+    EXPECT_EQ(((uint64_t)45 << 32) | ((uint64_t)21 << 16) | 66, frame);
+
+    uint8_t humidity = 0, temperature = 0;
+    ASSERT_TRUE(DHT11_decodeFrame(frame, humidity, temperature));
+    EXPECT_EQ(45, humidity);
+    EXPECT_EQ(21, temperature);
+}
+
+TEST(DHT11Frame, RejectsShortCapture)
+{
+    std::vector<uint16_t> widths = pulsesOf(45, 21, 66);
+    uint64_t frame = 0;
+    EXPECT_FALSE(DHT11_decodePulses(widths.data() + 2, widths.size() - 2, frame));
+}
+
+TEST(DHT11Frame, ChecksumIsLastEightBitsOfSum)
+{
+    uint8_t humidity = 0, temperature = 0;
+    uint64_t frame = ((uint64_t)200 << 32) | ((uint64_t)1 << 24) | ((uint64_t)60 << 16) | ((200 + 1 + 60) & 0xFF);
+    EXPECT_TRUE(DHT11_decodeFrame(frame, humidity, temperature));
+    EXPECT_EQ(200, humidity);
+
+    EXPECT_FALSE(DHT11_decodeFrame(frame ^ 1, humidity, temperature));
+}
+
+TEST_F(DHT11Test, ReadsHumidityFromSensor)
+{
+    fake::Dht11 sensor(DHT11_DATA_PIN, DHT11_RMT_CHANNEL);
+    sensor.set(55, 23);
+    DHT11::Stats before = dht->getStats();
+
+    EXPECT_FLOAT_EQ(55.0f, dht->read());
+    EXPECT_EQ(1u, sensor.responses());
+    EXPECT_EQ(0u, sensor.badStartSignals());
+    EXPECT_EQ(before.reads + 1, dht->getStats().reads);
+}
+
+TEST_F(DHT11Test, CountsChecksumErrors)
+{
+    fake::Dht11 sensor(DHT11_DATA_PIN, DHT11_RMT_CHANNEL);
+    sensor.setMode(fake::Dht11::Mode::BAD_CHECKSUM);
+    DHT11::Stats before = dht->getStats();
+
+    EXPECT_EQ(-1.0f, dht->read());
+    EXPECT_EQ(before.checksumErrors + 1, dht->getStats().checksumErrors);
+    EXPECT_EQ(before.timeouts, dht->getStats().timeouts);
+}
+
+TEST_F(DHT11Test, CountsTimeoutsAndRecovers)
+{
+    fake::Dht11 sensor(DHT11_DATA_PIN, DHT11_RMT_CHANNEL);
+    sensor.setMode(fake::Dht11::Mode::NO_RESPONSE);
+    DHT11::Stats before = dht->getStats();
+
+    EXPECT_EQ(-1.0f, dht->read());
+    EXPECT_EQ(before.timeouts + 1, dht->getStats().timeouts);
+
+    sensor.setMode(fake::Dht11::Mode::OK);
+    sensor.set(40, 20);
+    EXPECT_FLOAT_EQ(40.0f, dht->read());
+}
@@ -0,0 +1,236 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "../../../include/filters.hpp"
+#include "../../../include/config.hpp"
+
+namespace
+{
+    /**
+     * @brief Load pressure trace, one sample in Pa per line, '#' starts comment line.
+     */
+    std::vector<int32_t> loadTrace(const char *name)
+    {
+        std::vector<int32_t> samples;
+        std::ifstream in(std::string(HOST_DATA_DIR) + "/" + name);
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (!line.empty() && line[0] != '#')
+                samples.push_back(std::stol(line));
+        }
+        return samples;
+    }
+
+    /**
+     * @brief Wide centered moving median, stands for true pressure of the trace.
+     */
+    std::vector<int32_t> baseline(const std::vector<int32_t> &samples, size_t halfWidth = 15)
+    {
+        std::vector<int32_t> out;
+        for (size_t i = 0; i < samples.size(); i++)
+        {
+            size_t from = i > halfWidth ? i - halfWidth : 0;
+            size_t to = std::min(samples.size(), i + halfWidth + 1);
+            std::vector<int32_t> window(samples.begin() + from, samples.begin() + to);
+            std::nth_element(window.begin(), window.begin() + window.size() / 2, window.end());
+            out.push_back(window[window.size() / 2]);
+        }
+        return out;
+    }
+
+    /**
+     * @brief Deviation of filtered samples from baseline, skipping warm up.
+     */
+    struct Deviation
+    {
+        double rms = 0;
+        int32_t max = 0;
+    };
+
+    Deviation deviation(const std::vector<int32_t> &filtered, const std::vector<int32_t> &base, size_t skip = 20)
+    {
+        Deviation d;
+        double sumSq = 0;
+        for (size_t i = skip; i < filtered.size(); i++)
+        {
+            int32_t e = filtered[i] - base[i];
+            sumSq += (double)e * e;
+            d.max = std::max(d.max, std::abs(e));
+        }
+        d.rms = std::sqrt(sumSq / (filtered.size() - skip));
+        return d;
+    }
+
+    template <typename Filter>
+    std::vector<int32_t> run(Filter &filter, const std::vector<int32_t> &samples)
+    {
+        std::vector<int32_t> out;
+        for (int32_t s : samples)
+            out.push_back(filter.update(s));
+        return out;
+    }
+
+    class FilterTraceTest : public testing::Test
+    {
+    protected:
+        static std::vector<int32_t> trace;
+        static std::vector<int32_t> base;
+        static Deviation raw;
+
+        static void SetUpTestSuite()
+        {
+            trace = loadTrace("bmp180_pressure.txt");
+            ASSERT_EQ(600u, trace.size());
+            base = baseline(trace);
+            raw = deviation(trace, base);
+        }
+    };
+
+    std::vector<int32_t> FilterTraceTest::trace;
+    std::vector<int32_t> FilterTraceTest::base;
+    Deviation FilterTraceTest::raw;
+}
+
+TEST_F(FilterTraceTest, TraceHasNoiseAndSpikes)
+{
+    // Sanity check of the trace itself, filters below are judged against it.
+    EXPECT_GT(raw.rms, 3.0);
+    EXPECT_LT(raw.rms, 10.0);
+    EXPECT_GT(raw.max, 50);
+}
+
+TEST_F(FilterTraceTest, MedianRemovesSpikes)
+{
+    MedianFilter<int32_t, PRESSURE_MEDIAN_SIZE> filter;
+    Deviation d = deviation(run(filter, trace), base);
+    EXPECT_LT(d.max, 20);
+    EXPECT_LT(d.rms, raw.rms);
+}
+
+TEST_F(FilterTraceTest, EmaReducesNoise)
+{
+    EmaFilter<int32_t, PRESSURE_EMA_SHIFT> filter;
+    Deviation d = deviation(run(filter, trace), base);
+    EXPECT_LT(d.rms, raw.rms * 0.7);
+    EXPECT_LT(d.max, raw.max); // Spike is spread, not removed.
+}
+
+TEST_F(FilterTraceTest, KalmanReducesNoiseMost)
+{
+    KalmanFilter<int32_t> filter(PRESSURE_KALMAN_Q, PRESSURE_KALMAN_R);
+    Deviation d = deviation(run(filter, trace), base, 60);
+    EXPECT_LT(d.rms, raw.rms * 0.5);
+    EXPECT_LT(d.max, 20);
+}
+
+TEST_F(FilterTraceTest, ResetStartsFromNextSample)
+{
+    MedianFilter<int32_t, 5> median;
+    EmaFilter<int32_t, 2> ema;
+    KalmanFilter<int32_t> kalman(PRESSURE_KALMAN_Q, PRESSURE_KALMAN_R);
+    run(median, trace);
+    run(ema, trace);
+    run(kalman, trace);
+
+    median.reset();
+    ema.reset();
+    kalman.reset();
+    EXPECT_EQ(90000, median.update(90000));
+    EXPECT_EQ(90000, ema.update(90000));
+    EXPECT_EQ(90000, kalman.update(90000));
+}
+
+TEST(EmaFilter, RoundsNegativeValuesLikePositiveOnes)
+{
+    // Truncation towards zero would settle short of negative targets.
+    EmaFilter<int32_t, 2> positive, negative;
+    positive.update(0);
+    negative.update(0);
+    for (int i = 0; i < 40; i++)
+    {
+        int32_t p = positive.update(10);
+        int32_t n = negative.update(-10);
+        ASSERT_EQ(-p, n) << "sample " << i;
+    }
+    EXPECT_EQ(-10, negative.update(-10));
+
+    // Halves round away from zero on both sides: average of 0 and 2 samples with alpha 1/4 is 0.5.
+    EmaFilter<int32_t, 2> up, down;
+    up.update(0);
+    down.update(0);
+    EXPECT_EQ(1, up.update(2));
+    EXPECT_EQ(-1, down.update(-2));
+}
+
+TEST(EmaFilter, KeepsConstantNegativeInput)
+{
+    EmaFilter<int32_t, 3> filter;
+    for (int i = 0; i < 20; i++)
+        ASSERT_EQ(-7, filter.update(-7));
+}
+
+TEST(MedianFilter, ReturnsMedianOfSamplesSeenSoFar)
+{
+    MedianFilter<int32_t, 5> filter;
+    EXPECT_EQ(10, filter.update(10));
+    EXPECT_EQ(1000, filter.update(1000)); // Upper median of two.
+    EXPECT_EQ(10, filter.update(5));
+    EXPECT_EQ(20, filter.update(20)); // Upper median of even count again.
+    EXPECT_EQ(10, filter.update(-50));
+    EXPECT_EQ(5, filter.update(0)); // 10 left the window.
+}
+
+TEST(RunningStats, KeepsPrecisionAtAtmosphericPressure)
+{
+    // Small spread on top of ~100000 Pa, naive sum of squares in float would lose it.
+    const int32_t samples[] = {100001, 99998, 100003, 99997, 100000, 100002, 99999, 100000};
+    RunningStats<int32_t> stats;
+    double sum = 0;
+    for (int32_t s : samples)
+    {
+        stats.add(s);
+        sum += s;
+    }
+
+    double mean = sum / 8, sumSq = 0;
+    for (int32_t s : samples)
+        sumSq += (s - mean) * (s - mean);
+
+    EXPECT_EQ(8u, stats.count());
+    EXPECT_EQ(99997, stats.min());
+    EXPECT_EQ(100003, stats.max());
+    EXPECT_DOUBLE_EQ(mean, stats.mean());
+    EXPECT_NEAR(std::sqrt(sumSq / 8), stats.stddev(), 1e-9);
+}
+
+TEST_F(FilterTraceTest, RunningStatsMatchesTwoPassOverTrace)
+{
+    RunningStats<int32_t> stats;
+    double sum = 0;
+    for (int32_t s : trace)
+    {
+        stats.add(s);
+        sum += s;
+    }
+
+    double mean = sum / trace.size(), sumSq = 0;
+    for (int32_t s : trace)
+        sumSq += (s - mean) * (s - mean);
+
+    EXPECT_NEAR(mean, stats.mean(), 1e-6);
+    EXPECT_NEAR(std::sqrt(sumSq / trace.size()), stats.stddev(), 1e-6);
+    EXPECT_EQ(*std::min_element(trace.begin(), trace.end()), stats.min());
+    EXPECT_EQ(*std::max_element(trace.begin(), trace.end()), stats.max());
+
+    stats.reset();
+    EXPECT_EQ(0u, stats.count());
+    EXPECT_EQ(0.0, stats.stddev());
+    stats.add(5);
+    EXPECT_EQ(5, stats.min());
+    EXPECT_EQ(5, stats.max());
+    EXPECT_EQ(5.0, stats.mean());
+}
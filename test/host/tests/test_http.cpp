@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+#include "../../../include/http.hpp"
+#include "../../../include/mqtt.hpp"
+#include "../../../include/sampling.hpp"
+#include "../../../include/config.hpp"
+#include "../fakes/gpio.hpp"
+#include "../fakes/httpd.hpp"
+#include "../fakes/host.hpp"
+#include "../fakes/mqtt.hpp"
+#include "nvs_flash.h"
+#include <thread>
+
+namespace
+{
+    class HTTPTest : public testing::Test
+    {
+    protected:
+        static void SetUpTestSuite()
+        {
+            nvs_flash_init();
+            Sampling_init();
+            MQTT_init(MQTT_LED_PIN);
+            MQTT_setCommandHandler(Sampling_handleCommand);
+            ASSERT_TRUE(MQTT_waitConnected(2000));
+            HTTP_init(HTTP_BUTTON_PIN, HTTP_LED_PIN, nullptr);
+
+            // Server runs only after button press.
+            ASSERT_FALSE(fake::httpd::running());
+            // Press is lost until connection task starts waiting for it.
+            for (int i = 0; i < 5 && !fake::httpd::running(); i++)
+            {
+                ASSERT_TRUE(fake::gpio::press(HTTP_BUTTON_PIN));
+                fake::waitUntil(fake::httpd::running, 500);
+            }
+            ASSERT_TRUE(fake::httpd::running());
+        }
+    };
+}
+
+TEST_F(HTTPTest, ServesGzippedConfigPage)
+{
+    fake::httpd::Response response = fake::httpd::get("/mqtt");
+    EXPECT_EQ(200, response.status);
+    EXPECT_EQ("gzip", response.headers["Content-Encoding"]);
+    EXPECT_EQ("text/html", response.headers["Content-Type"]);
+    ASSERT_GE(response.body.size(), 2u);
+    EXPECT_EQ('\x1f', response.body[0]);
+    EXPECT_EQ('\x8b', response.body[1]);
+    EXPECT_EQ(1, fake::gpio::output(HTTP_LED_PIN));
+}
+
+TEST_F(HTTPTest, PostUpdatesMqttConfig)
+{
+    fake::httpd::Response response = fake::httpd::post("/mqtt", "namespace=garden&batch=off");
+    EXPECT_EQ(303, response.status);
+    EXPECT_EQ("/mqtt", response.headers["Location"]);
+    EXPECT_STREQ("garden", MQTT_getSettings()->ns);
+
+    response = fake::httpd::get("/mqtt/config");
+    EXPECT_EQ(200, response.status);
+    EXPECT_EQ("application/json", response.headers["Content-Type"]);
+    EXPECT_NE(std::string::npos, response.body.find("\"namespace\":\"garden\""));
+}
+
+TEST_F(HTTPTest, UnknownUriIsNotFound)
+{
+    EXPECT_EQ(404, fake::httpd::get("/nope").status);
+}
+
+TEST_F(HTTPTest, LatencySummaryHasSumAndCount)
+{
+    fake::httpd::get("/mqtt"); // At least one traced GET.
+    fake::httpd::Response response = fake::httpd::get("/metrics");
+    ASSERT_EQ(200, response.status);
+
+    const std::string &body = response.body;
+    EXPECT_NE(std::string::npos, body.find("# TYPE latency_us summary\n"));
+    EXPECT_NE(std::string::npos, body.find("latency_us{op=\"http_get\",quantile=\"0.99\"} "));
+    EXPECT_NE(std::string::npos, body.find("latency_us_count{op=\"http_get\"} "));
+
+    // Every op of the summary has _sum next to its _count.
+    size_t counts = 0, sums = 0;
+    for (size_t pos = 0; (pos = body.find("latency_us_count{", pos)) != std::string::npos; pos++)
+        counts++;
+    for (size_t pos = 0; (pos = body.find("latency_us_sum{", pos)) != std::string::npos; pos++)
+        sums++;
+    EXPECT_GT(counts, 0u);
+    EXPECT_EQ(counts, sums);
+    EXPECT_EQ(std::string::npos, body.find("latency_us_sum{op=\"http_get\"} 0\n"));
+}
+
+TEST_F(HTTPTest, BatchCommandKeepsBatchModeStagedByForm)
+{
+    std::string ns = MQTT_getSettings()->ns;
+    fake::broker::clear();
+
+    // Broker change drains unacknowledged message, so form's MQTT_reInit() waits with its change staged.
+    fake::broker::holdAcks(true);
+    MQTT_publishFixed("counter", 1, 0, 1);
+    fake::broker::waitFor(ns + "/counter");
+    std::thread reconfigure([] {
+        MQTT_updateIP("10.0.5.1");
+        MQTT_reInit();
+    });
+    ASSERT_TRUE(fake::waitUntil([] { return fake::broker::liveClients() == 2; }, 2000));
+    std::thread form([] { EXPECT_EQ(303, fake::httpd::post("/mqtt", "batch=cbor").status); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    // Command applies right away.
+    fake::broker::inject(ns + "/cmd", "batch=json");
+    std::vector<fake::broker::Message> reply = fake::broker::waitFor(ns + "/cmd/result");
+    ASSERT_EQ(1u, reply.size());
+    EXPECT_EQ("ok", reply[0].payload);
+    EXPECT_STREQ("json", MQTT_getSettings()->batchMode);
+
+    // Form was submitted first but applies last, its value is not lost.
+    fake::broker::holdAcks(false);
+    reconfigure.join();
+    form.join();
+    EXPECT_STREQ("cbor", MQTT_getSettings()->batchMode);
+
+    MQTT_setBatchMode("off");
+}
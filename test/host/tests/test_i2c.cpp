@@ -0,0 +1,179 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "../../../include/i2c.hpp"
+#include "../../../include/config.hpp"
+#include "../fakes/gpio.hpp"
+#include "../fakes/i2c.hpp"
+
+namespace
+{
+    const I2C_Device slow = {0x40, 100000};  //!< Standard mode only slave.
+    const I2C_Device fast = {0x42, 1000000}; //!< Faster than the bus allows.
+
+    /**
+     * @brief Slave whose registers read as their own address, optionally taking its time on the bus.
+     */
+    class RegisterDevice : public fake::i2c::Device
+    {
+    public:
+        std::atomic<int> readDelayUs{0};
+
+        bool write(const uint8_t *data, size_t len) override
+        {
+            pointer = data[0];
+            return true;
+        }
+
+        void read(uint8_t *data, size_t len) override
+        {
+            if (readDelayUs)
+                std::this_thread::sleep_for(std::chrono::microseconds(readDelayUs));
+            for (size_t i = 0; i < len; i++)
+                data[i] = pointer++;
+        }
+
+    private:
+        uint8_t pointer = 0;
+    };
+
+    class I2CTest : public testing::Test
+    {
+    protected:
+        static RegisterDevice slowDevice, fastDevice;
+        static int sdaAfterInit;
+        static uint32_t initRecoveries;
+
+        static void SetUpTestSuite()
+        {
+            // Fake learns pins from config, on the device they are wired before firmware starts.
+            i2c_config_t wiring = {};
+            wiring.sda_io_num = I2C_SDA;
+            wiring.scl_io_num = I2C_SCL;
+            i2c_param_config(I2C_PORT, &wiring);
+
+            // Slave reset in middle of byte it was sending, it needs all 9 clocks to let go.
+            fake::i2c::holdSda(9);
+            I2C_init(I2C_PORT, I2C_SDA, I2C_SCL, I2C_FREQ);
+            sdaAfterInit = fake::gpio::line(I2C_SDA);
+            initRecoveries = I2C_getStats().recoveries;
+        }
+
+        void SetUp() override
+        {
+            fake::i2c::reset();
+            fake::i2c::attach(slow.addr, &slowDevice);
+            fake::i2c::attach(fast.addr, &fastDevice);
+        }
+    };
+
+    RegisterDevice I2CTest::slowDevice;
+    RegisterDevice I2CTest::fastDevice;
+    int I2CTest::sdaAfterInit;
+    uint32_t I2CTest::initRecoveries;
+}
+
+TEST_F(I2CTest, InitReleasesHeldSda)
+{
+    EXPECT_EQ(1, sdaAfterInit);
+    EXPECT_EQ(0u, initRecoveries); // Counts recoveries after failed transactions only.
+
+    uint8_t data[2];
+    ASSERT_EQ(ESP_OK, I2C_read(slow, 0x10, data, sizeof(data)));
+    EXPECT_EQ(0x10, data[0]);
+    EXPECT_EQ(0x11, data[1]);
+}
+
+TEST_F(I2CTest, EveryDeviceRunsAtLowerOfItsAndBusClock)
+{
+    uint8_t data;
+    ASSERT_EQ(ESP_OK, I2C_read(slow, 0, &data, 1));
+    uint32_t configs = fake::i2c::configs();
+    ASSERT_EQ(ESP_OK, I2C_read(slow, 0, &data, 1));
+    EXPECT_EQ(100000u, fake::i2c::lastClock(slow.addr));
+    EXPECT_EQ(configs, fake::i2c::configs()); // Same clock, peripheral left alone.
+
+    ASSERT_EQ(ESP_OK, I2C_read(fast, 0, &data, 1));
+    EXPECT_EQ((uint32_t)I2C_FREQ, fake::i2c::lastClock(fast.addr));
+    EXPECT_EQ(configs + 1, fake::i2c::configs());
+
+    ASSERT_EQ(ESP_OK, I2C_writeByte(fast, 0, 1));
+    EXPECT_EQ(configs + 1, fake::i2c::configs());
+
+    ASSERT_EQ(ESP_OK, I2C_read(slow, 0, &data, 1));
+    EXPECT_EQ(100000u, fake::i2c::lastClock(slow.addr));
+    EXPECT_EQ(configs + 2, fake::i2c::configs());
+}
+
+TEST_F(I2CTest, TimedOutTransactionRecoversHeldSda)
+{
+    I2C_Stats before = I2C_getStats();
+    uint8_t data;
+
+    fake::i2c::holdSda(9);
+    EXPECT_EQ(ESP_ERR_TIMEOUT, I2C_read(slow, 0, &data, 1));
+    EXPECT_EQ(1, fake::gpio::line(I2C_SDA));
+
+    I2C_Stats after = I2C_getStats();
+    EXPECT_EQ(before.recoveries + 1, after.recoveries);
+    EXPECT_EQ(before.errors + 1, after.errors);
+    EXPECT_EQ(ESP_OK, I2C_read(slow, 0, &data, 1));
+
+    // Pulsing stops as soon as slave lets go: idle level, 3 pulses and stop condition.
+    uint32_t sclWrites = fake::gpio::writes(I2C_SCL);
+    fake::i2c::holdSda(3);
+    EXPECT_EQ(ESP_ERR_TIMEOUT, I2C_read(slow, 0, &data, 1));
+    EXPECT_EQ(1, fake::gpio::line(I2C_SDA));
+    EXPECT_LE(fake::gpio::writes(I2C_SCL) - sclWrites, 1u + 2 * 3 + 2);
+    after = I2C_getStats();
+
+    // Clock stretched forever looks the same to the master.
+    fake::i2c::failNext(ESP_ERR_TIMEOUT);
+    EXPECT_EQ(ESP_ERR_TIMEOUT, I2C_write(fast, 0, &data, 1));
+    EXPECT_EQ(after.recoveries + 1, I2C_getStats().recoveries);
+}
+
+TEST_F(I2CTest, NackCountsErrorWithoutRecovery)
+{
+    uint8_t data;
+    ASSERT_EQ(ESP_OK, I2C_read(slow, 0, &data, 1)); // Settle clock.
+    I2C_Stats before = I2C_getStats();
+    uint32_t configs = fake::i2c::configs();
+
+    fake::i2c::failNext(ESP_FAIL);
+    EXPECT_EQ(ESP_FAIL, I2C_read(slow, 0, &data, 1));
+
+    I2C_Stats after = I2C_getStats();
+    EXPECT_EQ(before.transactions + 1, after.transactions);
+    EXPECT_EQ(before.errors + 1, after.errors);
+    EXPECT_EQ(before.recoveries, after.recoveries);
+    EXPECT_EQ(configs, fake::i2c::configs()); // Recovery would give pins back to peripheral.
+}
+
+TEST_F(I2CTest, ConcurrentTransactionsDoNotOverlap)
+{
+    // Slow slave keeps the bus long enough for the other task to try its transaction meanwhile.
+    slowDevice.readDelayUs = 200;
+    const int count = 100;
+    std::atomic<int> failed{0};
+
+    auto reader = [&](const I2C_Device &dev) {
+        for (int i = 0; i < count; i++)
+        {
+            uint8_t data[4];
+            uint8_t reg = (uint8_t)(i * 4);
+            if (I2C_read(dev, reg, data, sizeof(data)) != ESP_OK || data[0] != reg || data[3] != (uint8_t)(reg + 3))
+                failed++;
+        }
+    };
+    std::thread first(reader, std::cref(slow));
+    std::thread second(reader, std::cref(fast));
+    first.join();
+    second.join();
+    slowDevice.readDelayUs = 0;
+
+    EXPECT_EQ(0, failed.load());
+    EXPECT_EQ(0u, fake::i2c::overlaps());
+    EXPECT_EQ(2u * count, fake::i2c::transactions());
+}
@@ -0,0 +1,222 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include "../../../include/mqtt.hpp"
+#include "../../../include/sampling.hpp"
+#include "../../../include/config.hpp"
+#include "../fakes/host.hpp"
+#include "../fakes/mqtt.hpp"
+#include "../fakes/nvs.hpp"
+#include "nvs_flash.h"
+
+namespace
+{
+    /**
+     * @brief Stage namespace and apply it, namespace alone never reconnects.
+     */
+    void setNamespace(const char *ns)
+    {
+        MQTT_updateNamespace(ns);
+        MQTT_reInit();
+    }
+
+    /**
+     * @brief Stage broker address and apply it, always starts new session.
+     */
+    void setBroker(const char *ip)
+    {
+        MQTT_updateIP(ip);
+        MQTT_reInit();
+    }
+
+    SampleRecord record(SensorId sensor, uint32_t seq, int32_t value, uint8_t decimals)
+    {
+        SampleRecord r;
+        r.timestamp = 1700000000123000;
+        r.seq = seq;
+        r.sensor = sensor;
+        r.value = value;
+        r.decimals = decimals;
+        return r;
+    }
+
+    class MQTTTest : public testing::Test
+    {
+    protected:
+        static void SetUpTestSuite()
+        {
+            nvs_flash_init();
+            Sampling_init();
+            MQTT_init(MQTT_LED_PIN);
+            MQTT_setCommandHandler(Sampling_handleCommand);
+            ASSERT_TRUE(MQTT_waitConnected(2000));
+        }
+
+        void SetUp() override
+        {
+            ASSERT_TRUE(MQTT_flush(2000));
+            fake::broker::clear();
+        }
+    };
+}
+
+TEST_F(MQTTTest, StoresConfigAsSingleBlob)
+{
+    setNamespace("station");
+
+    std::vector<uint8_t> blob = fake::nvs::getBlob("mqtt", "cfg");
+    ASSERT_FALSE(blob.empty());
+    EXPECT_NE(blob.end(), std::search(blob.begin(), blob.end(), "station", "station" + strlen("station")));
+    EXPECT_STREQ("station", MQTT_getSettings()->ns);
+}
+
+TEST_F(MQTTTest, PublishesSampleUnderNamespace)
+{
+    setNamespace("station");
+    MQTT_publishSample("humidity", record(SensorId::DHT11, 7, 45, 0), 1);
+
+    std::vector<fake::broker::Message> messages = fake::broker::waitFor("station/humidity");
+    ASSERT_EQ(1u, messages.size());
+    EXPECT_EQ(0u, messages[0].payload.find("45,1700000000123,dht11,7,")) << messages[0].payload;
+    EXPECT_EQ(1, messages[0].qos);
+    EXPECT_TRUE(MQTT_flush(2000));
+}
+
+TEST_F(MQTTTest, MessageNumberSkipsSamplesSuppressedByDeadband)
+{
+    setNamespace("rbe");
+    MQTT_publishSample("humidity", record(SensorId::DHT11, 101, 61, 0), 0);
+    MQTT_publishSample("humidity", record(SensorId::DHT11, 102, 61, 0), 0); // Within deadband.
+    MQTT_publishSample("humidity", record(SensorId::DHT11, 103, 62, 0), 0);
+    ASSERT_TRUE(MQTT_flush(2000));
+
+    // Sequence number shows suppressed read, message number has no gap as nothing was lost.
+    std::vector<fake::broker::Message> messages = fake::broker::messages("rbe/humidity");
+    ASSERT_EQ(2u, messages.size());
+    EXPECT_EQ(0u, messages[0].payload.find("61,1700000000123,dht11,101,")) << messages[0].payload;
+    EXPECT_EQ(0u, messages[1].payload.find("62,1700000000123,dht11,103,")) << messages[1].payload;
+    unsigned first = std::stoul(messages[0].payload.substr(messages[0].payload.rfind(',') + 1));
+    unsigned second = std::stoul(messages[1].payload.substr(messages[1].payload.rfind(',') + 1));
+    EXPECT_EQ(first + 1, second);
+}
+
+TEST_F(MQTTTest, FormatsFixedPointWithoutFloats)
+{
+    setNamespace("station");
+    MQTT_publishFixed("fixed", -5, 2, 0);
+    MQTT_publishFixed("fixed", 101325, 2, 0);
+
+    std::vector<fake::broker::Message> messages = fake::broker::waitFor("station/fixed", 2);
+    ASSERT_EQ(2u, messages.size());
+    EXPECT_EQ(0u, messages[0].payload.find("-0.05,"));
+    EXPECT_EQ(0u, messages[1].payload.find("1013.25,"));
+}
+
+TEST_F(MQTTTest, NamespaceChangeKeepsConnection)
+{
+    setNamespace("first");
+    uint32_t connects = MQTT_getConnectionStats().connects;
+
+    setNamespace("second");
+    MQTT_publishFixed("fixed", 1, 0, 0);
+
+    EXPECT_EQ(1u, fake::broker::waitFor("second/fixed").size());
+    EXPECT_TRUE(fake::broker::messages("first/fixed").empty());
+    EXPECT_EQ(connects, MQTT_getConnectionStats().connects);
+    EXPECT_EQ(1, fake::broker::liveClients());
+}
+
+TEST_F(MQTTTest, BrokerChangeWaitsForAcknowledgesOfOldSession)
+{
+    // Topic without deadband, every sample is published.
+    setNamespace("station");
+    fake::broker::holdAcks(true);
+    MQTT_publishSample("counter", record(SensorId::NONE, 1, 45, 0), 1);
+    fake::broker::waitFor("station/counter");
+    EXPECT_FALSE(MQTT_flush(100));
+
+    // Acknowledge arrives while old session drains.
+    std::thread reconfigure([] { setBroker("10.0.0.2"); });
+    fake::waitUntil([] { return fake::broker::liveClients() == 2; }, 2000);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    fake::broker::holdAcks(false);
+    reconfigure.join();
+
+    EXPECT_EQ("10.0.0.2", fake::broker::lastHost());
+    EXPECT_EQ(1, fake::broker::liveClients());
+    EXPECT_EQ(0u, MQTT_getQueueStats().unacknowledged);
+    EXPECT_TRUE(MQTT_flush(2000));
+}
+
+TEST_F(MQTTTest, BrokerChangeCountsMessagesNeverAcknowledged)
+{
+    setNamespace("station");
+    fake::broker::holdAcks(true);
+    MQTT_publishSample("counter", record(SensorId::NONE, 1, 45, 0), 1);
+    fake::broker::waitFor("station/counter");
+    uint32_t before = MQTT_getQueueStats().unacknowledged;
+
+    // Drain gives up after its timeout, loss is reported instead of flush claiming success.
+    int64_t start = fake::nowUs();
+    setBroker("10.0.0.3");
+    EXPECT_GE(fake::nowUs() - start, 1900000);
+    fake::broker::holdAcks(false);
+
+    EXPECT_EQ(before + 1, MQTT_getQueueStats().unacknowledged);
+    EXPECT_EQ(1, fake::broker::liveClients());
+    EXPECT_TRUE(MQTT_flush(2000));
+}
+
+TEST_F(MQTTTest, RepeatedBrokerChangesDoNotLeak)
+{
+    const char *brokers[] = {"10.0.1.1", "10.0.1.2"};
+    setNamespace("soak");
+    setBroker(brokers[0]);
+    ASSERT_TRUE(MQTT_flush(2000));
+    size_t heapBefore = fake::heap::used();
+    uint32_t unacknowledgedBefore = MQTT_getQueueStats().unacknowledged;
+
+    const uint32_t rounds = 30;
+    for (uint32_t i = 1; i <= rounds; i++)
+    {
+        MQTT_publishSample("counter", record(SensorId::NONE, i, 40, 0), 1);
+        setBroker(brokers[i % 2]);
+        ASSERT_EQ(1, fake::broker::liveClients()) << "round " << i;
+    }
+    ASSERT_TRUE(MQTT_flush(2000));
+
+    // Every sample reached a broker and every old client was freed.
+    EXPECT_EQ(rounds, fake::broker::messages("soak/counter").size());
+    EXPECT_EQ(unacknowledgedBefore, MQTT_getQueueStats().unacknowledged);
+    EXPECT_EQ(heapBefore, fake::heap::used());
+    EXPECT_EQ(1, fake::broker::connectedClients());
+}
+
+TEST_F(MQTTTest, BatchCommandAppliesWithoutReconnectingWhileBrokerChangeIsStaged)
+{
+    setNamespace("station");
+    std::string host = fake::broker::lastHost();
+    uint32_t connects = MQTT_getConnectionStats().connects;
+
+    // Handler runs in client task, applying staged broker there would destroy the client from its own task.
+    MQTT_updateIP("10.0.3.1");
+    fake::broker::inject("station/cmd", "batch=json");
+    std::vector<fake::broker::Message> reply = fake::broker::waitFor("station/cmd/result");
+    ASSERT_EQ(1u, reply.size());
+    EXPECT_EQ("ok", reply[0].payload);
+
+    EXPECT_STREQ("json", MQTT_getSettings()->batchMode);
+    EXPECT_STRNE("10.0.3.1", MQTT_getSettings()->ip);
+    EXPECT_EQ(host, fake::broker::lastHost());
+    EXPECT_EQ(connects, MQTT_getConnectionStats().connects);
+    EXPECT_EQ(1, fake::broker::liveClients());
+
+    // Batch mode is saved, staged broker is not.
+    std::vector<uint8_t> blob = fake::nvs::getBlob("mqtt", "cfg");
+    EXPECT_NE(blob.end(), std::search(blob.begin(), blob.end(), "json", "json" + strlen("json")));
+    EXPECT_EQ(blob.end(), std::search(blob.begin(), blob.end(), "10.0.3.1", "10.0.3.1" + strlen("10.0.3.1")));
+
+    MQTT_updateIP(MQTT_getSettings()->ip);
+    MQTT_setBatchMode("off");
+}
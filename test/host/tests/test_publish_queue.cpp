@@ -0,0 +1,270 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../../../include/mqtt.hpp"
+#include "../../../include/spsc_queue.hpp"
+#include "../../../include/config.hpp"
+#include "../fakes/host.hpp"
+#include "../fakes/mqtt.hpp"
+#include "nvs_flash.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+
+namespace
+{
+    const int producerCount = 4; //!< All producer slots of MQTT module, test thread never publishes.
+
+    /**
+     * @brief Run body on producerCount threads at once and wait for all of them.
+     * Each thread is its own task for MQTT module and keeps its producer slot, so threads live for whole process.
+     */
+    void runProducers(const std::function<void(int)> &body)
+    {
+        static fake::Worker *threads[producerCount];
+        std::atomic<int> done{0};
+        for (int p = 0; p < producerCount; p++)
+        {
+            if (!threads[p])
+                threads[p] = new fake::Worker("producer");
+            threads[p]->after(0, [&, p] {
+                body(p);
+                done++;
+            });
+        }
+        fake::waitUntil([&] { return done == producerCount; }, 30000);
+    }
+
+    /**
+     * @brief Sample as stored by firmware before message numbers, without topicSeq after seq.
+     */
+    struct LegacySample
+    {
+        int64_t timestamp;
+        uint32_t seq;
+        int32_t value;
+        char topic[16];
+        bool isFloat;
+        uint8_t decimals;
+        uint8_t qos;
+        SensorId sensor;
+    };
+
+    /**
+     * @brief Write pending sample log record the way previous firmware did, with its "SPL2" magic.
+     */
+    void writeLegacyRecord()
+    {
+        struct
+        {
+            uint32_t consumed;
+            uint32_t magic;
+            uint32_t seq;
+            uint32_t crc;
+            uint8_t payload[40];
+        } record;
+        memset(&record, 0xFF, sizeof(record));
+
+        LegacySample sample = {1700000000000000, 1, 4242, "legacy", false, 0, 1, SensorId::BMP180};
+        memcpy(record.payload, &sample, sizeof(sample));
+        record.consumed = 0xFFFFFFFF;
+        record.magic = 0x53504C32;
+        record.seq = 1;
+        record.crc = esp_rom_crc32_le(esp_rom_crc32_le(0, (const uint8_t *)&record.seq, sizeof(record.seq)),
+                                      record.payload, sizeof(record.payload));
+
+        const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "samples");
+        ASSERT_NE(nullptr, partition);
+        ASSERT_EQ(ESP_OK, esp_partition_write(partition, 0, &record, sizeof(record)));
+    }
+
+    std::string producerTopic(int p)
+    {
+        return "p" + std::to_string(p);
+    }
+
+    /**
+     * @brief Publish sample of producer whose value encodes producer and seq.
+     */
+    void publishSample(int p, uint32_t seq)
+    {
+        SampleRecord r;
+        r.timestamp = 1700000000000000;
+        r.seq = seq;
+        r.sensor = SensorId::BMP180;
+        r.value = p * 100000 + seq;
+        r.decimals = 0;
+        MQTT_publishSample(producerTopic(p).c_str(), r, 1);
+    }
+
+    /**
+     * @brief Check that messages of producer carry its own samples, each once and in order.
+     * @return Number of messages.
+     */
+    size_t checkProducerMessages(int p, const std::vector<fake::broker::Message> &messages)
+    {
+        uint32_t lastSeq = 0;
+        for (const fake::broker::Message &m : messages)
+        {
+            // <value>,<timestamp>,<sensor>,<seq>,<n>
+            long value = strtol(m.payload.c_str(), nullptr, 10);
+            size_t seqEnd = m.payload.rfind(',');
+            uint32_t seq = strtoul(m.payload.c_str() + m.payload.rfind(',', seqEnd - 1) + 1, nullptr, 10);
+            EXPECT_EQ(p * 100000 + (long)seq, value) << m.payload;
+            EXPECT_GT(seq, lastSeq) << "producer " << p << " duplicated or reordered " << m.payload;
+            lastSeq = seq;
+        }
+        return messages.size();
+    }
+
+    class PublishQueueTest : public testing::Test
+    {
+    protected:
+        static uint32_t pendingAtBoot;
+
+        static void SetUpTestSuite()
+        {
+            nvs_flash_init();
+            writeLegacyRecord();
+            MQTT_init(MQTT_LED_PIN);
+            pendingAtBoot = MQTT_getQueueStats().storedPending;
+            ASSERT_TRUE(MQTT_waitConnected(2000));
+        }
+
+        static std::string topicOf(int p, const char *suffix = nullptr)
+        {
+            std::string topic = std::string(MQTT_getSettings()->ns) + "/" + producerTopic(p);
+            return suffix ? topic + "/" + suffix : topic;
+        }
+    };
+
+    uint32_t PublishQueueTest::pendingAtBoot;
+}
+
+TEST_F(PublishQueueTest, IgnoresRecordsOfPreviousSampleLayout)
+{
+    // Read with current layout, old record would replay garbage under a shifted topic.
+    EXPECT_EQ(0u, pendingAtBoot);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1500)); // Longer than replay period.
+    EXPECT_EQ(0u, MQTT_getQueueStats().replayed);
+    for (const fake::broker::Message &m : fake::broker::messages())
+        EXPECT_EQ(std::string::npos, m.topic.find("/replay")) << m.topic << " " << m.payload;
+}
+
+TEST(SPSCQueue, KeepsOrderBetweenThreads)
+{
+    static SPSCQueue<uint32_t, 8> queue;
+    const uint32_t count = 20000;
+
+    std::thread producer([&] {
+        for (uint32_t i = 1; i <= count;)
+        {
+            if (queue.push(i))
+                i++;
+            else
+                std::this_thread::yield();
+        }
+    });
+
+    uint32_t expected = 1, item;
+    while (expected <= count)
+    {
+        if (!queue.pop(item))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        ASSERT_EQ(expected, item);
+        ASSERT_LE(queue.size(), queue.capacity());
+        expected++;
+    }
+    producer.join();
+    EXPECT_FALSE(queue.pop(item));
+}
+
+TEST_F(PublishQueueTest, ConcurrentProducersLoseOnlyCountedSamples)
+{
+    const uint32_t perProducer = 500;
+    MQTT_QueueStats before = MQTT_getQueueStats();
+
+    // Bursts may overflow 16 sample queues, every sample is either published or counted as dropped.
+    runProducers([&](int p) {
+        for (uint32_t seq = 1; seq <= perProducer; seq++)
+            publishSample(p, seq);
+    });
+    ASSERT_TRUE(MQTT_flush(5000));
+
+    MQTT_QueueStats after = MQTT_getQueueStats();
+    size_t received = 0;
+    for (int p = 0; p < producerCount; p++)
+        received += checkProducerMessages(p, fake::broker::messages(topicOf(p)));
+
+    EXPECT_EQ(producerCount * perProducer, received + (after.droppedFull - before.droppedFull));
+    EXPECT_EQ(received, after.published - before.published);
+    EXPECT_EQ(before.droppedOffline, after.droppedOffline);
+    EXPECT_EQ(0u, after.depth);
+    EXPECT_LE(after.maxDepth, 16u);
+}
+
+TEST_F(PublishQueueTest, OfflineSamplesAreStoredOrCountedAndReplayed)
+{
+    const uint32_t perProducer = 8;
+    fake::broker::clear();
+
+    fake::broker::setOnline(false);
+    ASSERT_TRUE(fake::waitUntil([] { return !MQTT_getConnectionStats().connected; }, 2000));
+    MQTT_QueueStats before = MQTT_getQueueStats();
+
+    // Paced so queues never overflow and every sample reaches the offline path.
+    runProducers([&](int p) {
+        for (uint32_t seq = 1; seq <= perProducer; seq++)
+        {
+            publishSample(p, seq);
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    });
+    // Empty queue isn't enough, publisher may still be writing last sample to sample log.
+    ASSERT_TRUE(fake::waitUntil([&] {
+        MQTT_QueueStats s = MQTT_getQueueStats();
+        return s.stored - before.stored + s.droppedOffline - before.droppedOffline == producerCount * perProducer;
+    }, 2000));
+
+    MQTT_QueueStats offline = MQTT_getQueueStats();
+    uint32_t stored = offline.stored - before.stored;
+    EXPECT_EQ(before.droppedFull, offline.droppedFull);
+    EXPECT_EQ(producerCount * perProducer, stored + (offline.droppedOffline - before.droppedOffline));
+    EXPECT_EQ(before.published, offline.published);
+    EXPECT_TRUE(fake::broker::messages().empty());
+
+    // Stored samples come back once each, under replay subtopic.
+    fake::broker::setOnline(true);
+    ASSERT_TRUE(MQTT_waitConnected(2000));
+    ASSERT_TRUE(fake::waitUntil([&] { return MQTT_getQueueStats().replayed - before.replayed == stored; }, 10000));
+    ASSERT_TRUE(MQTT_flush(2000));
+
+    size_t replayed = 0;
+    for (int p = 0; p < producerCount; p++)
+    {
+        replayed += checkProducerMessages(p, fake::broker::messages(topicOf(p, "replay")));
+        EXPECT_TRUE(fake::broker::messages(topicOf(p)).empty());
+    }
+    EXPECT_EQ(stored, replayed);
+}
+
+TEST_F(PublishQueueTest, TaskBeyondProducerSlotsIsCountedAsNoQueue)
+{
+    runProducers([](int p) { publishSample(p, 1); }); // Makes sure all slots are taken.
+    ASSERT_TRUE(MQTT_flush(2000));
+    MQTT_QueueStats before = MQTT_getQueueStats();
+
+    std::thread extra([] { publishSample(0, 2); });
+    extra.join();
+
+    MQTT_QueueStats after = MQTT_getQueueStats();
+    EXPECT_EQ(before.droppedNoQueue + 1, after.droppedNoQueue);
+    EXPECT_EQ(before.droppedFull, after.droppedFull);
+    EXPECT_EQ(before.published, after.published);
+}
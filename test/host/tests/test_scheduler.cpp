@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "../../../include/scheduler.hpp"
+#include "../fakes/host.hpp"
+
+namespace
+{
+    const uint32_t periodMs = 10;
+    const int64_t periodUs = periodMs * 1000;
+
+    std::atomic<int64_t> overrunUs{0}; //!< How long next run takes on held clock.
+
+    void overrunningJob(void *ctx)
+    {
+        fake::advanceClock(overrunUs.exchange(0));
+    }
+
+    const Scheduler_Job jobs[] = {
+        {"overrun", overrunningJob, NULL, periodMs, 0, 10 * periodMs},
+    };
+
+    class SchedulerTest : public testing::Test
+    {
+    protected:
+        static void SetUpTestSuite()
+        {
+            // Held clock makes run end exactly where test wants it, first release is at start.
+            fake::holdClock();
+            ASSERT_TRUE(Scheduler_start(jobs, 1));
+            ASSERT_TRUE(waitForRuns(1));
+        }
+
+        static Scheduler_JobStats stats()
+        {
+            Scheduler_JobStats s;
+            Scheduler_getStats(0, s);
+            return s;
+        }
+
+        /**
+         * @brief Wait for runs and let worker go back to sleep.
+         * Worker counts run before skipped releases and arms its timer relative to time it read before,
+         * so clock must not move and stats aren't final until then.
+         */
+        static bool waitForRuns(uint32_t runs)
+        {
+            bool done = fake::waitUntil([=] { return stats().runs >= runs; }, 2000);
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            return done;
+        }
+
+        /**
+         * @brief Move clock from end of last run to next release and let job overrun by given time.
+         */
+        static void runAfter(int64_t untilReleaseUs, int64_t runUs)
+        {
+            overrunUs = runUs;
+            fake::advanceClock(untilReleaseUs);
+        }
+    };
+}
+
+TEST_F(SchedulerTest, RunEndingAtNextReleaseSkipsNothing)
+{
+    Scheduler_JobStats before = stats();
+    runAfter(periodUs, periodUs);
+
+    // Next release is due right when run ends, so it runs at once.
+    ASSERT_TRUE(waitForRuns(before.runs + 2));
+    Scheduler_JobStats after = stats();
+    EXPECT_EQ(before.skipped, after.skipped);
+    EXPECT_EQ(before.deadlineMisses, after.deadlineMisses);
+}
+
+TEST_F(SchedulerTest, RunEndingAtLaterReleaseSkipsOnlyThoseBefore)
+{
+    Scheduler_JobStats before = stats();
+    runAfter(periodUs, 2 * periodUs);
+
+    ASSERT_TRUE(waitForRuns(before.runs + 2));
+    EXPECT_EQ(before.skipped + 1, stats().skipped);
+}
+
+TEST_F(SchedulerTest, RunEndingPastReleaseSkipsIt)
+{
+    Scheduler_JobStats before = stats();
+    runAfter(periodUs, periodUs + 1);
+    ASSERT_TRUE(waitForRuns(before.runs + 1));
+    EXPECT_EQ(before.skipped + 1, stats().skipped);
+
+    // Following release keeps its place in period grid.
+    runAfter(periodUs - 1, 0);
+    ASSERT_TRUE(waitForRuns(before.runs + 2));
+    EXPECT_EQ(0u, stats().maxJitterUs);
+}
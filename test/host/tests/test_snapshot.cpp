@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "../../../include/snapshot.hpp"
+
+namespace
+{
+    /**
+     * @brief Value spanning several words so torn copy shows as mismatch between them.
+     */
+    struct Value
+    {
+        uint32_t words[16];
+
+        explicit Value(uint32_t v = 0)
+        {
+            for (uint32_t &w : words)
+                w = v;
+        }
+
+        bool consistent() const
+        {
+            for (uint32_t w : words)
+                if (w != words[0])
+                    return false;
+            return true;
+        }
+    };
+}
+
+TEST(Snapshots, PublishedValueIsCurrent)
+{
+    Snapshots<Value> s;
+    EXPECT_EQ(0u, s.version());
+
+    ASSERT_TRUE(s.publish(Value(7)));
+    Snapshots<Value>::Ref ref = s.acquire();
+    EXPECT_EQ(7u, ref->words[0]);
+    EXPECT_EQ(1u, ref.version());
+    EXPECT_EQ(1u, s.version());
+}
+
+TEST(Snapshots, HeldValueDoesNotChange)
+{
+    Snapshots<Value, 3> s;
+    ASSERT_TRUE(s.publish(Value(1)));
+    Snapshots<Value>::Ref held = s.acquire();
+
+    // Writer keeps going with remaining slots, held one stays as it was.
+    for (uint32_t v = 2; v < 10; v++)
+        ASSERT_TRUE(s.publish(Value(v)));
+    EXPECT_EQ(1u, held->words[0]);
+    EXPECT_EQ(1u, held.version());
+    EXPECT_EQ(9u, s.acquire()->words[0]);
+}
+
+TEST(Snapshots, PublishFailsWhileReadersHoldAllOtherSlots)
+{
+    Snapshots<Value, 2> s;
+    Snapshots<Value, 2>::Ref first = s.acquire();
+    ASSERT_TRUE(s.publish(Value(1)));
+    Snapshots<Value, 2>::Ref second = s.acquire();
+
+    EXPECT_FALSE(s.publish(Value(2)));
+    EXPECT_EQ(1u, s.acquire()->words[0]);
+
+    // Moved handle still pins its slot, releasing it frees the slot.
+    Snapshots<Value, 2>::Ref moved(std::move(first));
+    EXPECT_FALSE(s.publish(Value(2)));
+    {
+        Snapshots<Value, 2>::Ref released(std::move(moved));
+    }
+    EXPECT_TRUE(s.publish(Value(2)));
+    EXPECT_EQ(1u, second->words[0]);
+}
+
+TEST(Snapshots, ReadersRacingWriterSeeWholeVersionsInOrder)
+{
+    static Snapshots<Value> s;
+    const auto duration = std::chrono::milliseconds(300); // Long enough for readers to be preempted mid-acquire.
+    std::atomic<bool> done{false};
+    std::atomic<uint32_t> reads{0}, torn{0}, reordered{0}, mismatched{0};
+
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 3; r++)
+        readers.emplace_back([&] {
+            uint32_t last = 0;
+            while (!done)
+            {
+                Snapshots<Value>::Ref ref = s.acquire();
+                // Take a second handle now and then so writer runs out of free slots.
+                Snapshots<Value>::Ref again = s.acquire();
+                if (!ref->consistent() || !again->consistent())
+                    torn++;
+                if (ref.version() < last || again.version() < ref.version())
+                    reordered++;
+                if (ref->words[0] != ref.version() || again->words[0] != again.version())
+                    mismatched++;
+                last = again.version();
+                reads++;
+            }
+        });
+
+    // Single writer, value of each version is its number.
+    uint32_t versions = 0, failed = 0;
+    auto end = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < end)
+    {
+        if (s.publish(Value(versions + 1)))
+            versions++;
+        else
+            failed++;
+    }
+    done = true;
+    for (std::thread &t : readers)
+        t.join();
+
+    EXPECT_GT(reads.load(), 0u);
+    EXPECT_EQ(0u, torn.load());
+    EXPECT_EQ(0u, reordered.load());
+    EXPECT_EQ(0u, mismatched.load());
+    EXPECT_EQ(versions, s.version());
+    EXPECT_EQ(versions, s.acquire()->words[0]);
+    RecordProperty("versions", versions);
+    RecordProperty("reads", reads.load());
+    RecordProperty("busy_publishes", failed);
+}
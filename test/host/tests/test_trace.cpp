@@ -0,0 +1,142 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../../../include/histogram.hpp"
+#include "../../../include/trace.hpp"
+
+TEST(LatencyHistogram, BucketsArePowersOfTwo)
+{
+    EXPECT_EQ(0u, LatencyHistogram::bucketOf(0));
+    EXPECT_EQ(1u, LatencyHistogram::bucketOf(1));
+    EXPECT_EQ(2u, LatencyHistogram::bucketOf(2));
+    EXPECT_EQ(2u, LatencyHistogram::bucketOf(3));
+    EXPECT_EQ(11u, LatencyHistogram::bucketOf(1024));
+    EXPECT_EQ(LatencyHistogram::BUCKETS - 1, LatencyHistogram::bucketOf(UINT32_MAX));
+
+    for (uint32_t us : {1u, 7u, 8u, 1000u, 65535u, 1u << 30})
+        EXPECT_LE(us, LatencyHistogram::upperBound(LatencyHistogram::bucketOf(us))) << us;
+    EXPECT_EQ(1023u, LatencyHistogram::upperBound(10));
+}
+
+TEST(LatencyHistogram, PercentileIsUpperBoundOfBucketCappedByMax)
+{
+    LatencyHistogram h;
+    for (int i = 0; i < 98; i++)
+        h.record(10);
+    h.record(300);
+    h.record(600);
+
+    LatencyHistogram::Snapshot s;
+    h.snapshot(s);
+    EXPECT_EQ(100u, s.count());
+    EXPECT_EQ(98u * 10 + 300 + 600, s.sum);
+    EXPECT_EQ(15u, s.percentile(500));
+    EXPECT_EQ(511u, s.percentile(990));
+    EXPECT_EQ(600u, s.percentile(1000)); // Bucket bound is 1023, max is known.
+    EXPECT_EQ(600u, s.max);
+
+    LatencyHistogram::Snapshot empty;
+    EXPECT_EQ(0u, empty.percentile(500));
+}
+
+TEST(LatencyHistogram, SnapshotKeepsMaxSinceBootAfterTakeMax)
+{
+    LatencyHistogram h;
+    h.record(500);
+    h.record(20);
+    EXPECT_EQ(500u, h.takeMax());
+    EXPECT_EQ(0u, h.takeMax());
+
+    h.record(30);
+    EXPECT_EQ(30u, h.takeMax());
+
+    LatencyHistogram::Snapshot s;
+    h.snapshot(s);
+    EXPECT_EQ(500u, s.max);
+    EXPECT_EQ(3u, s.count());
+}
+
+TEST(LatencyHistogram, WindowIsDifferenceOfSnapshots)
+{
+    LatencyHistogram h;
+    h.record(5);
+    LatencyHistogram::Snapshot older;
+    h.snapshot(older);
+
+    h.record(5);
+    h.record(100);
+    LatencyHistogram::Snapshot window;
+    h.snapshot(window);
+    window.subtract(older);
+    EXPECT_EQ(2u, window.count());
+    EXPECT_EQ(105u, window.sum);
+    EXPECT_EQ(1u, window.buckets[LatencyHistogram::bucketOf(5)]);
+    EXPECT_EQ(1u, window.buckets[LatencyHistogram::bucketOf(100)]);
+
+    LatencyHistogram::Snapshot merged;
+    merged.add(window);
+    merged.add(older);
+    EXPECT_EQ(3u, merged.count());
+    EXPECT_EQ(110u, merged.sum);
+    EXPECT_EQ(100u, merged.max);
+}
+
+TEST(LatencyHistogram, WindowSumIsExactAcrossWrapOfTotal)
+{
+    LatencyHistogram h;
+    h.record(4000000000u);
+    LatencyHistogram::Snapshot older;
+    h.snapshot(older);
+
+    h.record(500000000u);
+    h.record(7);
+    LatencyHistogram::Snapshot window;
+    h.snapshot(window);
+    EXPECT_LT(window.sum, older.sum); // 32-bit total wrapped.
+    window.subtract(older);
+    EXPECT_EQ(500000007u, window.sum);
+}
+
+TEST(LatencyHistogram, ConcurrentRecordsAreAllCounted)
+{
+    static LatencyHistogram h;
+    const uint32_t perThread = 20000;
+
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < 4; t++)
+        threads.emplace_back([t, perThread] {
+            for (uint32_t i = 0; i < perThread; i++)
+                h.record(i % 1000 + t);
+        });
+    for (std::thread &t : threads)
+        t.join();
+
+    LatencyHistogram::Snapshot s;
+    h.snapshot(s);
+    EXPECT_EQ(4 * perThread, s.count());
+    EXPECT_EQ(999u + 3, s.max);
+    EXPECT_EQ(999u + 3, h.takeMax());
+}
+
+TEST(Trace, SummaryMaxSurvivesWindowReport)
+{
+    Trace_record(TracePoint::HTTP_GET, 40);
+    Trace_record(TracePoint::HTTP_GET, 900);
+
+    char json[1024];
+    ASSERT_GT(Trace_formatWindowJSON(json, sizeof(json)), 0u);
+    EXPECT_NE(nullptr, strstr(json, "\"http_get\":{\"n\":2,\"p50\":63,\"p99\":900,\"max\":900}")) << json;
+
+    // Window max was taken, max since boot stays.
+    Trace_record(TracePoint::HTTP_GET, 50);
+    Trace_Summary summary = Trace_getSummary(TracePoint::HTTP_GET);
+    EXPECT_EQ(3u, summary.count);
+    EXPECT_EQ(990u, summary.sum);
+    EXPECT_EQ(900u, summary.max);
+    EXPECT_EQ(900u, summary.p99);
+
+    ASSERT_GT(Trace_formatWindowJSON(json, sizeof(json)), 0u);
+    EXPECT_NE(nullptr, strstr(json, "\"http_get\":{\"n\":1,\"p50\":50,\"p99\":50,\"max\":50}")) << json;
+}
@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include "../../../include/wifi.hpp"
+#include "../../../include/config.hpp"
+#include "../fakes/event.hpp"
+#include "../fakes/host.hpp"
+#include "../fakes/wifi.hpp"
+#include "esp_event.h"
+#include "nvs_flash.h"
+
+namespace
+{
+    class WiFiTest : public testing::Test
+    {
+    protected:
+        static void SetUpTestSuite()
+        {
+            nvs_flash_init();
+            esp_event_loop_create_default();
+            fake::wifi::setStoredCredentials("home", "secret");
+            WiFi_init(SMART_CONFIG_BUTTON_PIN, SMART_CONFIG_LED_PIN, WIFI_LED_PIN);
+            ASSERT_TRUE(waitForConnects(1));
+        }
+
+        static bool waitForConnects(uint32_t connects)
+        {
+            return fake::waitUntil([=] { return WiFi_getStats().connects >= connects; }, 2000);
+        }
+
+        /**
+         * @brief Drop connection and wait for fast reconnect with cached address.
+         */
+        static void reconnectFast()
+        {
+            WiFi_Stats before = WiFi_getStats();
+            fake::wifi::dropConnection();
+            ASSERT_TRUE(waitForConnects(before.connects + 1));
+            EXPECT_EQ(before.fastConnects + 1, WiFi_getStats().fastConnects);
+        }
+    };
+}
+
+TEST_F(WiFiTest, FirstConnectUsesDhcp)
+{
+    EXPECT_EQ(1u, WiFi_getStats().fullAttempts);
+    EXPECT_EQ(1u, fake::wifi::dhcpExchanges());
+    EXPECT_TRUE(fake::wifi::addressLeased());
+    EXPECT_TRUE(fake::wifi::dhcpcRunning());
+}
+
+TEST_F(WiFiTest, FastConnectRenewsLeaseInBackground)
+{
+    uint32_t exchanges = fake::wifi::dhcpExchanges();
+    reconnectFast();
+
+    // Cached address is used without waiting, DHCP client runs again afterwards.
+    EXPECT_TRUE(fake::wifi::dhcpcRunning());
+    ASSERT_TRUE(fake::waitUntil([&] { return fake::wifi::dhcpExchanges() == exchanges + 1; }, 1000));
+    ASSERT_TRUE(fake::event::drain());
+    EXPECT_TRUE(fake::wifi::addressLeased());
+
+    // Renewal is not another connection.
+    WiFi_Stats stats = WiFi_getStats();
+    EXPECT_EQ(stats.connects, 2u);
+    EXPECT_EQ(stats.fullAttempts, 1u);
+}
+
+TEST_F(WiFiTest, FastConnectMovesToNewAddressWhenLeaseIsGone)
+{
+    const uint32_t newIp = ESP_IP4TOADDR(192, 168, 1, 150);
+    fake::wifi::renumber(newIp);
+    reconnectFast();
+
+    ASSERT_TRUE(fake::waitUntil([&] { return fake::wifi::address().addr == newIp; }, 1000));
+    ASSERT_TRUE(fake::event::drain());
+    EXPECT_TRUE(fake::wifi::addressLeased());
+
+    // Next fast connect starts from the new lease.
+    reconnectFast();
+    EXPECT_EQ(newIp, fake::wifi::address().addr);
+    EXPECT_TRUE(fake::wifi::addressLeased());
+}
+
+TEST_F(WiFiTest, RetriesAfterBackoffUntilAccessPointReturns)
+{
+    WiFi_Stats before = WiFi_getStats();
+    uint32_t attempts = fake::wifi::connectAttempts();
+    fake::wifi::setApPresent(false);
+
+    // Fast connect and full connect fail right away, next full connect waits for reconnect timer.
+    ASSERT_TRUE(fake::waitUntil([&] { return fake::wifi::connectAttempts() >= attempts + 3; }, 2000));
+    EXPECT_GE(WiFi_getStats().fullAttempts, before.fullAttempts + 2);
+
+    fake::wifi::setApPresent(true);
+    ASSERT_TRUE(waitForConnects(before.connects + 1));
+    ASSERT_TRUE(fake::event::drain());
+    EXPECT_TRUE(fake::wifi::associated());
+}